@@ -0,0 +1,12 @@
+section .text
+; размер в байтах - в rdi, адрес блока возвращается в rax
+_malloc:
+	mov rax, [currentAddress]
+	mov rcx, rax
+	add rcx, rdi
+	mov [currentAddress], rcx
+	ret
+
+section .data
+startAddress	dq	0
+currentAddress	dq	0
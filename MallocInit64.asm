@@ -0,0 +1,25 @@
+%include "Malloc64.asm"
+global _start
+
+section .text
+
+_start:
+	; mmap(0, 10 Мб, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+	mov rax, 9
+	xor rdi, rdi
+	mov rsi, 10485760
+	mov rdx, 3
+	mov r10, 34
+	mov r8, -1
+	xor r9, r9
+	syscall
+	mov [startAddress], rax
+	mov [currentAddress], rax
+
+	mov rdi, 8
+	call _malloc
+
+	; exit(0)
+	mov rax, 60
+	xor rdi, rdi
+	syscall
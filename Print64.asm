@@ -0,0 +1,35 @@
+section     .text
+global      _print
+
+; число - в rdi, печатается в десятичной записи с переводом строки
+_print:
+	mov     rax, rdi
+	lea     rsi, [buffer + 23]
+	mov     byte [rsi], 10
+	mov     rcx, 10
+	mov     r8, rax                             ;знак
+	test    rax, rax
+	jns     .digits
+	neg     rax
+.digits:
+	xor     rdx, rdx
+	div     rcx
+	add     dl, '0'
+	dec     rsi
+	mov     [rsi], dl
+	test    rax, rax
+	jnz     .digits
+	test    r8, r8
+	jns     .write
+	dec     rsi
+	mov     byte [rsi], '-'
+.write:
+	mov     rax, 1                              ;system call number (sys_write)
+	mov     rdi, 1                              ;file descriptor (stdout)
+	lea     rdx, [buffer + 24]
+	sub     rdx, rsi                            ;message length
+	syscall
+	ret
+
+section     .bss
+buffer      resb    24
@@ -1,10 +1,16 @@
 #include "Translator.h"
+#include "../Structs/IRUtils.h"
 
 namespace Translate {
 	CExpConverter::CExpConverter(IExp* _expr) : expr(_expr) {}
 	IExp* CExpConverter::ToExp() const { return expr; }
 	IStm* CExpConverter::ToStm() const { return new EXP(expr); }
 	IStm* CExpConverter::ToConditional(const Temp::CLabel* t,const Temp::CLabel* f) const {
+		// Значение сравнения в условии - снова переход по тому же сравнению
+		CMP* cmp = dynamic_cast<CMP*>(expr);
+		if (cmp != 0) {
+			return new CJUMP(cmp->relop, cmp->left, cmp->right, t, f);
+		}
 		return new CJUMP(EQ, expr, new CONST(0), f, t);
 	}
 
@@ -14,6 +20,10 @@ namespace Translate {
 	IStm* CStmConverter::ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const { assert(0); }
 
 	IExp* CConditionalWrapper::ToExp() const {
+		IExp* value = ToValue();
+		if (value != 0) {
+			return value;
+		}
 		shared_ptr<CTemp> r = shared_ptr<CTemp>( new Temp::CTemp() );
 		Temp::CLabel* t = new Temp::CLabel();
 		Temp::CLabel* f = new Temp::CLabel();
@@ -32,23 +42,89 @@ namespace Translate {
 
 	CRelativeCmpWrapper::CRelativeCmpWrapper(CJUMP_OP _op, IExp* _first, IExp* _second) :
 			op(_op), first(_first), second(_second) {}
+	IExp* CRelativeCmpWrapper::ToValue() const {
+		return new CMP(op, first, second);
+	}
 	IStm* CRelativeCmpWrapper::ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const {
 		return new CJUMP(op, first, second, t, f);
 	}
 
-	CFromAndConverter::CFromAndConverter(IExp* _leftArg, IExp* _rightArg) :
-		leftArg(_leftArg), rightArg(_rightArg) {}
+	// Значение операнда без переходов или 0
+	static IExp* valueOf(const shared_ptr<ISubtreeWrapper>& arg) {
+		const CConditionalWrapper* conditional = dynamic_cast<const CConditionalWrapper*>(arg.get());
+		return (conditional != 0) ? conditional->ToValue() : arg->ToExp();
+	}
+
+	CNotWrapper::CNotWrapper(shared_ptr<ISubtreeWrapper> _arg) : arg(_arg) {}
+	IExp* CNotWrapper::ToValue() const {
+		// Отрицание сравнения - обратное сравнение, отрицание значения - сравнение с нулём
+		IExp* value = valueOf(arg);
+		if (value == 0) {
+			return 0;
+		}
+		CMP* cmp = dynamic_cast<CMP*>(value);
+		return (cmp != 0) ? new CMP(NegateRelop(cmp->relop), cmp->left, cmp->right) : new CMP(EQ, value, new CONST(0));
+	}
+	IStm* CNotWrapper::ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const {
+		return arg->ToConditional(f, t);
+	}
+
+	// Второй операнд && и || вычисляется всегда, если он без побочных эффектов и обращений к памяти, а обе
+	// половины вместе дешевле непредсказанного перехода. Значения логических выражений - 0 или 1
+	static const int maxBranchlessCost = 6;
+
+	// Число команд, которыми значение выражения получается в регистре; у сравнения это cmp, setcc и movzx
+	static int valueCost(IExp* exp) {
+		if (dynamic_cast<TEMP*>(exp) != 0 || dynamic_cast<CONST*>(exp) != 0) {
+			return 0;
+		}
+		int cost;
+		if (dynamic_cast<CMP*>(exp) != 0) {
+			cost = 3;
+		} else if (dynamic_cast<MEM*>(exp) != 0 || dynamic_cast<BINOP*>(exp) != 0) {
+			cost = 1;
+		} else {
+			return maxBranchlessCost + 1;
+		}
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			cost += valueCost(l->head);
+		}
+		return cost;
+	}
+
+	static bool isBranchless(const shared_ptr<ISubtreeWrapper>& leftArg, const shared_ptr<ISubtreeWrapper>& rightArg) {
+		IExp* left = valueOf(leftArg);
+		IExp* right = valueOf(rightArg);
+		return left != 0 && right != 0 && IsPure(right) && valueCost(left) + valueCost(right) <= maxBranchlessCost;
+	}
+
+	CFromAndConverter::CFromAndConverter(shared_ptr<ISubtreeWrapper> _leftArg, shared_ptr<ISubtreeWrapper> _rightArg) :
+		leftArg(_leftArg), rightArg(_rightArg), branchless(isBranchless(_leftArg, _rightArg)) {}
+	IExp* CFromAndConverter::ToValue() const {
+		return branchless ? new BINOP(AND_OP, valueOf(leftArg), valueOf(rightArg)) : 0;
+	}
 	IStm* CFromAndConverter::ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const {
+		if (branchless) {
+			return CExpConverter(ToExp()).ToConditional(t, f);
+		}
 		const Temp::CLabel* z = new Temp::CLabel();
-		return new SEQ( new CJUMP(LT, leftArg, new CONST(1), f, z),
-						new SEQ(new LABEL(z), new CJUMP(LT, rightArg, new CONST(1), f, t)));
+		return new SEQ( leftArg->ToConditional(z, f),
+						new SEQ(new LABEL(z), rightArg->ToConditional(t, f)));
 	}
 
-	CFromOrConverter::CFromOrConverter(IExp* _leftArg, IExp* _rightArg) : leftArg(_leftArg), rightArg(_rightArg) {}
+	CFromOrConverter::CFromOrConverter(shared_ptr<ISubtreeWrapper> _leftArg, shared_ptr<ISubtreeWrapper> _rightArg) :
+		leftArg(_leftArg), rightArg(_rightArg), branchless(isBranchless(_leftArg, _rightArg)) {}
+	IExp* CFromOrConverter::ToValue() const {
+		return branchless ? new BINOP(OR_OP, valueOf(leftArg), valueOf(rightArg)) : 0;
+	}
 	IStm* CFromOrConverter::ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const {
+		if (branchless) {
+			return CExpConverter(ToExp()).ToConditional(t, f);
+		}
 		const CLabel* z = new CLabel();
-		return new SEQ(new CJUMP(GT, leftArg, new CONST(1), t, z),
-					   new SEQ(new LABEL(z), new CJUMP(LT, rightArg, new CONST(1), f, t)));
+		return new SEQ(leftArg->ToConditional(t, z),
+					   new SEQ(new LABEL(z), rightArg->ToConditional(t, f)));
 	}
 
 	//-------------------------------------------------------------------------------------------------------
@@ -57,14 +133,32 @@ namespace Translate {
 	CTranslator::CTranslator( CStorage* _symbols, CTable &_table ) :
 			symbolsStorage( _symbols ), table( _table ),
 			currentClass( &table.classInfo[0] ),
-			currentMethod( &table.classInfo[0].methods[0] ) {
+			currentMethod( &table.classInfo[0].methods[0] ),
+			directCalls( 0 ), virtualCalls( 0 ) {
 		for ( int i = 0; i < table.classInfo.size(); i++ ) {
 			CClassInfo cl = table.classInfo[i];
 			for ( int j = 0; j < cl.methods.size(); j++ ) {
-				string name = cl.methods[j].name->getString();
+				string name = methodLabel( cl.name, cl.methods[j].name );
 				functionalLabels[name] = shared_ptr<CLabel>( new CLabel( name ));
 			}
+			string name = cl.name->getString();
+			virtualTableLabels[name] = shared_ptr<CLabel>( new CLabel( name + "$vtable" ));
+		}
+	}
+
+	void CTranslator::PrintVirtualTables( ostream& out ) {
+		// Слот таблицы - адрес метода размером в слово, вызов берёт его по смещению слот * CFrame::wordSize
+		const char* slot = ( CFrame::wordSize == 8 ) ? "dq" : "dd";
+		for ( int i = 0; i < table.classInfo.size(); i++ ) {
+			const CSymbol* name = table.classInfo[i].name;
+			vector<CVirtualMethod> vtable = table.getVirtualTable( name );
+			out << virtualTableLabels[name->getString()]->Name() << ":" << endl;
+			for ( int j = 0; j < vtable.size(); j++ ) {
+				out << "\t" << slot << " " << functionalLabels[methodLabel( vtable[j].owner, vtable[j].name )]->Name() << endl;
+			}
 		}
+		// Статистика - комментарием, чтобы файл оставался исходником ассемблера
+		out << "; calls: direct " << directCalls << ", virtual " << virtualCalls << endl;
 	}
 
 	void CTranslator::Visit( const CProgramRuleNode* node ) {
@@ -78,12 +172,13 @@ namespace Translate {
 		const CSymbol* methodName = symbolsStorage->get( "main" );
 		currentMethod = &( currentClass->getMethodInfo( methodName ));
 		currentFrame = shared_ptr<CFrame>( new CFrame( methodName ));
-		currentFrame->allocFormal( symbolsStorage->get( "this" )); // this
+		// Адрес переменной в MiniJava взять нельзя: ни переменные, ни параметры не убегают
+		currentFrame->allocFormal( symbolsStorage->get( "this" ), false ); // this
 		for ( int i = 0; i < currentMethod->params.size(); i++ ) {
-			currentFrame->allocFormal( currentMethod->params[i].name );
+			currentFrame->allocFormal( currentMethod->params[i].name, false );
 		}
 		for ( int i = 0; i < currentMethod->vars.size(); i++ ) {
-			currentFrame->allocLocal( currentMethod->vars[i].name );
+			currentFrame->allocLocal( currentMethod->vars[i].name, false );
 		}
 		for ( int i = 0; i < currentClass->vars.size(); i++ ) {
 			currentFrame->allocVar( currentClass->vars[i].name );
@@ -91,7 +186,9 @@ namespace Translate {
 
 		if ( node->stmt != 0 ) {
 			node->stmt->accept( this );
-			trees.push_back( currentNode->ToStm());
+			shared_ptr<CLabel> label = functionalLabels[methodLabel( currentClass->name, methodName )];
+			trees.push_back( new SEQ( new LABEL( label.get() ), currentNode->ToStm()));
+			fragments.push_back( CFragment( label, currentFrame ));
 		}
 	}
 
@@ -136,12 +233,13 @@ namespace Translate {
 	void CTranslator::Visit( const CMethodDeclarationRuleNode* node ) {
 		currentMethod = &( currentClass->getMethodInfo( node->ident ));
 		currentFrame = shared_ptr<CFrame>( new CFrame( node->ident ));
-		currentFrame->allocFormal( symbolsStorage->get( "this" )); // this
+		// Адрес переменной в MiniJava взять нельзя: ни переменные, ни параметры не убегают
+		currentFrame->allocFormal( symbolsStorage->get( "this" ), false ); // this
 		for ( int i = 0; i < currentMethod->params.size(); i++ ) {
-			currentFrame->allocFormal( currentMethod->params[i].name );
+			currentFrame->allocFormal( currentMethod->params[i].name, false );
 		}
 		for ( int i = 0; i < currentMethod->vars.size(); i++ ) {
-			currentFrame->allocLocal( currentMethod->vars[i].name );
+			currentFrame->allocLocal( currentMethod->vars[i].name, false );
 		}
 		vector<CVarInfo> parentVars = table.getParentVars( currentClass->name );
 		for ( int i = 0; i < parentVars.size(); i++ ) {
@@ -160,7 +258,10 @@ namespace Translate {
 			res = new ESEQ( arg1, res );
 		}
 
-		trees.push_back( res );
+		// Дерево метода начинается его меткой, результат передаётся через регистр возврата
+		shared_ptr<CLabel> label = functionalLabels[methodLabel( currentClass->name, node->ident )];
+		trees.push_back( new SEQ( new LABEL( label.get() ), new MOVE( new TEMP( CFrame::ReturnValue()), res )));
+		fragments.push_back( CFragment( label, currentFrame ));
 	}
 
 	void CTranslator::Visit( const CVarsDecListNode* node ) {
@@ -252,19 +353,22 @@ namespace Translate {
 
 	void CTranslator::Visit( const CWhileStatementNode* node ) {
 		node->expression->accept( this );
+		const CLabel* test = new CLabel();
+		const CLabel* body = new CLabel();
+		const CLabel* done = new CLabel();
+		// Условие вычисляется один раз в заголовке цикла, у которого единственный вход извне
+		IStm* condition = currentNode->ToConditional( body, done );
 
-		IExp* expr = currentNode->ToExp();
 		node->statement->accept( this );
 		IStm* statement = currentNode->ToStm();
-		const CLabel* f = new CLabel();
-		const CLabel* t = new CLabel();
 
-		IStm* res = new SEQ( new SEQ( new SEQ( new SEQ(
-				new CJUMP( EQ, expr, new CONST( 0 ), f, t ),
-				new LABEL( t )),
-											   statement ),
-									  new CJUMP( EQ, expr, new CONST( 0 ), f, t )),
-							 new LABEL( f ));
+		IStm* res = new SEQ( new SEQ( new SEQ( new SEQ( new SEQ(
+				new LABEL( test ),
+				condition ),
+				new LABEL( body )),
+				statement ),
+				new JUMP( test )),
+				new LABEL( done ));
 
 		currentNode = shared_ptr<CStmConverter>( new CStmConverter( res ));
 	}
@@ -286,40 +390,45 @@ namespace Translate {
 
 	void CTranslator::Visit( const CInvokeExpressionStatementNode* node ) {
 		node->firstexpression->accept( this );
+		IExp* index = currentNode->ToExp();
 		node->secondexpression->accept( this );
+		IExp* value = currentNode->ToExp();
+		IStm* res = new MOVE( arrayElement( currentFrame->findByName( node->identifier ), index ), value );
+		currentNode = shared_ptr<CStmConverter>( new CStmConverter( res ));
 	}
 
 	void CTranslator::Visit( const CInvokeExpressionNode* node ) {
 		node->firstExp->accept( this );
+		IExp* array = currentNode->ToExp();
 		node->secondExp->accept( this );
+		IExp* index = currentNode->ToExp();
+		currentNode = shared_ptr<CExpConverter>( new CExpConverter( arrayElement( array, index )));
 	}
 
 	void CTranslator::Visit( const CLengthExpressionNode* node ) {
 		node->expr->accept( this );
+		IExp* res = new MEM( currentNode->ToExp());
+		currentNode = shared_ptr<CExpConverter>( new CExpConverter( res ));
 	}
 
 	void CTranslator::Visit( const CArithmeticExpressionNode* node ) {
 		node->firstExp->accept( this );
-		IExp* arg1 = currentNode->ToExp();
+		shared_ptr<ISubtreeWrapper> arg1 = currentNode;
 		node->secondExp->accept( this );
-		IExp* arg2 = currentNode->ToExp();
-		IExp* res;
-		const CConditionalWrapper* converter;
+		shared_ptr<ISubtreeWrapper> arg2 = currentNode;
+		// && и || остаются условиями: значение строится, только если его используют как значение
 		switch ( node->opType ) {
 			case AND_OP:
-				converter = new CFromAndConverter( arg1, arg2 );
-				res = converter->ToExp();
+				currentNode = shared_ptr<CFromAndConverter>( new CFromAndConverter( arg1, arg2 ));
 				break;
 			case OR_OP:
-				converter = new CFromOrConverter( arg1, arg2 );
-				res = converter->ToExp();
+				currentNode = shared_ptr<CFromOrConverter>( new CFromOrConverter( arg1, arg2 ));
 				break;
 			default:
-				res = new BINOP( node->opType, arg1, arg2 );
+				currentNode = shared_ptr<CExpConverter>(
+						new CExpConverter( new BINOP( node->opType, arg1->ToExp(), arg2->ToExp())));
 				break;
 		}
-
-		currentNode = shared_ptr<CExpConverter>( new CExpConverter( res ));
 	}
 
 	void CTranslator::Visit( const CUnaryExpressionNode* node ) {
@@ -334,32 +443,30 @@ namespace Translate {
 		IExp* arg1 = currentNode->ToExp();
 		node->secondExp->accept( this );
 		IExp* arg2 = currentNode->ToExp();
-		const CConditionalWrapper* cmpWrapper = new CRelativeCmpWrapper( LT, arg1, arg2 );
-		currentNode = shared_ptr<CExpConverter>( new CExpConverter( cmpWrapper->ToExp()));
-
+		// Условие остаётся условием: в if и while сравнение становится одним CJUMP
+		currentNode = shared_ptr<CRelativeCmpWrapper>( new CRelativeCmpWrapper( LT, arg1, arg2 ));
 	}
 
 	void CTranslator::Visit( const CNotExpressionNode* node ) {
 		node->expr->accept( this );
-		IExp* arg = currentNode->ToExp();
-		const CConditionalWrapper* cmpWrapper = new CRelativeCmpWrapper( EQ, arg, new CONST( 0 ));
-		currentNode = std::shared_ptr<CExpConverter>( new CExpConverter( cmpWrapper->ToExp()));
+		currentNode = shared_ptr<CNotWrapper>( new CNotWrapper( currentNode ));
 	}
 
 	void CTranslator::Visit( const CNewArrayExpressionNode* node ) {
 		node->expr->accept( this );
 		IExp* arg = currentNode->ToExp();
 		shared_ptr<CTemp> arrSize = shared_ptr<CTemp>( new CTemp());
-		IExp* calcArrSize = new BINOP( PLUS_OP, arg, new CONST( 1 ));
-		IStm* storeArrSize = new MOVE( new TEMP( arrSize ), calcArrSize );
-		IExp* sizeInBytes = new BINOP( MULT_OP, new MEM( new TEMP( arrSize )), new CONST( 4 ));
+		IStm* storeArrSize = new MOVE( new TEMP( arrSize ), arg );
+		// Длина хранится в первом слове массива
+		IExp* sizeInBytes = new BINOP( MULT_OP, new BINOP( PLUS_OP, new TEMP( arrSize ), new CONST( 1 )),
+									   new CONST( CFrame::wordSize ));
 
 		shared_ptr<ExpList> args = shared_ptr<ExpList>( new ExpList( sizeInBytes, 0 ));
 		IExp* memCall = currentFrame->externalCall( getMallocFuncName()->getString(), args );
 		shared_ptr<CTemp> temp = shared_ptr<CTemp>( new CTemp());
 
 		IStm* storeCalcRes = new MOVE( new TEMP( temp ), memCall );
-		IStm* storeLength = new MOVE( new MEM( new TEMP( temp )), new MEM( new TEMP( arrSize )));
+		IStm* storeLength = new MOVE( new MEM( new TEMP( temp )), new TEMP( arrSize ));
 
 		IExp* res = new ESEQ( new SEQ( storeArrSize,
 									   new SEQ( storeCalcRes,
@@ -372,14 +479,15 @@ namespace Translate {
 	void CTranslator::Visit( const CNewObjectExpressionNode* node ) {
 		shared_ptr<CTemp> temp = shared_ptr<CTemp>( new CTemp());
 
-		int varsSizeInBytes = CFrame::wordSize * table.getClassInfo( node->objType ).vars.size();
-		if ( varsSizeInBytes < CFrame::wordSize ) {
-			varsSizeInBytes = CFrame::wordSize;
-		}
-		shared_ptr<ExpList> args = shared_ptr<ExpList>( new ExpList( new CONST( varsSizeInBytes ), 0 ));
+		// Указатель на таблицу виртуальных методов, поля предков, поля класса
+		int fieldsCount = table.getParentVars( node->objType ).size() + table.getClassInfo( node->objType ).vars.size();
+		int sizeInBytes = CFrame::wordSize * ( fieldsCount + 1 );
+		shared_ptr<ExpList> args = shared_ptr<ExpList>( new ExpList( new CONST( sizeInBytes ), 0 ));
 		IExp* memCall = currentFrame->externalCall( getMallocFuncName()->getString(), args );
 		IStm* storeCalcRes = new MOVE( new TEMP( temp ), memCall );
-		IExp* res = new ESEQ( storeCalcRes,
+		IStm* storeVirtualTable = new MOVE( new MEM( new TEMP( temp )),
+											new NAME( virtualTableLabels[node->objType->getString()] ));
+		IExp* res = new ESEQ( new SEQ( storeCalcRes, storeVirtualTable ),
 							  new TEMP( temp ));
 
 		currentNode = shared_ptr<CExpConverter>( new CExpConverter( res ));
@@ -410,18 +518,38 @@ namespace Translate {
 	}
 
 	void CTranslator::Visit( const CInvokeMethodExpressionNode* node ) {
+		// Вызов может стоять в списке аргументов другого вызова
+		shared_ptr<ExpList> outerArguments = arguments;
+		arguments = 0;
+		const CSymbol* receiverClass = classOf( node->expr.get());
 		node->expr->accept( this );
 		IExp* texp = currentNode->ToExp();
 		if ( node->args != 0 ) {
 			node->args->accept( this );
 		}
-		// надеюсь, что после прохода по списку аргументов (экспрешнов) currentNode станет ExpList
-		arguments = shared_ptr<ExpList>(
-				new ExpList( texp, arguments ));  //надо как-то в список аргументов зацепить this
-		IExp* name = new NAME( functionalLabels[node->name->getString()] );
-		IExp* res = new CALL( name, arguments );
+		// Аргументы накоплены в обратном порядке; this передаётся первым
+		shared_ptr<ExpList> args = 0;
+		for ( shared_ptr<ExpList> arg = arguments; arg != 0; arg = arg->tail ) {
+			args = shared_ptr<ExpList>( new ExpList( arg->head, args ));
+		}
+
+		IExp* res;
+		const CSymbol* owner = table.getSingleImplementation( receiverClass, node->name );
+		if ( owner != 0 ) {
+			// Ни один наследник не переопределяет метод: вызов прямой
+			IExp* name = new NAME( functionalLabels[methodLabel( owner, node->name )] );
+			res = new CALL( name, shared_ptr<ExpList>( new ExpList( texp, args )));
+			directCalls++;
+		} else {
+			shared_ptr<CTemp> object = shared_ptr<CTemp>( new CTemp());
+			int offset = table.getVirtualSlot( receiverClass, node->name ) * CFrame::wordSize;
+			IExp* method = new MEM( new BINOP( PLUS_OP, new MEM( new TEMP( object )), new CONST( offset )));
+			res = new ESEQ( new MOVE( new TEMP( object ), texp ),
+							new CALL( method, shared_ptr<ExpList>( new ExpList( new TEMP( object ), args ))));
+			virtualCalls++;
+		}
 		currentNode = shared_ptr<CExpConverter>( new CExpConverter( res ));
-		arguments = 0; //сбрасываем старые аргументы
+		arguments = outerArguments;
 	}
 
 	void CTranslator::Visit( const CFewArgsExpressionNode* node ) {
@@ -439,6 +567,50 @@ namespace Translate {
 		arguments = shared_ptr<ExpList>( new ExpList( currentNode->ToExp(), arguments ));
 	}
 
+	IExp* CTranslator::arrayElement( IExp* array, IExp* index ) {
+		IExp* offset = new BINOP( MULT_OP, new BINOP( PLUS_OP, index, new CONST( 1 )), new CONST( CFrame::wordSize ));
+		return new MEM( new BINOP( PLUS_OP, array, offset ));
+	}
+
+	string CTranslator::methodLabel( const CSymbol* className, const CSymbol* method ) {
+		return className->getString() + "$" + method->getString();
+	}
+
+	const CSymbol* CTranslator::classOf( const CExpressionNode* exp ) {
+		if ( dynamic_cast<const CThisExpressionNode*>( exp ) != 0 ) {
+			return currentClass->name;
+		}
+		if ( const CNewObjectExpressionNode* newObject = dynamic_cast<const CNewObjectExpressionNode*>( exp )) {
+			return newObject->objType;
+		}
+		if ( const CIdentExpressionNode* ident = dynamic_cast<const CIdentExpressionNode*>( exp )) {
+			return typeOf( ident->name );
+		}
+		if ( const CParenExpressionNode* paren = dynamic_cast<const CParenExpressionNode*>( exp )) {
+			return classOf( paren->expr.get());
+		}
+		if ( const CInvokeMethodExpressionNode* invoke = dynamic_cast<const CInvokeMethodExpressionNode*>( exp )) {
+			CClassInfo& owner = table.getMethodOwner( classOf( invoke->expr.get()), invoke->name );
+			return owner.getMethodInfo( invoke->name ).returnType;
+		}
+		throw new logic_error( "Method call on a non-object expression" );
+	}
+
+	// Переменные ищутся в том же порядке, что и в CFrame::findByName
+	const CSymbol* CTranslator::typeOf( const CSymbol* name ) {
+		vector<CVarInfo> scope( currentMethod->vars );
+		scope.insert( scope.end(), currentMethod->params.begin(), currentMethod->params.end());
+		scope.insert( scope.end(), currentClass->vars.begin(), currentClass->vars.end());
+		vector<CVarInfo> parentVars = table.getParentVars( currentClass->name );
+		scope.insert( scope.end(), parentVars.begin(), parentVars.end());
+		for ( int i = 0; i < scope.size(); i++ ) {
+			if ( scope[i].name->getString() == name->getString()) {
+				return scope[i].type;
+			}
+		}
+		throw new logic_error( "Variable not found in typeOf" );
+	}
+
 	const CSymbol* CTranslator::getMallocFuncName() {
 		return symbolsStorage->get("_malloc");
 	}
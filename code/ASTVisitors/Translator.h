@@ -44,6 +44,8 @@ namespace Translate {
 
 	class CConditionalWrapper : public ISubtreeWrapper {
 	public:
+		// Значение без условных переходов или 0, если получить его можно только переходами
+		virtual IExp* ToValue() const { return 0; }
 		IExp* ToExp() const;
 		virtual IStm* ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const = 0;
 		IStm* ToStm() const;
@@ -52,6 +54,8 @@ namespace Translate {
 	class CRelativeCmpWrapper : public CConditionalWrapper {
 	public:
 		CRelativeCmpWrapper(CJUMP_OP _op, IExp* _first, IExp* _second);
+		// Значение сравнения вычисляется без переходов (setcc)
+		IExp* ToValue() const;
 		IStm* ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const;
 	private:
 		IExp* first;
@@ -59,27 +63,47 @@ namespace Translate {
 		CJUMP_OP op;
 	};
 
+	// Отрицание в условии - тот же переход с переставленными метками
+	class CNotWrapper : public CConditionalWrapper {
+	public:
+		CNotWrapper(shared_ptr<ISubtreeWrapper> _arg);
+		IExp* ToValue() const;
+		IStm* ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const;
+	private:
+		shared_ptr<ISubtreeWrapper> arg;
+	};
+
 	class CFromAndConverter : public CConditionalWrapper {
 	public:
-		CFromAndConverter(IExp* _leftArg, IExp* _rightArg);
+		CFromAndConverter(shared_ptr<ISubtreeWrapper> _leftArg, shared_ptr<ISubtreeWrapper> _rightArg);
+		// Дешёвые операнды без побочных эффектов вычисляются оба и объединяются поразрядно, без переходов
+		IExp* ToValue() const;
 		IStm* ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const;
 	private:
-		IExp* leftArg;
-		IExp* rightArg;
+		shared_ptr<ISubtreeWrapper> leftArg;
+		shared_ptr<ISubtreeWrapper> rightArg;
+		bool branchless;
 	};
 
 	class CFromOrConverter : public CConditionalWrapper {
 	public:
-		CFromOrConverter(IExp* _leftArg, IExp* _rightArg);
+		CFromOrConverter(shared_ptr<ISubtreeWrapper> _leftArg, shared_ptr<ISubtreeWrapper> _rightArg);
+		IExp* ToValue() const;
 		IStm* ToConditional(const Temp::CLabel* t, const Temp::CLabel* f) const;
 	private:
-		IExp* leftArg;
-		IExp* rightArg;
+		shared_ptr<ISubtreeWrapper> leftArg;
+		shared_ptr<ISubtreeWrapper> rightArg;
+		bool branchless;
 	};
 
 	class CTranslator : public CVisitor {
 	public:
 		vector<INode*> trees;
+		// Кадры и метки методов, fragments[i] соответствует trees[i]
+		vector<CFragment> fragments;
+		// Вызовы, ставшие прямыми после анализа иерархии классов, и вызовы через таблицу виртуальных методов
+		int directCalls;
+		int virtualCalls;
 
 		CTranslator( CStorage* _symbols, CTable &_table );
 		void Visit( const CProgramRuleNode* node );
@@ -127,16 +151,27 @@ namespace Translate {
 		void Visit( const CFewArgsExpressionNode* node );
 		void Visit( const CListExpressionNode* node );
 		void Visit( const CLastListExpressionNode* node );
+
+		// Таблицы виртуальных методов всех классов в виде данных ассемблера NASM (dd на x86, dq на x86-64)
+		void PrintVirtualTables( ostream& out );
 	private:
 		CStorage* symbolsStorage;
 		CTable table;
+		// Метки методов и таблиц виртуальных методов по имени вида Class$method
 		map<string, shared_ptr<CLabel>> functionalLabels;
+		map<string, shared_ptr<CLabel>> virtualTableLabels;
 		CClassInfo* currentClass;
 		CMethodInfo* currentMethod;
 		shared_ptr<CFrame> currentFrame;
 		shared_ptr<ISubtreeWrapper> currentNode;
 		shared_ptr<ExpList> arguments;
 
+		// Элемент массива: MEM(array + (index + 1) * wordSize), в нулевом слове хранится длина
+		IExp* arrayElement( IExp* array, IExp* index );
+		static string methodLabel( const CSymbol* className, const CSymbol* method );
+		// Статический класс выражения, у которого вызывается метод
+		const CSymbol* classOf( const CExpressionNode* exp );
+		const CSymbol* typeOf( const CSymbol* name );
 		const CSymbol* getMallocFuncName();
 		const CSymbol* getPrintFuncName();
 	};
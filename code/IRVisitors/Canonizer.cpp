@@ -64,6 +64,26 @@ void CCanonizer::Visit(BINOP* node) {
 	current_node = doExp(new BINOP(node->binop, arg1, arg2));
 }
 
+void CCanonizer::Visit(CMP* node) {
+	node->left->accept(this);
+	IExp* arg1 = dynamic_cast<IExp*>(current_node);
+	node->right->accept(this);
+	IExp* arg2 = dynamic_cast<IExp*>(current_node);
+	current_node = doExp(new CMP(node->relop, arg1, arg2));
+}
+
+void CCanonizer::Visit(SELECT* node) {
+	node->left->accept(this);
+	IExp* arg1 = dynamic_cast<IExp*>(current_node);
+	node->right->accept(this);
+	IExp* arg2 = dynamic_cast<IExp*>(current_node);
+	node->iftrue->accept(this);
+	IExp* arg3 = dynamic_cast<IExp*>(current_node);
+	node->iffalse->accept(this);
+	IExp* arg4 = dynamic_cast<IExp*>(current_node);
+	current_node = doExp(new SELECT(node->relop, arg1, arg2, arg3, arg4));
+}
+
 void CCanonizer::Visit(MEM* node) {
 	node->exp->accept(this);
 	IExp* arg = dynamic_cast<IExp*>(current_node);
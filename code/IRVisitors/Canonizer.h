@@ -16,6 +16,8 @@ public:
     virtual void Visit(NAME* node);
     virtual void Visit(TEMP* node);
     virtual void Visit(BINOP* node);
+    virtual void Visit(CMP* node);
+    virtual void Visit(SELECT* node);
     virtual void Visit(MEM* node);
     virtual void Visit(CALL* node);
     virtual void Visit(ExpList* node, ExpList*& newNode);
@@ -1,37 +1,46 @@
 #include "CodeGenerator.h"
 namespace CodeGenerator {
 	void GenerateCode( ostream &out, const vector<shared_ptr<StmtList>> &blocks,
-					   vector<shared_ptr<CInstrList>> &blockInstructions ) {
+					   const vector<Frame::CFragment> &fragments, vector<CInstrStream> &blockInstructions ) {
+		assert( blocks.size() == fragments.size() );
 		CCodegen generator;
 		CDefaultMap* defMap = new CDefaultMap();
 		for ( int i = 0; i < blocks.size(); ++i ) {
 			out << "===========================" << endl;
-			shared_ptr<StmtList> curBlock = blocks[i];
-			CInstrList* instructs = 0;
-			CInstrList* blockInstructs = 0;
+			CCodegen::CStatistics before = generator.Statistics();
+			shared_ptr<Frame::CFrame> frame = fragments[i].frame;
+			shared_ptr<StmtList> curBlock = frame->ProcEntryExit1( blocks[i] );
+			blockInstructions.push_back( CInstrStream() );
+			CInstrStream& stream = blockInstructions.back();
 			while ( curBlock != 0 ) {
 				assert( curBlock->head != 0 );
-				if ( instructs == 0 ) {
-					instructs = generator.Codegen( curBlock->head );
-					blockInstructs = instructs;
-				} else {
-					while ( instructs->tail != 0 ) {
-						instructs = instructs->tail;
-					}
-					instructs->tail = generator.Codegen( curBlock->head );
-				}
+				generator.Codegen( curBlock->head, stream );
 				curBlock = curBlock->tail;
 			}
 
-			instructs = blockInstructs;
-			while ( instructs != 0 ) {
-				if ( instructs->head != 0 ) {
-					out << instructs->head->format( defMap );
-				}
-				instructs = instructs->tail;
+			const CCodegen::CStatistics& after = generator.Statistics();
+			out << "tiles " << after.tiles - before.tiles << ", IR nodes " << after.nodes - before.nodes
+				<< ", cost " << after.cost - before.cost << ", instructions "
+				<< after.instructions - before.instructions << ", memory accesses "
+				<< after.memoryAccesses - before.memoryAccesses << endl;
+
+			frame->ProcEntryExit2( stream );
+			frame->ProcEntryExit3( stream );
+			for ( int k = 0; k < stream.Size(); ++k ) {
+				out << stream.Format( stream[k], defMap );
 			}
+		}
 
-			blockInstructions.push_back( shared_ptr<CInstrList>(blockInstructs) );
+		// Качество выбора: сколько раз применялось каждое правило грамматики
+		const CCodegen::CStatistics& stats = generator.Statistics();
+		out << "===========================" << endl;
+		out << "tiles " << stats.tiles << ", IR nodes " << stats.nodes << ", cost " << stats.cost
+			<< ", instructions " << stats.instructions << ", memory accesses " << stats.memoryAccesses
+			<< ", reordered tiles " << stats.reordered << endl;
+		for ( int rule = 0; rule < CCodegen::RulesCount(); ++rule ) {
+			if ( stats.ruleUses[rule] != 0 ) {
+				out << "  " << CCodegen::RuleText( rule ) << ": " << stats.ruleUses[rule] << endl;
+			}
 		}
 	}
 }
\ No newline at end of file
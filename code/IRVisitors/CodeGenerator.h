@@ -7,8 +7,9 @@
 namespace CodeGenerator {
 	using namespace IRTree;
 	using namespace Assembler;
+	// Команды методов вместе с входом и выходом (CFrame::ProcEntryExit1-3); blocks и fragments идут в одном порядке
 	void GenerateCode( ostream &out, const vector<shared_ptr<StmtList>> &blocks,
-					   vector<shared_ptr<CInstrList>> &blockInstructions );
+					   const vector<Frame::CFragment> &fragments, vector<CInstrStream> &blockInstructions );
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "DeadStores.h"
+#include "../Structs/FrameSlots.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/Dataflow.h"
+
+namespace Canon {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CDeadStores
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Один проход: живость переменных и ячеек кадра по блокам, затем удаление мёртвых записей
+	class CDeadStores {
+	public:
+		CDeadStores(CControlFlowGraph& _graph) : graph(_graph), frameSlots(_graph), locations(0), removed(0) {}
+
+		void Run(CDeadStoreStatistics& stats) {
+			// Доступы всех операторов нумеруются заранее: от числа мест зависит размер множеств
+			vector<vector<CAccess>> accesses(graph.Size());
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int i = 0; i < graph.blocks[b].stms.size(); i++) {
+					accesses[b].push_back(access(graph.blocks[b].stms[i]));
+				}
+				accesses[b].push_back(access(graph.blocks[b].jump));
+			}
+
+			graph.ComputeEdges();
+			Dataflow::CDataflowGraph flow(graph.Size());
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int s = 0; s < graph.blocks[b].succs.size(); s++) {
+					flow.AddEdge(b, graph.blocks[b].succs[s]);
+				}
+			}
+			// На выходе из метода не живо ничего: кадр освобождается, результат уже в регистре возврата
+			Dataflow::CDataflowSolver<Dataflow::CUnionLattice, Dataflow::D_Backward> solver(flow, locations);
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int i = accesses[b].size() - 1; i >= 0; i--) {
+					const CAccess& a = accesses[b][i];
+					if (a.defined != -1) {
+						solver.kill[b].Set(a.defined);
+						solver.gen[b].Reset(a.defined);
+					}
+					for (int u = 0; u < a.used.size(); u++) {
+						solver.gen[b].Set(a.used[u]);
+					}
+				}
+			}
+			solver.Solve();
+
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				Dataflow::CBitSet live = solver.out[b];
+				vector<IStm*> kept;
+				for (int i = accesses[b].size() - 1; i >= 0; i--) {
+					const CAccess& a = accesses[b][i];
+					if (a.defined != -1 && !live.Test(a.defined) && a.removable) {
+						(a.store ? stats.removedStores : stats.removedDefinitions)++;
+						continue;
+					}
+					if (a.defined != -1) {
+						live.Reset(a.defined);
+					}
+					for (int u = 0; u < a.used.size(); u++) {
+						live.Set(a.used[u]);
+					}
+					if (i < block.stms.size()) {
+						kept.push_back(block.stms[i]);
+					}
+				}
+				removed += block.stms.size() - kept.size();
+				block.stms.assign(kept.rbegin(), kept.rend());
+			}
+		}
+
+		int Removed() const { return removed; }
+
+	private:
+		// Место, которое оператор определяет (-1, если такого нет), и места, которые он читает
+		struct CAccess {
+			CAccess() : defined(-1), store(false), removable(false) {}
+
+			int defined;
+			vector<int> used;
+			bool store;
+			// Оператор можно удалить, если определяемое место мертво
+			bool removable;
+		};
+
+		CControlFlowGraph& graph;
+		CFrameSlots frameSlots;
+		map<const CTemp*, int> temps;
+		map<pair<const CTemp*, int>, int> slots;
+		// Число пронумерованных переменных и ячеек
+		int locations;
+		int removed;
+
+		int temp(const CTemp* t) {
+			map<const CTemp*, int>::iterator it = temps.find(t);
+			return (it != temps.end()) ? it->second : (temps[t] = locations++);
+		}
+
+		int slot(const pair<const CTemp*, int>& s) {
+			map<pair<const CTemp*, int>, int>::iterator it = slots.find(s);
+			return (it != slots.end()) ? it->second : (slots[s] = locations++);
+		}
+
+		void collectReads(IExp* exp, vector<int>& used) {
+			pair<const CTemp*, int> s = frameSlots.Match(exp);
+			if (s.first != nullptr) {
+				used.push_back(slot(s));
+			}
+			shared_ptr<ExpList> kids = exp->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				collectReads(l->head, used);
+			}
+		}
+
+		CAccess access(IStm* stm) {
+			CAccess result;
+			vector<TTemp> uses;
+			IRTree::CollectUses(stm, uses);
+			for (int u = 0; u < uses.size(); u++) {
+				result.used.push_back(temp(uses[u].get()));
+			}
+			// Приёмник MOVE(MEM, ...) не входит в kids(), читаются только его адрес и источник
+			shared_ptr<ExpList> kids = stm->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				collectReads(l->head, result.used);
+			}
+
+			MOVE* move = dynamic_cast<MOVE*>(stm);
+			TTemp def = IRTree::DefinedTemp(stm);
+			if (def != nullptr) {
+				result.defined = temp(def.get());
+				result.removable = IRTree::IsPure(move->src);
+			} else if (move != 0 && frameSlots.Match(move->dst).first != nullptr) {
+				// В каноническом дереве вызов не может быть источником записи в память
+				result.defined = slot(frameSlots.Match(move->dst));
+				result.store = true;
+				result.removable = true;
+			}
+			return result;
+		}
+	};
+
+	void RemoveDeadStores(CControlFlowGraph& graph, CDeadStoreStatistics& stats) {
+		while (true) {
+			stats.iterations++;
+			CDeadStores pass(graph);
+			pass.Run(stats);
+			if (pass.Removed() == 0) {
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef COMPILERS_DEADSTORES_H
+#define COMPILERS_DEADSTORES_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace Canon {
+	struct CDeadStoreStatistics {
+		CDeadStoreStatistics() : removedStores(0), removedDefinitions(0), iterations(0) {}
+
+		// Записи в ячейки кадра, которые дальше не читаются
+		int removedStores;
+		// Определения переменных без использований, правая часть которых не имеет побочных эффектов
+		int removedDefinitions;
+		int iterations;
+	};
+
+	// Удаление мёртвых записей по живости переменных и ячеек кадра (см. CFrameSlots) до неподвижной точки:
+	// удалённая запись может сделать мёртвыми вычисления её значения и адреса.
+	// Граф не должен содержать phi-функций (до построения SSA или после выхода из неё).
+	// Запись в регистр возврата, поля и элементы массивов не удаляются.
+	void RemoveDeadStores(CControlFlowGraph& graph, CDeadStoreStatistics& stats);
+}
+
+#endif //COMPILERS_DEADSTORES_H
@@ -0,0 +1,530 @@
+#include "EscapeAnalysis.h"
+#include "../Structs/ControlFlowGraph.h"
+#include "../Structs/FrameSlots.h"
+#include "../Structs/IRUtils.h"
+
+namespace Canon {
+	using Frame::CFrame;
+	using Frame::CFragment;
+	typedef shared_ptr<const CTemp> TTemp;
+	// Для каждого метода: может ли параметр с данным номером пережить вызов
+	typedef map<const CLabel*, vector<bool>> TSummaries;
+
+	// Массив постоянной длины может быть большим, такой остаётся в куче
+	static const int maxStackWords = 64;
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CEscapeAnalysis
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CEscapeAnalysis {
+	public:
+		CEscapeAnalysis(CControlFlowGraph& _graph, CFrame* _frame, const TSummaries& _summaries) :
+			graph(_graph), frame(_frame), summaries(_summaries), frameSlots(_graph), formalsKnown(true)
+		{
+			findConstants();
+			for (int k = 0; k < frame->formalsCount(); k++) {
+				int formal = location(frame->getFormal(k)->getExp());
+				if (formal == -1) {
+					formalsKnown = false;
+				} else {
+					flags[formal] |= F_Foreign;
+				}
+				formals.push_back(formal);
+			}
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int i = 0; i < graph.blocks[b].stms.size(); i++) {
+					scanStm(graph.blocks[b].stms[i], b, i);
+				}
+				scanStm(graph.blocks[b].jump, b, -1);
+			}
+			classFlags.assign(parents.size(), 0);
+			for (int l = 0; l < parents.size(); l++) {
+				classFlags[find(l)] |= flags[l];
+			}
+		}
+
+		vector<bool> EscapingFormals() {
+			vector<bool> result(formals.size(), !formalsKnown);
+			for (int k = 0; k < formals.size() && formalsKnown; k++) {
+				result[k] = (classFlags[find(formals[k])] & F_Escapes) != 0;
+			}
+			return result;
+		}
+
+		// Возвращает true, если метод изменился
+		bool Rewrite(ostream& out, const string& method, CEscapeStatistics& stats) {
+			graph.ComputeEdges();
+			map<int, int> sites;
+			for (int a = 0; a < allocations.size(); a++) {
+				sites[find(allocations[a].location)]++;
+			}
+
+			map<pair<int, int>, vector<IStm*>> replacements;
+			for (int a = 0; a < allocations.size(); a++) {
+				const CAllocation& allocation = allocations[a];
+				int root = find(allocation.location);
+				stats.allocations++;
+				out << method << ": _malloc(";
+				if (allocation.words == -1) {
+					out << "?) - size is not constant" << endl;
+					continue;
+				}
+				out << allocation.words * CFrame::wordSize << ") - ";
+				if (allocation.words > maxStackWords) {
+					out << "too large" << endl;
+					continue;
+				}
+				if ((classFlags[root] & F_Escapes) != 0) {
+					out << "escapes" << endl;
+					continue;
+				}
+				if ((classFlags[root] & F_TailPassed) != 0) {
+					out << "passed to a tail call" << endl;
+					continue;
+				}
+				if (inLoop(allocation.block)) {
+					out << "allocated in a loop" << endl;
+					continue;
+				}
+
+				vector<IStm*>& stms = replacements[make_pair(allocation.block, allocation.index)];
+				if (sites[root] == 1 && scalar(root, allocation.words)) {
+					vector<TTemp>& words = fields[root];
+					for (int w = 0; w < allocation.words; w++) {
+						words.push_back(make_shared<const CTemp>());
+						stms.push_back(new MOVE(new TEMP(words.back()), new CONST(0)));
+					}
+					// Указатель больше не нужен, копии нуля удалит -fdce
+					stms.push_back(new MOVE(new TEMP(allocation.temp), new CONST(0)));
+					stats.scalarReplacements++;
+					out << "fields replaced by temps" << endl;
+					continue;
+				}
+				int offset = frame->allocObject(allocation.words);
+				stms.push_back(new MOVE(new TEMP(allocation.temp),
+					new BINOP(PLUS_OP, new TEMP(frame->getFP()), new CONST(offset))));
+				// _malloc выделяет обнулённую память; нулевое слово - таблица методов или длина массива
+				for (int w = 1; w < allocation.words; w++) {
+					stms.push_back(new MOVE(new MEM(new BINOP(PLUS_OP, new TEMP(allocation.temp),
+						new CONST(w * CFrame::wordSize))), new CONST(0)));
+				}
+				stats.stackAllocations++;
+				out << "allocated in frame at offset " << offset << endl;
+			}
+			if (replacements.empty()) {
+				return false;
+			}
+
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				vector<IStm*> stms;
+				for (int i = 0; i < block.stms.size(); i++) {
+					map<pair<int, int>, vector<IStm*>>::iterator it = replacements.find(make_pair(b, i));
+					if (it != replacements.end()) {
+						stms.insert(stms.end(), it->second.begin(), it->second.end());
+					} else {
+						stms.push_back(replaceFields(block.stms[i]));
+					}
+				}
+				block.stms.swap(stms);
+				block.jump = replaceFields(block.jump);
+			}
+			return true;
+		}
+
+	private:
+		enum TFlag {
+			// Значение класса может пережить вызов метода
+			F_Escapes = 1,
+			// В классе есть значения не из _malloc этого метода: параметры, загрузки из памяти
+			F_Foreign = 2,
+			// Значение передаётся вызываемому методу, который его не сохраняет
+			F_Passed = 4,
+			F_Compared = 8,
+			// Обращение по непостоянному смещению (элемент массива)
+			F_Indexed = 16,
+			// Значение передаётся хвостовому вызову, который освобождает кадр этого метода
+			F_TailPassed = 32
+		};
+
+		// Вызов _malloc в операторе block:index
+		struct CAllocation {
+			int block;
+			int index;
+			TTemp temp;
+			int location;
+			// Размер в словах или -1, если он не постоянный
+			int words;
+		};
+
+		CControlFlowGraph& graph;
+		CFrame* frame;
+		const TSummaries& summaries;
+		CFrameSlots frameSlots;
+		// Места - переменные и ячейки кадра, в которых может лежать указатель; классы мест - непересекающиеся множества
+		map<const CTemp*, int> temps;
+		map<pair<const CTemp*, int>, int> slots;
+		vector<int> parents;
+		vector<int> flags;
+		vector<int> classFlags;
+		// Обращения к памяти по адресу место + смещение
+		vector<pair<int, int>> accesses;
+		vector<CAllocation> allocations;
+		// Переменные с единственным определением константой
+		map<const CTemp*, int> constants;
+		bool formalsKnown;
+		vector<int> formals;
+		// Слова объектов, заменённых переменными, по классам
+		map<int, vector<TTemp>> fields;
+
+		int newLocation() {
+			parents.push_back(parents.size());
+			flags.push_back(0);
+			return parents.size() - 1;
+		}
+
+		int find(int l) {
+			while (parents[l] != l) {
+				parents[l] = parents[parents[l]];
+				l = parents[l];
+			}
+			return l;
+		}
+
+		void unite(int a, int b) {
+			parents[find(a)] = find(b);
+		}
+
+		// Место, которое читает или пишет exp, или -1. Новые места создаются только при анализе
+		int location(IExp* exp, bool create = true) {
+			if (TEMP* temp = dynamic_cast<TEMP*>(exp)) {
+				if (CFrame::IsRegister(temp->temp.get())) {
+					return -1;
+				}
+				map<const CTemp*, int>::iterator it = temps.find(temp->temp.get());
+				if (it != temps.end()) {
+					return it->second;
+				}
+				return create ? (temps[temp->temp.get()] = newLocation()) : -1;
+			}
+			pair<const CTemp*, int> slot = frameSlots.Match(exp);
+			if (slot.first == nullptr) {
+				return -1;
+			}
+			map<pair<const CTemp*, int>, int>::iterator it = slots.find(slot);
+			if (it != slots.end()) {
+				return it->second;
+			}
+			return create ? (slots[slot] = newLocation()) : -1;
+		}
+
+		void findConstants() {
+			map<const CTemp*, int> definitions;
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int i = 0; i < graph.blocks[b].stms.size(); i++) {
+					IStm* stm = graph.blocks[b].stms[i];
+					TTemp def = IRTree::DefinedTemp(stm);
+					if (def == nullptr) {
+						continue;
+					}
+					definitions[def.get()]++;
+					CONST* value = dynamic_cast<CONST*>(static_cast<MOVE*>(stm)->src);
+					if (value != 0) {
+						constants[def.get()] = value->value;
+					}
+				}
+			}
+			for (map<const CTemp*, int>::iterator it = constants.begin(); it != constants.end();) {
+				it = (definitions[it->first] == 1) ? next(it) : constants.erase(it);
+			}
+		}
+
+		bool evaluate(IExp* exp, int& value) const {
+			if (CONST* constant = dynamic_cast<CONST*>(exp)) {
+				value = constant->value;
+				return true;
+			}
+			if (TEMP* temp = dynamic_cast<TEMP*>(exp)) {
+				map<const CTemp*, int>::const_iterator it = constants.find(temp->temp.get());
+				if (it == constants.end()) {
+					return false;
+				}
+				value = it->second;
+				return true;
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			int left, right;
+			return binop != 0 && evaluate(binop->left, left) && evaluate(binop->right, right)
+				&& IRTree::FoldBinop(binop->binop, left, right, value);
+		}
+
+		// CALL(NAME _malloc, размер), размер в словах или -1
+		bool isAllocation(IExp* exp, int& words) const {
+			CALL* call = dynamic_cast<CALL*>(exp);
+			NAME* name = (call != 0) ? dynamic_cast<NAME*>(call->func) : 0;
+			if (name == 0 || name->label->Name() != "_malloc" || call->args == nullptr || call->args->tail != nullptr) {
+				return false;
+			}
+			int bytes;
+			bool known = evaluate(call->args->head, bytes) && bytes > 0 && bytes % CFrame::wordSize == 0;
+			words = known ? bytes / CFrame::wordSize : -1;
+			return true;
+		}
+
+		// Адрес вида место или место + c
+		bool matchAccess(IExp* address, int& l, int& offset, bool create) {
+			offset = 0;
+			l = location(address, create);
+			if (l != -1) {
+				return true;
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(address);
+			CONST* constant = (binop != 0 && binop->binop == PLUS_OP) ? dynamic_cast<CONST*>(binop->right) : 0;
+			if (constant == 0) {
+				return false;
+			}
+			l = location(binop->left, create);
+			offset = constant->value;
+			return l != -1;
+		}
+
+		//----------------------------------------------------------------------------------------------------------
+		// Analysis
+		//----------------------------------------------------------------------------------------------------------
+
+		void scanStm(IStm* stm, int block, int index) {
+			if (MOVE* move = dynamic_cast<MOVE*>(stm)) {
+				int dst = location(move->dst);
+				if (dst == -1) {
+					// Запись в поле, элемент массива или регистр возврата
+					if (MEM* mem = dynamic_cast<MEM*>(move->dst)) {
+						scanAddress(mem->exp);
+					}
+					scanValue(move->src);
+					return;
+				}
+				int words;
+				TEMP* temp = dynamic_cast<TEMP*>(move->dst);
+				if (temp != 0 && isAllocation(move->src, words)) {
+					CAllocation allocation = { block, index, temp->temp, dst, words };
+					allocations.push_back(allocation);
+					scanExp(move->src);
+					return;
+				}
+				int src = location(move->src);
+				if (src != -1) {
+					unite(dst, src);
+					return;
+				}
+				// Адрес внутри объекта (элемента массива) - тот же указатель
+				BINOP* binop = dynamic_cast<BINOP*>(move->src);
+				int base = (binop != 0 && binop->binop == PLUS_OP) ? location(binop->left) : -1;
+				if (base != -1) {
+					unite(dst, base);
+					flags[dst] |= F_Indexed;
+					scanValue(binop->right);
+					return;
+				}
+				flags[dst] |= F_Foreign;
+				scanExp(move->src);
+			} else if (EXP* exp = dynamic_cast<EXP*>(stm)) {
+				scanExp(exp->exp);
+			} else if (CJUMP* cjump = dynamic_cast<CJUMP*>(stm)) {
+				scanCompared(cjump->left);
+				scanCompared(cjump->right);
+			}
+		}
+
+		// Значение, которое может сохраниться где угодно
+		void scanValue(IExp* exp) {
+			int l = location(exp);
+			if (l != -1) {
+				flags[l] |= F_Escapes;
+				return;
+			}
+			scanExp(exp);
+		}
+
+		void scanCompared(IExp* exp) {
+			int l = location(exp);
+			if (l != -1) {
+				flags[l] |= F_Compared;
+				return;
+			}
+			scanExp(exp);
+		}
+
+		void scanExp(IExp* exp) {
+			if (MEM* mem = dynamic_cast<MEM*>(exp)) {
+				scanAddress(mem->exp);
+				return;
+			}
+			if (CALL* call = dynamic_cast<CALL*>(exp)) {
+				scanCall(call);
+				return;
+			}
+			if (CMP* cmp = dynamic_cast<CMP*>(exp)) {
+				scanCompared(cmp->left);
+				scanCompared(cmp->right);
+				return;
+			}
+			shared_ptr<ExpList> kids = exp->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				scanValue(l->head);
+			}
+		}
+
+		void scanAddress(IExp* address) {
+			int l, offset;
+			if (matchAccess(address, l, offset, true)) {
+				accesses.push_back(make_pair(l, offset));
+				return;
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(address);
+			l = (binop != 0 && binop->binop == PLUS_OP) ? location(binop->left) : -1;
+			if (l != -1) {
+				flags[l] |= F_Indexed;
+				scanValue(binop->right);
+				return;
+			}
+			scanValue(address);
+		}
+
+		void scanCall(CALL* call) {
+			NAME* name = dynamic_cast<NAME*>(call->func);
+			const vector<bool>* summary = 0;
+			if (name != 0) {
+				TSummaries::const_iterator it = summaries.find(name->label.get());
+				summary = (it != summaries.end()) ? &it->second : 0;
+			} else {
+				scanExp(call->func);
+			}
+			int k = 0;
+			for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get(), k++) {
+				int l = location(arg->head);
+				if (l != -1 && summary != 0 && k < summary->size() && !(*summary)[k]) {
+					flags[l] |= call->tail ? F_Passed | F_TailPassed : F_Passed;
+				} else {
+					scanValue(arg->head);
+				}
+			}
+		}
+
+		//----------------------------------------------------------------------------------------------------------
+		// Rewriting
+		//----------------------------------------------------------------------------------------------------------
+
+		// Блок достижим из самого себя: размещение выполняется несколько раз за вызов
+		bool inLoop(int block) const {
+			vector<bool> visited(graph.Size(), false);
+			vector<int> stack(graph.blocks[block].succs);
+			while (!stack.empty()) {
+				int b = stack.back();
+				stack.pop_back();
+				if (b == block) {
+					return true;
+				}
+				if (visited[b]) {
+					continue;
+				}
+				visited[b] = true;
+				stack.insert(stack.end(), graph.blocks[b].succs.begin(), graph.blocks[b].succs.end());
+			}
+			return false;
+		}
+
+		// Объект класса root из words слов виден только этому методу, и его слова известны в каждом обращении
+		bool scalar(int root, int words) {
+			if ((classFlags[root] & (F_Foreign | F_Passed | F_Compared | F_Indexed)) != 0) {
+				return false;
+			}
+			for (int a = 0; a < accesses.size(); a++) {
+				int offset = accesses[a].second;
+				if (find(accesses[a].first) == root
+					&& (offset < 0 || offset >= words * CFrame::wordSize || offset % CFrame::wordSize != 0)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		IExp* replaceField(IExp* exp) {
+			MEM* mem = dynamic_cast<MEM*>(exp);
+			int l, offset;
+			if (mem == 0 || !matchAccess(mem->exp, l, offset, false)) {
+				return exp;
+			}
+			map<int, vector<TTemp>>::iterator it = fields.find(find(l));
+			return (it != fields.end()) ? new TEMP(it->second[offset / CFrame::wordSize]) : exp;
+		}
+
+		IStm* replaceFields(IStm* stm) {
+			if (fields.empty()) {
+				return stm;
+			}
+			IRTree::TExpRewriter rewriter = [this](IExp* exp) { return replaceField(exp); };
+			MOVE* move = dynamic_cast<MOVE*>(stm);
+			if (move != 0 && dynamic_cast<MEM*>(move->dst) != 0) {
+				IExp* field = replaceField(move->dst);
+				if (field != move->dst) {
+					return new MOVE(field, IRTree::RewriteExp(move->src, rewriter));
+				}
+			}
+			return IRTree::RewriteStm(stm, rewriter);
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// ReplaceAllocations
+	//--------------------------------------------------------------------------------------------------------------
+
+	void ReplaceAllocations(ostream& out, vector<shared_ptr<StmtList>>& stmts, const vector<CFragment>& fragments,
+		CEscapeStatistics& stats)
+	{
+		assert(stmts.size() == fragments.size());
+		vector<shared_ptr<CControlFlowGraph>> graphs;
+		TSummaries summaries;
+		for (int f = 0; f < stmts.size(); f++) {
+			graphs.push_back(make_shared<CControlFlowGraph>(stmts[f]));
+			summaries[fragments[f].label.get()] = vector<bool>(fragments[f].frame->formalsCount(), false);
+		}
+
+		// Сводки только растут: параметр, убегающий при текущих сводках, убегает и при больших
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			stats.analysisIterations++;
+			for (int f = 0; f < graphs.size(); f++) {
+				CEscapeAnalysis analysis(*graphs[f], fragments[f].frame.get(), summaries);
+				vector<bool> escaping = analysis.EscapingFormals();
+				vector<bool>& summary = summaries[fragments[f].label.get()];
+				for (int k = 0; k < summary.size(); k++) {
+					if (escaping[k] && !summary[k]) {
+						summary[k] = true;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		for (int f = 0; f < graphs.size(); f++) {
+			const string& method = fragments[f].label->Name();
+			const vector<bool>& summary = summaries[fragments[f].label.get()];
+			out << method << ": escaping parameters";
+			bool any = false;
+			for (int k = 0; k < summary.size(); k++) {
+				if (summary[k]) {
+					out << " " << k;
+					any = true;
+				}
+			}
+			out << (any ? "" : " none") << endl;
+
+			CEscapeAnalysis analysis(*graphs[f], fragments[f].frame.get(), summaries);
+			if (analysis.Rewrite(out, method, stats)) {
+				stmts[f] = graphs[f]->ToStmtList();
+			}
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef COMPILERS_ESCAPEANALYSIS_H
+#define COMPILERS_ESCAPEANALYSIS_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+#include "../Structs/Frame.h"
+
+namespace Canon {
+	using namespace IRTree;
+
+	struct CEscapeStatistics {
+		CEscapeStatistics() : allocations(0), stackAllocations(0), scalarReplacements(0), analysisIterations(0) {}
+
+		// Вызовы _malloc в программе
+		int allocations;
+		// Объекты и массивы, размещённые в кадре вызывающего метода
+		int stackAllocations;
+		// Объекты, поля которых стали переменными
+		int scalarReplacements;
+		// Проходы по всем методам до неподвижной точки сводок параметров
+		int analysisIterations;
+	};
+
+	// Анализ убегания над линеаризованными деревьями. Переменные и ячейки кадра, между которыми копируются
+	// указатели, объединяются в классы; класс убегает, если его значение записывается в поле или элемент массива,
+	// возвращается из метода, участвует в арифметике или передаётся параметром, который убегает в вызываемом
+	// методе. Сводки параметров прямых вызовов вычисляются до неподвижной точки, при виртуальном вызове
+	// аргументы убегают.
+	// Неубегающий MOVE(TEMP t, CALL(_malloc, размер)) с постоянным размером вне циклов размещается в кадре
+	// (см. CFrame::allocObject) с обнулением слов после первого. Если объект - единственное значение своего класса
+	// и к нему обращаются только по постоянным смещениям, его слова заменяются переменными.
+	// Указатель на объект в кадре, переданный другому методу, делает адрес кадра видимым, и ячейки этого метода
+	// уже не переносятся в переменные (см. CFrameSlots). Отчёт о каждом вызове _malloc выводится в out.
+	void ReplaceAllocations(ostream& out, vector<shared_ptr<StmtList>>& stmts, const vector<Frame::CFragment>& fragments,
+		CEscapeStatistics& stats);
+}
+
+#endif //COMPILERS_ESCAPEANALYSIS_H
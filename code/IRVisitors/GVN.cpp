@@ -0,0 +1,422 @@
+#include "GVN.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/Aliasing.h"
+
+namespace SSA {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Memory
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Версии памяти: all меняется при записи в неизвестную ячейку и вызове, any - при любой записи
+	struct CMemoryState {
+		CMemoryState() : all(0), any(0) {}
+
+		int all;
+		int any;
+		map<string, int> classes;
+	};
+
+	// Что блок может изменить в памяти
+	struct CMemoryKills {
+		CMemoryKills() : all(false) {}
+
+		bool all;
+		set<string> classes;
+	};
+
+	static bool containsCall(IStm* stm) {
+		MOVE* move = dynamic_cast<MOVE*>(stm);
+		EXP* exp = dynamic_cast<EXP*>(stm);
+		return (move != 0 && dynamic_cast<CALL*>(move->src) != 0) || (exp != 0 && dynamic_cast<CALL*>(exp->exp) != 0);
+	}
+
+	static bool isCommutative(ArithmeticOpType op) {
+		return op == PLUS_OP || op == MULT_OP || op == AND_OP || op == OR_OP;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CValueNumbering
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CValueNumbering {
+	public:
+		CValueNumbering(CControlFlowGraph& _graph, CValueNumberingStatistics& _stats) :
+			graph(_graph), stats(_stats), aliases(_graph), nextVersion(0), exitStates(_graph.Size()), kills(_graph.Size()) {}
+
+		void Run() {
+			graph.ComputeDominators();
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int i = 0; i < block.stms.size(); i++) {
+					MOVE* move = dynamic_cast<MOVE*>(block.stms[i]);
+					if (move != 0 && dynamic_cast<MEM*>(move->dst) != 0) {
+						kills[b].classes.insert(aliases.Classify(static_cast<MEM*>(move->dst)->exp));
+					}
+					kills[b].all = kills[b].all || containsCall(block.stms[i]);
+				}
+			}
+			walk(0);
+			inlineUnused();
+		}
+
+	private:
+		CControlFlowGraph& graph;
+		CValueNumberingStatistics& stats;
+		CAliasAnalysis aliases;
+		map<const CTemp*, TTemp> leaders;
+		// Доступные значения, видимые из текущего блока дерева доминаторов, и журнал для отката
+		map<string, TTemp> table;
+		vector<pair<string, TTemp>> undo;
+		int nextVersion;
+		vector<CMemoryState> exitStates;
+		vector<CMemoryKills> kills;
+		CMemoryState memory;
+		vector<IStm*> pending;
+		// Каждое подходящее подвыражение выносится во временную переменную, чтобы его нашли
+		// последующие вычисления; те, что так и не понадобились повторно, возвращаются на место
+		map<const CTemp*, IExp*> materialized;
+
+		TTemp leader(TTemp temp) const {
+			map<const CTemp*, TTemp>::const_iterator it = leaders.find(temp.get());
+			while (it != leaders.end()) {
+				temp = it->second;
+				it = leaders.find(temp.get());
+			}
+			return temp;
+		}
+
+		void remember(const string& key, TTemp temp) {
+			map<string, TTemp>::iterator it = table.find(key);
+			undo.push_back(make_pair(key, (it != table.end()) ? it->second : nullptr));
+			table[key] = temp;
+		}
+
+		void killAll(CMemoryState& state) {
+			state.all = ++nextVersion;
+			state.any = ++nextVersion;
+			state.classes.clear();
+		}
+
+		void kill(CMemoryState& state, const string& memClass) {
+			if (memClass == "?") {
+				killAll(state);
+				return;
+			}
+			state.classes[memClass] = ++nextVersion;
+			state.any = ++nextVersion;
+		}
+
+		string version(const string& memClass) {
+			int classVersion = (memClass == "?") ? memory.any : memory.classes[memClass];
+			return "v" + to_string(memory.all) + "." + to_string(classVersion);
+		}
+
+		// Ключ выражения с версиями памяти; пустая строка - выражение не нумеруется
+		string key(IExp* exp) {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				return "t" + temp->temp->Name();
+			}
+			CONST* constant = dynamic_cast<CONST*>(exp);
+			if (constant != 0) {
+				return "#" + to_string(constant->value);
+			}
+			NAME* name = dynamic_cast<NAME*>(exp);
+			if (name != 0) {
+				return "@" + name->label->Name();
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			if (binop != 0) {
+				string left = key(binop->left);
+				string right = key(binop->right);
+				if (left.empty() || right.empty()) {
+					return "";
+				}
+				if (isCommutative(binop->binop) && right < left) {
+					swap(left, right);
+				}
+				return "(" + to_string(binop->binop) + " " + left + " " + right + ")";
+			}
+			CMP* cmp = dynamic_cast<CMP*>(exp);
+			if (cmp != 0) {
+				string left = key(cmp->left);
+				string right = key(cmp->right);
+				if (left.empty() || right.empty()) {
+					return "";
+				}
+				return "(?" + to_string(cmp->relop) + " " + left + " " + right + ")";
+			}
+			MEM* mem = dynamic_cast<MEM*>(exp);
+			if (mem != 0) {
+				string address = key(mem->exp);
+				if (address.empty()) {
+					return "";
+				}
+				return "[" + address + "]" + version(aliases.Classify(mem->exp));
+			}
+			return "";
+		}
+
+		// Подвыражение стоит отдельной переменной, если это чтение памяти или хотя бы две операции
+		bool worthTemp(IExp* exp) {
+			if (dynamic_cast<MEM*>(exp) != 0) {
+				return true;
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			return binop != 0 && (!IRTree::IsLeaf(binop->left) || !IRTree::IsLeaf(binop->right));
+		}
+
+		void countEliminated(IExp* exp) {
+			if (dynamic_cast<MEM*>(exp) != 0) {
+				stats.eliminatedLoads++;
+			} else {
+				stats.eliminatedExpressions++;
+			}
+		}
+
+		IExp* number(IExp* exp) {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				TTemp value = leader(temp->temp);
+				return (value != temp->temp) ? new TEMP(value) : exp;
+			}
+			if ((dynamic_cast<BINOP*>(exp) == 0 && dynamic_cast<MEM*>(exp) == 0) || IRTree::IsOffsetAddress(exp)) {
+				return exp;
+			}
+			string k = key(exp);
+			if (k.empty()) {
+				return exp;
+			}
+			map<string, TTemp>::iterator it = table.find(k);
+			if (it != table.end()) {
+				countEliminated(exp);
+				return new TEMP(it->second);
+			}
+			if (worthTemp(exp)) {
+				TTemp result = make_shared<const CTemp>();
+				pending.push_back(new MOVE(new TEMP(result), exp));
+				remember(k, result);
+				aliases.Define(result, exp);
+				materialized[result.get()] = exp;
+				return new TEMP(result);
+			}
+			return exp;
+		}
+
+		IExp* numberKids(IExp* exp) {
+			IRTree::TExpRewriter rewriter = [this](IExp* e) { return number(e); };
+			shared_ptr<ExpList> kids = exp->kids();
+			if (kids == nullptr) {
+				return number(exp);
+			}
+			vector<IExp*> rewritten;
+			bool changed = false;
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				rewritten.push_back(IRTree::RewriteExp(l->head, rewriter));
+				changed = changed || rewritten.back() != l->head;
+			}
+			return changed ? exp->build(IRTree::MakeExpList(rewritten)) : exp;
+		}
+
+		void numberStm(IStm* stm, vector<IStm*>& result) {
+			IRTree::TExpRewriter rewriter = [this](IExp* e) { return number(e); };
+			pending.clear();
+			MOVE* move = dynamic_cast<MOVE*>(stm);
+			TTemp def = IRTree::DefinedTemp(stm);
+			if (def != nullptr) {
+				if (dynamic_cast<TEMP*>(move->src) != 0) {
+					leaders[def.get()] = leader(static_cast<TEMP*>(move->src)->temp);
+					stats.propagatedCopies++;
+					return;
+				}
+				IExp* src = numberKids(move->src);
+				bool numbered = !IRTree::IsLeaf(src) && dynamic_cast<CALL*>(src) == 0;
+				string k = numbered ? key(src) : "";
+				map<string, TTemp>::iterator it = k.empty() ? table.end() : table.find(k);
+				result.insert(result.end(), pending.begin(), pending.end());
+				if (it != table.end()) {
+					countEliminated(src);
+					leaders[def.get()] = it->second;
+					return;
+				}
+				if (!k.empty()) {
+					remember(k, def);
+				}
+				result.push_back((src != move->src) ? new MOVE(move->dst, src) : stm);
+			} else if (move != 0 && dynamic_cast<MEM*>(move->dst) != 0) {
+				IExp* address = IRTree::RewriteExp(static_cast<MEM*>(move->dst)->exp, rewriter);
+				IExp* src = IRTree::RewriteExp(move->src, rewriter);
+				result.insert(result.end(), pending.begin(), pending.end());
+				result.push_back(new MOVE(new MEM(address), src));
+				kill(memory, aliases.Classify(address));
+				// Следующее чтение той же ячейки получит записанное значение
+				TEMP* stored = dynamic_cast<TEMP*>(src);
+				string k = key(new MEM(address));
+				if (stored != 0 && !k.empty()) {
+					remember(k, stored->temp);
+				}
+			} else {
+				IStm* rewritten = IRTree::RewriteStm(stm, rewriter);
+				result.insert(result.end(), pending.begin(), pending.end());
+				result.push_back(rewritten);
+			}
+			if (containsCall(stm)) {
+				killAll(memory);
+			}
+		}
+
+		// Переменная, использованная один раз, - это исходное место выражения: повтора не нашлось.
+		// Между её определением и использованием только такие же вынесенные чистые вычисления
+		// и чтения, поэтому выражение можно вернуть на место.
+		void inlineUnused() {
+			map<const CTemp*, int> uses;
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				vector<TTemp> temps;
+				for (int i = 0; i < block.stms.size(); i++) {
+					IRTree::CollectUses(block.stms[i], temps);
+				}
+				IRTree::CollectUses(block.jump, temps);
+				for (int p = 0; p < block.phis.size(); p++) {
+					temps.insert(temps.end(), block.phis[p].args.begin(), block.phis[p].args.end());
+				}
+				for (int t = 0; t < temps.size(); t++) {
+					uses[temps[t].get()]++;
+				}
+			}
+			map<const CTemp*, IExp*> unused;
+			for (map<const CTemp*, IExp*>::iterator it = materialized.begin(); it != materialized.end(); it++) {
+				if (uses[it->first] == 1) {
+					unused.insert(*it);
+				} else {
+					stats.materialized++;
+				}
+			}
+			if (unused.empty()) {
+				return;
+			}
+			IRTree::TExpRewriter rewriter;
+			rewriter = [&unused, &rewriter](IExp* e) {
+				TEMP* temp = dynamic_cast<TEMP*>(e);
+				map<const CTemp*, IExp*>::iterator it = (temp != 0) ? unused.find(temp->temp.get()) : unused.end();
+				return (it != unused.end()) ? IRTree::RewriteExp(it->second, rewriter) : e;
+			};
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				vector<IStm*> stms;
+				for (int i = 0; i < block.stms.size(); i++) {
+					TTemp def = IRTree::DefinedTemp(block.stms[i]);
+					if (def == nullptr || unused.find(def.get()) == unused.end()) {
+						stms.push_back(IRTree::RewriteStm(block.stms[i], rewriter));
+					}
+				}
+				block.stms.swap(stms);
+				block.jump = IRTree::RewriteStm(block.jump, rewriter);
+			}
+		}
+
+		// Версии памяти на входе блока: как на выходе непосредственного доминатора, кроме классов,
+		// которые могут измениться на путях от него к блоку
+		CMemoryState entryState(int b) {
+			if (b == 0) {
+				return CMemoryState();
+			}
+			int idom = graph.idom[b];
+			CMemoryState state = exitStates[idom];
+			CMemoryKills region;
+			vector<bool> visited(graph.Size(), false);
+			vector<int> stack(graph.blocks[b].preds.begin(), graph.blocks[b].preds.end());
+			while (!stack.empty()) {
+				int x = stack.back();
+				stack.pop_back();
+				if (x == idom || visited[x]) {
+					continue;
+				}
+				visited[x] = true;
+				region.all = region.all || kills[x].all;
+				region.classes.insert(kills[x].classes.begin(), kills[x].classes.end());
+				stack.insert(stack.end(), graph.blocks[x].preds.begin(), graph.blocks[x].preds.end());
+			}
+			if (region.all) {
+				killAll(state);
+			}
+			for (set<string>::iterator it = region.classes.begin(); it != region.classes.end(); it++) {
+				kill(state, *it);
+			}
+			return state;
+		}
+
+		void walk(int b) {
+			int mark = undo.size();
+			memory = entryState(b);
+			CBlock& block = graph.blocks[b];
+			vector<IStm*> stms;
+			for (int i = 0; i < block.stms.size(); i++) {
+				numberStm(block.stms[i], stms);
+			}
+			IRTree::TExpRewriter rewriter = [this](IExp* e) { return number(e); };
+			pending.clear();
+			block.jump = IRTree::RewriteStm(block.jump, rewriter);
+			stms.insert(stms.end(), pending.begin(), pending.end());
+			block.stms.swap(stms);
+			exitStates[b] = memory;
+
+			for (int s = 0; s < block.succs.size(); s++) {
+				CBlock& succ = graph.blocks[block.succs[s]];
+				int j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+				for (int p = 0; p < succ.phis.size(); p++) {
+					succ.phis[p].args[j] = leader(succ.phis[p].args[j]);
+				}
+			}
+			for (int c = 0; c < graph.domChildren[b].size(); c++) {
+				walk(graph.domChildren[b][c]);
+			}
+
+			while (undo.size() > mark) {
+				if (undo.back().second == nullptr) {
+					table.erase(undo.back().first);
+				} else {
+					table[undo.back().first] = undo.back().second;
+				}
+				undo.pop_back();
+			}
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Interface
+	//--------------------------------------------------------------------------------------------------------------
+
+	static int countLoads(IExp* exp) {
+		int count = (dynamic_cast<MEM*>(exp) != 0) ? 1 : 0;
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			count += countLoads(l->head);
+		}
+		return count;
+	}
+
+	int CountLoads(const CControlFlowGraph& graph) {
+		int count = 0;
+		for (int b = 0; b < graph.Size(); b++) {
+			const CBlock& block = graph.blocks[b];
+			for (int i = 0; i <= block.stms.size(); i++) {
+				// Приёмник MOVE(MEM(a), e) в kids() не входит, входит только адрес a
+				shared_ptr<ExpList> kids = ((i < block.stms.size()) ? block.stms[i] : block.jump)->kids();
+				for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+					count += countLoads(l->head);
+				}
+			}
+		}
+		return count;
+	}
+
+	void NumberValues(CControlFlowGraph& graph, CValueNumberingStatistics& stats) {
+		stats.loadsBefore += CountLoads(graph);
+		CValueNumbering numbering(graph, stats);
+		numbering.Run();
+		stats.loadsAfter += CountLoads(graph);
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef COMPILERS_GVN_H
+#define COMPILERS_GVN_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace SSA {
+	using namespace Canon;
+
+	struct CValueNumberingStatistics {
+		CValueNumberingStatistics() : loadsBefore(0), loadsAfter(0), eliminatedExpressions(0), eliminatedLoads(0),
+			propagatedCopies(0), materialized(0) {}
+
+		// Чтения памяти в коде функции (статически)
+		int loadsBefore;
+		int loadsAfter;
+		int eliminatedExpressions;
+		int eliminatedLoads;
+		int propagatedCopies;
+		// Повторяющиеся подвыражения, вынесенные во временные переменные
+		int materialized;
+	};
+
+	// Нумерация значений обходом дерева доминаторов: вычисление, уже выполненное в доминирующем
+	// месте, заменяется его результатом. Чтения памяти нумеруются вместе с версией памяти:
+	// запись меняет версию только своего класса ячеек (см. CAliasAnalysis),
+	// вызов и запись по неизвестному адресу - всю память.
+	void NumberValues(CControlFlowGraph& graph, CValueNumberingStatistics& stats);
+
+	// Число чтений памяти (MEM не в роли приёмника MOVE)
+	int CountLoads(const CControlFlowGraph& graph);
+}
+
+#endif //COMPILERS_GVN_H
@@ -0,0 +1,270 @@
+#include "IfConversion.h"
+#include "../Structs/IRUtils.h"
+
+namespace Canon {
+	using Temp::CTemp;
+	using Temp::CLabel;
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Присваиваний в одной ветви и узлов в присваиваемом выражении
+	static const int maxArmMoves = 2;
+	static const int maxArmNodes = 4;
+
+	static int size(IExp* exp) {
+		int n = 1;
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			n += size(l->head);
+		}
+		return n;
+	}
+
+	static bool isConst(IExp* exp, int value) {
+		CONST* constant = dynamic_cast<CONST*>(exp);
+		return constant != 0 && constant->value == value;
+	}
+
+	static bool isTemp(IExp* exp, const TTemp& temp) {
+		TEMP* t = dynamic_cast<TEMP*>(exp);
+		return t != 0 && t->temp == temp;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CBranchConverter
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CBranchConverter {
+	public:
+		CBranchConverter(vector<IStm*>& _code, CIfConversionStatistics& _stats) : code(_code), stats(_stats) {
+			for (int i = 0; i < code.size(); i++) {
+				if (JUMP* jump = dynamic_cast<JUMP*>(code[i])) {
+					references[jump->target]++;
+				} else if (CJUMP* cjump = dynamic_cast<CJUMP*>(code[i])) {
+					references[cjump->iftrue]++;
+					references[cjump->iffalse]++;
+					stats.conditionalJumps++;
+				}
+			}
+		}
+
+		// Ветвление, начинающееся условным переходом code[i]; true, если оно заменено выборами
+		bool Convert(ostream& out, const string& method, int& i) {
+			CJUMP* cjump = dynamic_cast<CJUMP*>(code[i]);
+			int j = i + 1;
+			if (cjump == 0 || !isOwnLabel(j, cjump->iffalse)) {
+				return false;
+			}
+			j++;
+			vector<pair<TTemp, IExp*>> falseArm;
+			vector<pair<TTemp, IExp*>> trueArm;
+			if (!parseArm(j, falseArm) || j == code.size()) {
+				return false;
+			}
+			// Ветвь T идёт сразу за ветвью F или вынесена трассировкой: LABEL T после безусловного перехода,
+			// присваивания и JUMP на слияние. Оператор слияния code[end] (метка или переход) остаётся
+			const CLabel* join = joinOf(j);
+			if (join == 0) {
+				return false;
+			}
+			bool diamond = true;
+			int end = j;
+			int trueBegin = -1;
+			int trueEnd = -1;
+			if (join == cjump->iftrue && dynamic_cast<LABEL*>(code[j]) != 0) {
+				diamond = false;
+			} else if (dynamic_cast<JUMP*>(code[j]) != 0 && isOwnLabel(j + 1, cjump->iftrue)) {
+				end = j + 2;
+				if (!parseArm(end, trueArm) || joinOf(end) != join) {
+					return false;
+				}
+			} else {
+				trueBegin = labelIndex(cjump->iftrue);
+				if (trueBegin <= 0 || (trueBegin >= i && trueBegin <= end)
+					|| !isOwnLabel(trueBegin, cjump->iftrue) || dynamic_cast<JUMP*>(code[trueBegin - 1]) == 0) {
+					return false;
+				}
+				trueEnd = trueBegin + 1;
+				JUMP* back = (parseArm(trueEnd, trueArm) && trueEnd < code.size()) ? dynamic_cast<JUMP*>(code[trueEnd]) : 0;
+				if (back == 0 || back->target != join) {
+					return false;
+				}
+				trueEnd++;
+			}
+
+			vector<TTemp> defined;
+			collectDefined(falseArm, defined);
+			collectDefined(trueArm, defined);
+			if (defined.empty()) {
+				return false;
+			}
+			vector<IStm*> replacement;
+			IExp* left = cjump->left;
+			IExp* right = cjump->right;
+			// Сложные операнды сравнения вычисляются один раз на все выборы
+			if (defined.size() > 1) {
+				left = hoist(left, replacement);
+				right = hoist(right, replacement);
+			}
+			int selects = 0;
+			for (int k = 0; k < defined.size(); k++) {
+				IExp* iftrue = valueOf(trueArm, defined[k]);
+				IExp* iffalse = valueOf(falseArm, defined[k]);
+				// Выбор не должен читать переменные, уже записанные предыдущими выборами
+				vector<TTemp> uses;
+				IRTree::CollectUses(new SELECT(cjump->relop, left, right, iftrue, iffalse), uses);
+				for (int u = 0; u < uses.size(); u++) {
+					if (find(defined.begin(), defined.begin() + k, uses[u]) != defined.begin() + k) {
+						return false;
+					}
+				}
+				CJUMP_OP relop = cjump->relop;
+				// Значение, которое остаётся прежним, - второе: тогда выбор - один cmov в саму переменную
+				if (isTemp(iftrue, defined[k])) {
+					swap(iftrue, iffalse);
+					relop = NegateRelop(relop);
+				}
+				IExp* value;
+				if ((isConst(iftrue, 1) && isConst(iffalse, 0)) || (isConst(iftrue, 0) && isConst(iffalse, 1))) {
+					value = new CMP(isConst(iftrue, 1) ? relop : NegateRelop(relop), left, right);
+				} else {
+					value = new SELECT(relop, left, right, iftrue, iffalse);
+					selects++;
+				}
+				replacement.push_back(new MOVE(new TEMP(defined[k]), value));
+			}
+			stats.selects += selects;
+			stats.comparisons += defined.size() - selects;
+			(diamond ? stats.diamonds : stats.triangles)++;
+			out << method << ": " << (diamond ? "diamond " : "triangle ") << cjump->iftrue->Name() << "/"
+				<< cjump->iffalse->Name() << ", " << defined.size() << " assignments" << endl;
+
+			if (trueBegin > end) {
+				code.erase(code.begin() + trueBegin, code.begin() + trueEnd);
+			}
+			code.erase(code.begin() + i, code.begin() + end);
+			code.insert(code.begin() + i, replacement.begin(), replacement.end());
+			if (trueBegin != -1 && trueBegin < i) {
+				code.erase(code.begin() + trueBegin, code.begin() + trueEnd);
+				i -= trueEnd - trueBegin;
+			}
+			i += replacement.size();
+			return true;
+		}
+
+	private:
+		vector<IStm*>& code;
+		CIfConversionStatistics& stats;
+		map<const CLabel*, int> references;
+
+		// Метка или цель безусловного перехода в code[j], иначе 0
+		const CLabel* joinOf(int j) {
+			if (j >= code.size()) {
+				return 0;
+			}
+			if (LABEL* label = dynamic_cast<LABEL*>(code[j])) {
+				return label->label;
+			}
+			JUMP* jump = dynamic_cast<JUMP*>(code[j]);
+			return (jump != 0 && (jump->exp == 0 || dynamic_cast<NAME*>(jump->exp) != 0)) ? jump->target : 0;
+		}
+
+		// Позиция оператора LABEL l или -1
+		int labelIndex(const CLabel* l) {
+			for (int k = 0; k < code.size(); k++) {
+				LABEL* label = dynamic_cast<LABEL*>(code[k]);
+				if (label != 0 && label->label == l) {
+					return k;
+				}
+			}
+			return -1;
+		}
+
+		// LABEL l, на которую переходит только условный переход ветвления
+		bool isOwnLabel(int j, const CLabel* l) {
+			LABEL* label = (j < code.size()) ? dynamic_cast<LABEL*>(code[j]) : 0;
+			return label != 0 && label->label == l && references[l] == 1;
+		}
+
+		// Присваивания ветви до первого оператора другого вида; метки без переходов на них пропускаются
+		bool parseArm(int& j, vector<pair<TTemp, IExp*>>& arm) {
+			for (; j < code.size(); j++) {
+				LABEL* label = dynamic_cast<LABEL*>(code[j]);
+				if (label != 0 && references[label->label] == 0) {
+					continue;
+				}
+				TTemp temp = IRTree::DefinedTemp(code[j]);
+				if (temp == nullptr) {
+					return true;
+				}
+				IExp* value = static_cast<MOVE*>(code[j])->src;
+				if (arm.size() == maxArmMoves || !IRTree::IsPure(value) || size(value) > maxArmNodes) {
+					return false;
+				}
+				for (int k = 0; k < arm.size(); k++) {
+					if (arm[k].first == temp) {
+						return false;
+					}
+				}
+				arm.push_back(make_pair(temp, value));
+			}
+			return true;
+		}
+
+		static void collectDefined(const vector<pair<TTemp, IExp*>>& arm, vector<TTemp>& defined) {
+			for (int k = 0; k < arm.size(); k++) {
+				if (find(defined.begin(), defined.end(), arm[k].first) == defined.end()) {
+					defined.push_back(arm[k].first);
+				}
+			}
+		}
+
+		// Значение переменной после ветви
+		static IExp* valueOf(const vector<pair<TTemp, IExp*>>& arm, const TTemp& temp) {
+			for (int k = 0; k < arm.size(); k++) {
+				if (arm[k].first == temp) {
+					return arm[k].second;
+				}
+			}
+			return new TEMP(temp);
+		}
+
+		static IExp* hoist(IExp* exp, vector<IStm*>& replacement) {
+			if (IRTree::IsLeaf(exp)) {
+				return exp;
+			}
+			TTemp temp = make_shared<const CTemp>();
+			replacement.push_back(new MOVE(new TEMP(temp), exp));
+			return new TEMP(temp);
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Driver
+	//--------------------------------------------------------------------------------------------------------------
+
+	void ConvertBranches(ostream& out, vector<shared_ptr<StmtList>>& stmts, CIfConversionStatistics& stats) {
+		for (int f = 0; f < stmts.size(); f++) {
+			vector<IStm*> code;
+			stmts[f]->toVector(code);
+			LABEL* entry = dynamic_cast<LABEL*>(code[0]);
+			string method = (entry != 0) ? entry->label->Name() : to_string(f);
+			CBranchConverter converter(code, stats);
+			bool changed = false;
+			for (int i = 0; i < code.size();) {
+				if (!converter.Convert(out, method, i)) {
+					i++;
+				} else {
+					changed = true;
+				}
+			}
+			if (!changed) {
+				continue;
+			}
+			shared_ptr<StmtList> list = nullptr;
+			for (int i = code.size() - 1; i >= 0; i--) {
+				list = make_shared<StmtList>(code[i], list);
+			}
+			stmts[f] = list;
+		}
+	}
+}
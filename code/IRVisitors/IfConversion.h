@@ -0,0 +1,32 @@
+#ifndef COMPILERS_IFCONVERSION_H
+#define COMPILERS_IFCONVERSION_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+
+namespace Canon {
+	using namespace IRTree;
+
+	struct CIfConversionStatistics {
+		CIfConversionStatistics() : conditionalJumps(0), triangles(0), diamonds(0), selects(0), comparisons(0) {}
+
+		// Условные переходы в оттрассированном коде до преобразования
+		int conditionalJumps;
+		// Заменённые ветвления с одной ветвью (переход через неё) и с двумя ветвями
+		int triangles;
+		int diamonds;
+		// Получившиеся выборы SELECT и сравнения CMP (выбор между 1 и 0)
+		int selects;
+		int comparisons;
+	};
+
+	// Замена ветвлений выборами без переходов в оттрассированном коде. Ветвление
+	//   CJUMP(op, a, b, T, F); LABEL F; ветвь F; [JUMP J; LABEL T; ветвь T;] LABEL J
+	// (при одной ветви J = T), метки которого не используются другими переходами, а ветви состоят
+	// не более чем из двух присваиваний переменным чистых выражений без обращений к памяти, становится
+	// присваиваниями x = SELECT(op, a, b, значение x в ветви T, значение x в ветви F). Выбор между 1 и 0 -
+	// это сравнение CMP. Ветви не должны читать переменные, которые в них присваиваются: выборы выполняются
+	// последовательно. Отчёт о каждом ветвлении выводится в out.
+	void ConvertBranches(ostream& out, vector<shared_ptr<StmtList>>& stmts, CIfConversionStatistics& stats);
+}
+
+#endif //COMPILERS_IFCONVERSION_H
@@ -0,0 +1,384 @@
+#include "Inliner.h"
+#include "../Structs/Aliasing.h"
+
+// Бюджет роста дерева метода от встраивания, в узлах; задаётся при сборке
+#ifndef INLINE_BUDGET
+#define INLINE_BUDGET 64
+#endif
+
+namespace Canon {
+	using Frame::CFrame;
+	using Frame::CFragment;
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Глубина вложенных встраиваний
+	static const int maxDepth = 3;
+
+	// Непосредственные потомки узла, включая операторы SEQ и ESEQ и приёмник MOVE
+	static vector<INode*> children(INode* node) {
+		vector<INode*> result;
+		if (SEQ* seq = dynamic_cast<SEQ*>(node)) {
+			result.push_back(seq->left);
+			result.push_back(seq->right);
+		} else if (ESEQ* eseq = dynamic_cast<ESEQ*>(node)) {
+			result.push_back(eseq->stm);
+			result.push_back(eseq->exp);
+		} else if (MOVE* move = dynamic_cast<MOVE*>(node)) {
+			result.push_back(move->dst);
+			result.push_back(move->src);
+		} else {
+			IExp* exp = dynamic_cast<IExp*>(node);
+			shared_ptr<ExpList> kids = (exp != 0) ? exp->kids() : static_cast<IStm*>(node)->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				result.push_back(l->head);
+			}
+		}
+		return result;
+	}
+
+	static int countNodes(INode* node) {
+		vector<INode*> kids = children(node);
+		int count = 1;
+		for (int i = 0; i < kids.size(); i++) {
+			count += countNodes(kids[i]);
+		}
+		return count;
+	}
+
+	// Ячейка кадра MEM(fp + c)
+	static bool isFrameSlot(IExp* exp, const CTemp* framePointer, int& offset) {
+		MEM* mem = dynamic_cast<MEM*>(exp);
+		BINOP* address = (mem != 0) ? dynamic_cast<BINOP*>(mem->exp) : 0;
+		if (address == 0 || address->binop != PLUS_OP) {
+			return false;
+		}
+		TEMP* base = dynamic_cast<TEMP*>(address->left);
+		CONST* constant = dynamic_cast<CONST*>(address->right);
+		if (base == 0 || constant == 0 || base->temp.get() != framePointer) {
+			return false;
+		}
+		offset = constant->value;
+		return true;
+	}
+
+	// Выражение-результат метода из дерева SEQ(LABEL, MOVE(TEMP rv, e)); 0 для дерева без результата (main)
+	static IExp* returnedValue(INode* tree) {
+		SEQ* seq = dynamic_cast<SEQ*>(tree);
+		MOVE* move = (seq != 0) ? dynamic_cast<MOVE*>(seq->right) : 0;
+		TEMP* rv = (move != 0) ? dynamic_cast<TEMP*>(move->dst) : 0;
+		if (rv == 0 || rv->temp != CFrame::ReturnValue() || dynamic_cast<LABEL*>(seq->left) == 0) {
+			return 0;
+		}
+		return move->src;
+	}
+
+	// Указатель кадра используется только в ячейках кадра: их можно заменить переменными
+	static bool usesFrameOnlyInSlots(INode* node, const CTemp* framePointer) {
+		int offset;
+		IExp* exp = dynamic_cast<IExp*>(node);
+		if (exp != 0 && isFrameSlot(exp, framePointer, offset)) {
+			return true;
+		}
+		TEMP* temp = dynamic_cast<TEMP*>(node);
+		if (temp != 0 && temp->temp.get() == framePointer) {
+			return false;
+		}
+		vector<INode*> kids = children(node);
+		for (int i = 0; i < kids.size(); i++) {
+			if (!usesFrameOnlyInSlots(kids[i], framePointer)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Выигрыш от удаления вызова в узлах: запись аргументов в стек, переход, пролог и эпилог
+	static int callBenefit(int argsCount) {
+		return argsCount + 3;
+	}
+
+	static IStm* seq(const vector<IStm*>& stms) {
+		IStm* result = stms[0];
+		for (int i = 1; i < stms.size(); i++) {
+			result = new SEQ(result, stms[i]);
+		}
+		return result;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CExpansion
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Копия тела вызываемого метода: ячейки его кадра заменяются переменными, его переменные и метки - новыми.
+	// Параметр (в ячейке кадра или в переменной) заменяется значением аргумента, this - выражением self.
+	class CExpansion {
+	public:
+		CExpansion(CFrame* frame, const function<IExp*()>& _self, const vector<TTemp>& _formals) :
+			framePointer(frame->getFP().get()), self(_self), formals(_formals), usesThis(false)
+		{
+			for (int k = 0; k < frame->formalsCount(); k++) {
+				IExp* access = frame->getFormal(k)->getExp();
+				int offset;
+				if (isFrameSlot(access, framePointer, offset)) {
+					formalSlots[offset] = k;
+				} else {
+					formalTemps[static_cast<TEMP*>(access)->temp.get()] = k;
+				}
+			}
+		}
+
+		IExp* Copy(IExp* exp) {
+			int offset;
+			if (isFrameSlot(exp, framePointer, offset)) {
+				map<int, int>::const_iterator formal = formalSlots.find(offset);
+				return (formal != formalSlots.end()) ? argument(formal->second) : slot(offset);
+			}
+			if (TEMP* temp = dynamic_cast<TEMP*>(exp)) {
+				assert(temp->temp.get() != framePointer);
+				map<const CTemp*, int>::const_iterator formal = formalTemps.find(temp->temp.get());
+				if (formal != formalTemps.end()) {
+					return argument(formal->second);
+				}
+				TTemp& copy = temps[temp->temp.get()];
+				if (copy == nullptr) {
+					copy = make_shared<const CTemp>();
+				}
+				return new TEMP(copy);
+			}
+			if (ESEQ* eseq = dynamic_cast<ESEQ*>(exp)) {
+				return new ESEQ(Copy(eseq->stm), Copy(eseq->exp));
+			}
+			return exp->build(copy(exp->kids()));
+		}
+
+		IStm* Copy(IStm* stm) {
+			if (SEQ* s = dynamic_cast<SEQ*>(stm)) {
+				return new SEQ(Copy(s->left), Copy(s->right));
+			}
+			if (MOVE* move = dynamic_cast<MOVE*>(stm)) {
+				return new MOVE(Copy(move->dst), Copy(move->src));
+			}
+			if (LABEL* l = dynamic_cast<LABEL*>(stm)) {
+				return new LABEL(label(l->label));
+			}
+			if (JUMP* jump = dynamic_cast<JUMP*>(stm)) {
+				return (jump->exp != 0) ? new JUMP(Copy(jump->exp), label(jump->target)) : new JUMP(label(jump->target));
+			}
+			if (CJUMP* cjump = dynamic_cast<CJUMP*>(stm)) {
+				return new CJUMP(cjump->relop, Copy(cjump->left), Copy(cjump->right), label(cjump->iftrue), label(cjump->iffalse));
+			}
+			return stm->build(copy(stm->kids()));
+		}
+
+		// Тело обращается к this: к его полям или передаёт его дальше
+		bool UsesThis() const {
+			return usesThis;
+		}
+
+	private:
+		const CTemp* framePointer;
+		function<IExp*()> self;
+		vector<TTemp> formals;
+		// Номера параметров по ячейкам кадра и по переменным
+		map<int, int> formalSlots;
+		map<const CTemp*, int> formalTemps;
+		map<int, TTemp> locals;
+		map<const CTemp*, TTemp> temps;
+		map<const CLabel*, const CLabel*> labels;
+		bool usesThis;
+
+		shared_ptr<ExpList> copy(shared_ptr<ExpList> kids) {
+			return (kids != 0) ? make_shared<ExpList>(Copy(kids->head), copy(kids->tail)) : nullptr;
+		}
+
+		IExp* argument(int k) {
+			if (k == 0) {
+				usesThis = true;
+				return self();
+			}
+			assert(k - 1 < formals.size());
+			return new TEMP(formals[k - 1]);
+		}
+
+		IExp* slot(int offset) {
+			TTemp& local = locals[offset];
+			if (local == nullptr) {
+				local = make_shared<const CTemp>();
+			}
+			return new TEMP(local);
+		}
+
+		const CLabel* label(const CLabel* original) {
+			const CLabel*& copy = labels[original];
+			if (copy == 0) {
+				copy = new CLabel();
+			}
+			return copy;
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CInliner
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CInliner {
+	public:
+		CInliner(ostream& _out, const vector<INode*>& _trees, const vector<CFragment>& _fragments, CInlineStatistics& _stats) :
+			out(_out), trees(_trees), fragments(_fragments), stats(_stats), caller(0), budget(0) {
+			for (int i = 0; i < trees.size(); i++) {
+				methods[fragments[i].label.get()] = i;
+				IExp* body = returnedValue(trees[i]);
+				inlinable.push_back(body != 0 && usesFrameOnlyInSlots(body, fragments[i].frame->getFP().get()));
+			}
+		}
+
+		INode* Run(int method) {
+			caller = method;
+			budget = INLINE_BUDGET;
+			return process(static_cast<IStm*>(trees[method]), 0);
+		}
+
+	private:
+		ostream& out;
+		const vector<INode*>& trees;
+		const vector<CFragment>& fragments;
+		CInlineStatistics& stats;
+		// Деревья методов по метке
+		map<const CLabel*, int> methods;
+		vector<bool> inlinable;
+
+		int caller;
+		// Остаток бюджета вызывающего метода
+		int budget;
+		// Методы, тела которых встраиваются сейчас
+		vector<int> chain;
+
+		IExp* process(IExp* exp, int depth) {
+			if (ESEQ* eseq = dynamic_cast<ESEQ*>(exp)) {
+				return new ESEQ(process(eseq->stm, depth), process(eseq->exp, depth));
+			}
+			IExp* result = exp->build(process(exp->kids(), depth));
+			CALL* call = dynamic_cast<CALL*>(result);
+			return (call != 0) ? inlineCall(call, depth) : result;
+		}
+
+		IStm* process(IStm* stm, int depth) {
+			if (SEQ* s = dynamic_cast<SEQ*>(stm)) {
+				return new SEQ(process(s->left, depth), process(s->right, depth));
+			}
+			return stm->build(process(stm->kids(), depth));
+		}
+
+		shared_ptr<ExpList> process(shared_ptr<ExpList> kids, int depth) {
+			if (kids == 0) {
+				return nullptr;
+			}
+			// Аргументы вычисляются слева направо
+			IExp* head = process(kids->head, depth);
+			return make_shared<ExpList>(head, process(kids->tail, depth));
+		}
+
+		bool isCallerThis(IExp* exp) const {
+			const CTemp* framePointer = fragments[caller].frame->getFP().get();
+			IExp* self = fragments[caller].frame->getTP()->getExp();
+			int offset, selfOffset;
+			if (isFrameSlot(self, framePointer, selfOffset)) {
+				return isFrameSlot(exp, framePointer, offset) && offset == selfOffset;
+			}
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			return temp != 0 && temp->temp == static_cast<TEMP*>(self)->temp;
+		}
+
+		void report(const string& callee, int depth, const string& result) {
+			out << fragments[caller].label->Name() << ": " << callee << ", depth " << depth << " - " << result << endl;
+		}
+
+		IExp* inlineCall(CALL* call, int depth) {
+			NAME* name = dynamic_cast<NAME*>(call->func);
+			if (name == 0) {
+				stats.calls++;
+				report("<virtual>", depth, "virtual call");
+				return call;
+			}
+			map<const CLabel*, int>::const_iterator method = methods.find(name->label.get());
+			if (method == methods.end()) {
+				// Функция времени выполнения
+				return call;
+			}
+			stats.calls++;
+			int callee = method->second;
+			const string& calleeName = name->label->Name();
+			if (!inlinable[callee]) {
+				report(calleeName, depth, "frame is used directly");
+				return call;
+			}
+			if (callee == caller || find(chain.begin(), chain.end(), callee) != chain.end()) {
+				report(calleeName, depth, "recursive");
+				return call;
+			}
+			if (depth >= maxDepth) {
+				report(calleeName, depth, "depth limit");
+				return call;
+			}
+
+			// this, вычисленный в вызывающем методе, подставляется как есть, остальные значения - через переменные
+			vector<IStm*> bindings;
+			function<IExp*()> self;
+			IExp* receiver = call->args->head;
+			bool foreign = !isCallerThis(receiver);
+			if (foreign) {
+				TTemp object = make_shared<const CTemp>();
+				bindings.push_back(new MOVE(new TEMP(object), receiver));
+				self = [object]() { return new TEMP(object); };
+			} else {
+				shared_ptr<CFrame> frame = fragments[caller].frame;
+				self = [frame]() { return frame->getTP()->getExp(); };
+			}
+			vector<TTemp> formals;
+			int argsCount = 1;
+			for (ExpList* arg = call->args->tail.get(); arg != 0; arg = arg->tail.get(), argsCount++) {
+				formals.push_back(make_shared<const CTemp>());
+				bindings.push_back(new MOVE(new TEMP(formals.back()), arg->head));
+			}
+
+			CExpansion expansion(fragments[callee].frame.get(), self, formals);
+			IExp* body = expansion.Copy(returnedValue(trees[callee]));
+			int growth = countNodes(body) - countNodes(call);
+			for (int i = 0; i < bindings.size(); i++) {
+				growth += countNodes(bindings[i]) + 1;
+			}
+			int cost = growth - callBenefit(argsCount);
+			if (cost > budget) {
+				report(calleeName, depth, "cost " + to_string(cost) + " exceeds budget " + to_string(budget));
+				return call;
+			}
+			budget -= max(cost, 0);
+			if (foreign && expansion.UsesThis()) {
+				// Функция узнаётся по указателю кадра или по переменной this, если this не в кадре
+				CAliasAnalysis::AddInlinedFields(fragments[caller].frame->getFP());
+				if (TEMP* self = dynamic_cast<TEMP*>(fragments[caller].frame->getTP()->getExp())) {
+					CAliasAnalysis::AddInlinedFields(self->temp);
+				}
+			}
+			stats.inlinedCalls++;
+			report(calleeName, depth, "inlined, cost " + to_string(cost));
+
+			chain.push_back(callee);
+			body = process(body, depth + 1);
+			chain.pop_back();
+			return bindings.empty() ? body : new ESEQ(seq(bindings), body);
+		}
+	};
+
+	void Inline(ostream& out, vector<INode*>& trees, const vector<CFragment>& fragments, CInlineStatistics& stats) {
+		assert(trees.size() == fragments.size());
+		CInliner inliner(out, trees, fragments, stats);
+		vector<INode*> result;
+		for (int i = 0; i < trees.size(); i++) {
+			stats.nodesBefore += countNodes(trees[i]);
+			result.push_back(inliner.Run(i));
+			stats.nodesAfter += countNodes(result.back());
+		}
+		trees = result;
+	}
+}
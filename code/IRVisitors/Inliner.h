@@ -0,0 +1,30 @@
+#ifndef COMPILERS_INLINER_H
+#define COMPILERS_INLINER_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+#include "../Structs/Frame.h"
+
+namespace Canon {
+	using namespace IRTree;
+
+	struct CInlineStatistics {
+		CInlineStatistics() : calls(0), inlinedCalls(0), nodesBefore(0), nodesAfter(0) {}
+
+		// Вызовы методов программы (без _malloc и _print)
+		int calls;
+		int inlinedCalls;
+		// Узлы деревьев всех методов
+		int nodesBefore;
+		int nodesAfter;
+	};
+
+	// Встраивание методов в деревья до канонизации. Вызов CALL(NAME f, this, args) заменяется копией
+	// тела f: this, параметры и локальные переменные кадра f становятся новыми переменными, метки - новыми
+	// метками. Встраиваются прямые вызовы (см. CTable::getSingleImplementation), если рост дерева за вычетом выигрыша
+	// от удаления вызова укладывается в остаток бюджета вызывающего метода (INLINE_BUDGET узлов).
+	// Вызовы внутри встроенного тела встраиваются до глубины maxDepth, рекурсия не раскрывается.
+	// Отчёт о каждом вызове выводится в out.
+	void Inline(ostream& out, vector<INode*>& trees, const vector<Frame::CFragment>& fragments, CInlineStatistics& stats);
+}
+
+#endif //COMPILERS_INLINER_H
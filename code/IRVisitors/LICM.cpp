@@ -0,0 +1,252 @@
+#include "LICM.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/Aliasing.h"
+
+namespace SSA {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	static int countOperations(IExp* exp) {
+		int count = IRTree::IsLeaf(exp) ? 0 : 1;
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			count += countOperations(l->head);
+		}
+		return count;
+	}
+
+	static int countOperations(IStm* stm) {
+		int count = 0;
+		shared_ptr<ExpList> kids = stm->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			count += countOperations(l->head);
+		}
+		return count;
+	}
+
+	static int countLoads(IExp* exp) {
+		int count = (dynamic_cast<MEM*>(exp) != 0) ? 1 : 0;
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			count += countLoads(l->head);
+		}
+		return count;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CLoopMotion
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CLoopMotion {
+	public:
+		CLoopMotion(CControlFlowGraph& _graph, CLoopStatistics& _stats) : graph(_graph), stats(_stats), aliases(_graph) {}
+
+		void Run() {
+			graph.ComputeDominators();
+			vector<CLoop> loops = graph.FindLoops();
+			if (loops.empty()) {
+				return;
+			}
+			for (int i = 0; i < loops.size(); i++) {
+				int size = graph.Size();
+				graph.InsertPreheader(loops[i]);
+				stats.createdPreheaders += graph.Size() - size;
+			}
+			// Новые предзаголовки входят в объемлющие циклы
+			graph.ComputeDominators();
+			loops = graph.FindLoops();
+			stats.loops += loops.size();
+
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int p = 0; p < block.phis.size(); p++) {
+					definitions[block.phis[p].dst.get()] = b;
+				}
+				for (int i = 0; i < block.stms.size(); i++) {
+					TTemp def = IRTree::DefinedTemp(block.stms[i]);
+					if (def != nullptr) {
+						definitions[def.get()] = b;
+					}
+				}
+			}
+
+			stats.loopOperationsBefore += weightedOperations(loops);
+			for (int i = 0; i < loops.size(); i++) {
+				if (loops[i].preheader != -1) {
+					hoist(loops[i]);
+				}
+			}
+			stats.loopOperationsAfter += weightedOperations(loops);
+		}
+
+	private:
+		// Что цикл может изменить в памяти
+		struct CEffects {
+			bool hasCall;
+			set<string> stores;
+			// Блок выполняется на каждой итерации: доминирует над всеми выходами из цикла
+			bool everyIteration;
+		};
+
+		CControlFlowGraph& graph;
+		CLoopStatistics& stats;
+		CAliasAnalysis aliases;
+		// Блок, в котором определена переменная
+		map<const CTemp*, int> definitions;
+
+		int weightedOperations(const vector<CLoop>& loops) const {
+			int count = 0;
+			for (int i = 0; i < loops.size(); i++) {
+				for (int j = 0; j < loops[i].blocks.size(); j++) {
+					const CBlock& block = graph.blocks[loops[i].blocks[j]];
+					for (int s = 0; s < block.stms.size(); s++) {
+						count += countOperations(block.stms[s]);
+					}
+					count += countOperations(block.jump);
+				}
+			}
+			return count;
+		}
+
+		bool isInvariant(const CLoop& loop, TTemp temp) const {
+			map<const CTemp*, int>::const_iterator it = definitions.find(temp.get());
+			return it == definitions.end() || !loop.contains[it->second];
+		}
+
+		bool canHoist(const CLoop& loop, const CEffects& effects, IExp* exp) const {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				return isInvariant(loop, temp->temp);
+			}
+			if (dynamic_cast<CONST*>(exp) != 0 || dynamic_cast<NAME*>(exp) != 0) {
+				return true;
+			}
+			MEM* mem = dynamic_cast<MEM*>(exp);
+			if (mem != 0) {
+				if (effects.hasCall || (!effects.everyIteration && !aliases.IsSafe(mem->exp))) {
+					return false;
+				}
+				string memoryClass = aliases.Classify(mem->exp);
+				bool unchanged = (memoryClass == "?") ? effects.stores.empty()
+								 : effects.stores.count(memoryClass) == 0 && effects.stores.count("?") == 0;
+				return unchanged && canHoist(loop, effects, mem->exp);
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			if (binop != 0) {
+				if (binop->binop == DIV_OP && !effects.everyIteration) {
+					return false;
+				}
+				return canHoist(loop, effects, binop->left) && canHoist(loop, effects, binop->right);
+			}
+			CMP* cmp = dynamic_cast<CMP*>(exp);
+			if (cmp != 0) {
+				return canHoist(loop, effects, cmp->left) && canHoist(loop, effects, cmp->right);
+			}
+			return false;
+		}
+
+		TTemp define(const CLoop& loop, IExp* exp) {
+			TTemp temp = make_shared<const CTemp>();
+			graph.blocks[loop.preheader].stms.push_back(new MOVE(new TEMP(temp), exp));
+			definitions[temp.get()] = loop.preheader;
+			aliases.Define(temp, exp);
+			stats.hoistedLoads += countLoads(exp);
+			return temp;
+		}
+
+		// Наибольшие инвариантные подвыражения заменяются переменными из предзаголовка
+		IExp* hoistExp(const CLoop& loop, const CEffects& effects, IExp* exp) {
+			if (IRTree::IsLeaf(exp)) {
+				return exp;
+			}
+			if (!IRTree::IsOffsetAddress(exp) && canHoist(loop, effects, exp)) {
+				stats.hoistedExpressions++;
+				return new TEMP(define(loop, exp));
+			}
+			shared_ptr<ExpList> kids = exp->kids();
+			if (kids == nullptr) {
+				return exp;
+			}
+			vector<IExp*> hoisted;
+			bool changed = false;
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				hoisted.push_back(hoistExp(loop, effects, l->head));
+				changed = changed || hoisted.back() != l->head;
+			}
+			return changed ? exp->build(IRTree::MakeExpList(hoisted)) : exp;
+		}
+
+		IStm* hoistStm(const CLoop& loop, const CEffects& effects, IStm* stm) {
+			shared_ptr<ExpList> kids = stm->kids();
+			if (kids == nullptr) {
+				return stm;
+			}
+			vector<IExp*> hoisted;
+			bool changed = false;
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				hoisted.push_back(hoistExp(loop, effects, l->head));
+				changed = changed || hoisted.back() != l->head;
+			}
+			return changed ? stm->build(IRTree::MakeExpList(hoisted)) : stm;
+		}
+
+		void hoist(const CLoop& loop) {
+			CEffects effects;
+			effects.hasCall = false;
+			vector<int> exits;
+			for (int i = 0; i < loop.blocks.size(); i++) {
+				const CBlock& block = graph.blocks[loop.blocks[i]];
+				for (int s = 0; s < block.stms.size(); s++) {
+					MOVE* move = dynamic_cast<MOVE*>(block.stms[s]);
+					EXP* exp = dynamic_cast<EXP*>(block.stms[s]);
+					if (move != 0 && dynamic_cast<MEM*>(move->dst) != 0) {
+						effects.stores.insert(aliases.Classify(static_cast<MEM*>(move->dst)->exp));
+					}
+					bool call = (move != 0 && dynamic_cast<CALL*>(move->src) != 0) || (exp != 0 && dynamic_cast<CALL*>(exp->exp) != 0);
+					effects.hasCall = effects.hasCall || call;
+				}
+				for (int s = 0; s < block.succs.size(); s++) {
+					if (!loop.contains[block.succs[s]]) {
+						exits.push_back(loop.blocks[i]);
+						break;
+					}
+				}
+			}
+
+			// Определения должны выноситься раньше использований
+			vector<int> order = graph.ReversePostorder();
+			for (int i = 0; i < order.size(); i++) {
+				int b = order[i];
+				if (!loop.contains[b]) {
+					continue;
+				}
+				effects.everyIteration = true;
+				for (int e = 0; e < exits.size(); e++) {
+					effects.everyIteration = effects.everyIteration && graph.Dominates(b, exits[e]);
+				}
+
+				CBlock& block = graph.blocks[b];
+				vector<IStm*> stms;
+				for (int s = 0; s < block.stms.size(); s++) {
+					TTemp def = IRTree::DefinedTemp(block.stms[s]);
+					IExp* src = (def != nullptr) ? static_cast<MOVE*>(block.stms[s])->src : 0;
+					// Константы и копии не выносятся: это не сократит вычислений, только удлинит время жизни
+					if (src != 0 && !IRTree::IsLeaf(src) && canHoist(loop, effects, src)) {
+						graph.blocks[loop.preheader].stms.push_back(block.stms[s]);
+						definitions[def.get()] = loop.preheader;
+						stats.hoistedStatements++;
+						stats.hoistedLoads += countLoads(src);
+						continue;
+					}
+					stms.push_back(hoistStm(loop, effects, block.stms[s]));
+				}
+				block.stms.swap(stms);
+				block.jump = hoistStm(loop, effects, block.jump);
+			}
+		}
+	};
+
+	void HoistInvariants(CControlFlowGraph& graph, CLoopStatistics& stats) {
+		CLoopMotion motion(graph, stats);
+		motion.Run();
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef COMPILERS_LICM_H
+#define COMPILERS_LICM_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace SSA {
+	using namespace Canon;
+
+	struct CLoopStatistics {
+		CLoopStatistics() : loops(0), createdPreheaders(0), hoistedStatements(0), hoistedExpressions(0), hoistedLoads(0),
+			loopOperationsBefore(0), loopOperationsAfter(0) {}
+
+		int loops;
+		int createdPreheaders;
+		// Определения MOVE(TEMP, e), перенесённые целиком
+		int hoistedStatements;
+		// Подвыражения, вынесенные во временные переменные
+		int hoistedExpressions;
+		int hoistedLoads;
+		// Операции (узлы BINOP, MEM, CALL) в телах циклов с весом - глубиной вложенности:
+		// оценка числа операций, выполняемых за итерацию
+		int loopOperationsBefore;
+		int loopOperationsAfter;
+	};
+
+	// Вынос инвариантов циклов в предзаголовки, начиная с внутренних циклов.
+	// Выносятся вычисления, все операнды которых определены вне цикла, и чтения памяти, в класс ячеек
+	// которых цикл не пишет и в котором нет вызовов. Чтение или деление, которое могло бы упасть,
+	// выносится, только если оно выполняется на каждой итерации до любого выхода из цикла.
+	void HoistInvariants(CControlFlowGraph& graph, CLoopStatistics& stats);
+}
+
+#endif //COMPILERS_LICM_H
@@ -3,6 +3,15 @@
 #include "../Structs/TraceShedule.h"
 #include "../IRVisitors/Canonizer.h"
 #include "../IRVisitors/Printer.h"
+#include "../IRVisitors/SSA.h"
+#include "../IRVisitors/SCCP.h"
+#include "../IRVisitors/GVN.h"
+#include "../IRVisitors/LICM.h"
+#include "../IRVisitors/StrengthReduction.h"
+#include "../IRVisitors/DeadStores.h"
+#include "../Structs/ControlFlowGraph.h"
+#include <chrono>
+#include <stdexcept>
 
 namespace Canon {
 	void Canonize(vector<INode*>& trees, vector<IStm*>& canonized_trees){
@@ -38,6 +47,92 @@ namespace Canon {
 		}
 	}
 
+	void Optimize(ostream& out, vector<shared_ptr<StmtList>>& stmts, const COptions& options) {
+		typedef std::chrono::steady_clock clock;
+		for ( int i = 0; i < stmts.size(); ++i ) {
+			out << "=================================" << endl;
+			out << i << " tree" << endl;
+			out << "=================================" << endl;
+			CControlFlowGraph graph(stmts[i]);
+			out << "blocks: " << graph.Size() << ", statements: " << graph.StatementsCount() << endl;
+
+			// Каждый проход над SSA-формой замеряется и проверяется верификатором
+			auto run = [&](const string& name, function<void()> pass) {
+				clock::time_point start = clock::now();
+				pass();
+				double passTime = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+				out << name << " time, us: " << passTime << endl;
+				if (!SSA::Verify(graph, out)) {
+					throw new logic_error("SSA verification failed after " + name + ", see Logs/Optimizer.log");
+				}
+			};
+
+			if (options.ssa) {
+				SSA::CStatistics stats;
+				run("ssa", [&]() { SSA::Build(graph, stats); });
+				out << "ssa: promoted frame slots " << stats.promotedSlots << ", removed blocks " << stats.removedBlocks << ", phis " << stats.phis
+					<< ", versions " << stats.versions << endl;
+
+				if (options.sccp) {
+					SSA::CConstantStatistics constants;
+					run("sccp", [&]() { SSA::PropagateConstants(graph, constants); });
+					out << "sccp: replaced uses " << constants.replacedUses << ", folded expressions "
+						<< constants.foldedExpressions << ", folded jumps " << constants.foldedJumps
+						<< ", removed blocks " << constants.removedBlocks << ", removed statements "
+						<< constants.removedStatements << endl;
+				}
+
+				if (options.gvn) {
+					SSA::CValueNumberingStatistics values;
+					run("gvn", [&]() { SSA::NumberValues(graph, values); });
+					out << "gvn: loads " << values.loadsBefore << " -> " << values.loadsAfter << ", eliminated loads "
+						<< values.eliminatedLoads << ", eliminated expressions " << values.eliminatedExpressions
+						<< ", propagated copies " << values.propagatedCopies << ", materialized " << values.materialized << endl;
+				}
+
+				if (options.licm) {
+					SSA::CLoopStatistics loops;
+					run("licm", [&]() { SSA::HoistInvariants(graph, loops); });
+					out << "licm: loops " << loops.loops << ", created preheaders " << loops.createdPreheaders
+						<< ", hoisted statements " << loops.hoistedStatements << ", hoisted expressions "
+						<< loops.hoistedExpressions << ", hoisted loads " << loops.hoistedLoads
+						<< ", loop operations " << loops.loopOperationsBefore << " -> " << loops.loopOperationsAfter << endl;
+				}
+
+				if (options.ivsr) {
+					SSA::CInductionStatistics inductions;
+					run("ivsr", [&]() { SSA::ReduceStrength(graph, inductions); });
+					out << "ivsr: induction variables " << inductions.inductionVariables << ", reduced expressions "
+						<< inductions.reducedExpressions << ", recurrences " << inductions.recurrences << ", replaced tests "
+						<< inductions.replacedTests << ", removed variables " << inductions.removedVariables
+						<< ", loop multiplications " << inductions.loopMultiplicationsBefore << " -> "
+						<< inductions.loopMultiplicationsAfter << endl;
+				}
+
+				clock::time_point start = clock::now();
+				SSA::Destruct(graph, stats);
+				double destructTime = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+				out << "out of ssa time, us: " << destructTime << endl;
+				out << "out of ssa: coalesced phis " << stats.coalescedPhis << ", copies " << stats.copies
+					<< ", split edges " << stats.splitEdges << endl;
+			}
+
+			// После выхода из SSA: живость считается по переменным с несколькими определениями
+			if (options.dce) {
+				CDeadStoreStatistics deadStores;
+				clock::time_point start = clock::now();
+				RemoveDeadStores(graph, deadStores);
+				double dceTime = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+				out << "dce time, us: " << dceTime << endl;
+				out << "dce: removed stores " << deadStores.removedStores << ", removed definitions "
+					<< deadStores.removedDefinitions << ", iterations " << deadStores.iterations << endl;
+			}
+
+			out << "blocks: " << graph.Size() << ", statements: " << graph.StatementsCount() << endl;
+			stmts[i] = graph.ToStmtList();
+		}
+	}
+
 	void Trace(vector<shared_ptr<StmtList>>& linearized, vector<shared_ptr<StmtList>>& result) {
 		result.clear();
 		for ( int i = 0; i < linearized.size(); ++i ) {
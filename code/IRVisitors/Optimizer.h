@@ -3,11 +3,14 @@
 
 #include "../common.h"
 #include "../Structs/IRTree.h"
+#include "../Structs/Options.h"
 using namespace IRTree;
 
 namespace Canon {
 	void Canonize(vector<INode*>& trees, vector<IStm*>& canonized_trees);
 	void Linearize(vector<IStm*>& trees, vector<shared_ptr<StmtList>>& result);
+	// Оптимизации между линеаризацией и трассировкой, включаемые параметрами командной строки
+	void Optimize(ostream& out, vector<shared_ptr<StmtList>>& stmts, const COptions& options);
 	void Trace(vector<shared_ptr<StmtList>>& stmts, vector<shared_ptr<StmtList>>& result);
 	void Print(ostream& out, ostream& gv, vector<INode*>& trees);
 	void Print(ostream& out, ostream& gv, vector<IStm*>& trees);
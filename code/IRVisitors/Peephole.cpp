@@ -0,0 +1,270 @@
+#include "Peephole.h"
+#include "../Structs/FlowGraph.h"
+#include "../Structs/Dataflow.h"
+#include "../Structs/Frame.h"
+#include "../Structs/IRUtils.h"
+
+namespace CodeGenerator {
+	//--------------------------------------------------------------------------------------------------------------
+	// Instruction shapes
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Команда в окне и её номер в потоке на начало прохода; у команд, созданных правилами, номер -1
+	struct CSlot {
+		CSlot(const CInstr& _instr, int _node = -1) : instr(_instr), node(_node) {}
+
+		CInstr instr;
+		int node;
+	};
+
+	// Пересылка регистр-регистр: mov d, s
+	static bool matchMove(const CInstr& instr, int& dst, int& src) {
+		if (!instr.move && (instr.opcode != OP_Mov || instr.MemoryOperand() != -1 || instr.defs.Size() != 1
+			|| instr.uses.Size() != 1)) {
+			return false;
+		}
+		dst = instr.defs[0];
+		src = instr.uses[0];
+		return true;
+	}
+
+	// Непосредственный операнд в конце команды: op x, c
+	static bool immediate(const CInstr& instr, int& value) {
+		if (instr.operandCount != 2 || instr.operands[1].kind != CInstrOperand::K_Imm) {
+			return false;
+		}
+		value = instr.operands[1].value;
+		return true;
+	}
+
+	// Загрузка константы: mov d, c
+	static bool matchConstant(const CInstr& instr, int& dst, int& value) {
+		if (instr.opcode != OP_Mov || instr.defs.Size() != 1 || !instr.uses.Empty() || !immediate(instr, value)) {
+			return false;
+		}
+		dst = instr.defs[0];
+		return true;
+	}
+
+	// Безусловный переход: jmp L
+	static const CLabel* jumpTarget(const CInstr& instr) {
+		return (instr.opcode == OP_Jmp && instr.labelCount == 1) ? instr.labels[0] : 0;
+	}
+
+	// Та же команда с другим результатом (и тем же первым аргументом для двухадресных команд)
+	static CInstr retarget(const CInstr& instr, int dst, bool twoAddress) {
+		CInstr copy = instr;
+		if (twoAddress) {
+			copy.uses.Set(0, dst);
+		}
+		copy.defs.Set(0, dst);
+		return copy;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CPeepholeContext
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Живость переменных на момент начала прохода. Для команд, созданных правилами в этом проходе,
+	// она неизвестна, и переменные считаются живыми.
+	class CPeepholeContext {
+	public:
+		CPeepholeContext(CInstrStream& _stream) : stream(_stream) {
+			graph.Build(stream);
+			liveness = make_shared<Dataflow::CLiveness>(graph);
+		}
+
+		bool DeadAfter(const CSlot& slot, int temp) const {
+			if (slot.node == -1 || Frame::CFrame::IsRegister(stream.Temp(temp).get())) {
+				return false;
+			}
+			return !liveness->LiveOut(slot.node).Test(temp);
+		}
+
+	private:
+		CInstrStream& stream;
+		FlowGraph::CFlowGraph graph;
+		shared_ptr<Dataflow::CLiveness> liveness;
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Rules
+	//--------------------------------------------------------------------------------------------------------------
+
+	typedef function<bool(const vector<CSlot>& window, const CPeepholeContext& context,
+		vector<CSlot>& replacement)> TPeepholeRewrite;
+
+	struct CPeepholeRule {
+		string name;
+		// Число соседних команд, на которые смотрит правило
+		int window;
+		TPeepholeRewrite rewrite;
+	};
+
+	// mov a, a =>
+	static bool removeSelfMove(const vector<CSlot>& w, const CPeepholeContext& context, vector<CSlot>& replacement) {
+		int dst, src;
+		return matchMove(w[0].instr, dst, src) && dst == src;
+	}
+
+	// jmp L; L: => L:
+	static bool removeJumpToNext(const vector<CSlot>& w, const CPeepholeContext& context, vector<CSlot>& replacement) {
+		if (!w[1].instr.IsLabel() || jumpTarget(w[0].instr) != w[1].instr.labels[0]) {
+			return false;
+		}
+		replacement.push_back(w[1]);
+		return true;
+	}
+
+	// mov t, x; mov r, t => mov r, x, если t дальше не нужна
+	static bool forwardCopy(const vector<CSlot>& w, const CPeepholeContext& context, vector<CSlot>& replacement) {
+		int dst, src;
+		if (!matchMove(w[1].instr, dst, src)) {
+			return false;
+		}
+		const CInstr& def = w[0].instr;
+		if (def.opcode != OP_Mov || def.defs.Size() != 1 || def.defs[0] != src || def.uses.Contains(src)
+			|| !context.DeadAfter(w[1], src)) {
+			return false;
+		}
+		replacement.push_back(CSlot(retarget(def, dst, false)));
+		return true;
+	}
+
+	// mov r, x; op r, y; mov d, r => mov d, x; op d, y, если r дальше не нужна (шаблон двухадресной операции)
+	static bool retargetOperation(const vector<CSlot>& w, const CPeepholeContext& context, vector<CSlot>& replacement) {
+		int temp, x, dst, result;
+		if (!matchMove(w[0].instr, temp, x) || !matchMove(w[2].instr, dst, result) || result != temp) {
+			return false;
+		}
+		const CInstr& op = w[1].instr;
+		if (op.IsLabel() || op.IsJump() || op.move || op.opcode == OP_None || op.defs.Size() != 1
+			|| op.defs[0] != temp || op.uses.Empty() || op.uses[0] != temp || op.MemoryOperand() != -1) {
+			return false;
+		}
+		for (int k = 1; k < op.uses.Size(); k++) {
+			if (op.uses[k] == temp || op.uses[k] == dst) {
+				return false;
+			}
+		}
+		if (!context.DeadAfter(w[2], temp)) {
+			return false;
+		}
+		replacement.push_back(CSlot(retarget(w[0].instr, dst, false)));
+		replacement.push_back(CSlot(retarget(op, dst, true)));
+		return true;
+	}
+
+	// mov a, c1; cmp a, c2 (или test a, a); jcc T, F => mov a, c1; jmp T или F
+	static bool foldConstantCompare(const vector<CSlot>& w, const CPeepholeContext& context, vector<CSlot>& replacement) {
+		int a;
+		int left, right = 0;
+		const CInstr& compare = w[1].instr;
+		bool test = compare.opcode == OP_Test;
+		if (!matchConstant(w[0].instr, a, left) || (compare.opcode != OP_Cmp && !test) || compare.uses.Empty()
+			|| compare.uses[0] != a || compare.MemoryOperand() != -1) {
+			return false;
+		}
+		if (test ? compare.uses[1] != a : compare.uses.Size() != 1 || !immediate(compare, right)) {
+			return false;
+		}
+		const CInstr& jump = w[2].instr;
+		if (jump.opcode != OP_Jcc || jump.labelCount != 2) {
+			return false;
+		}
+		// TCondition и CJUMP_OP перечислены в одном порядке
+		bool taken = IRTree::EvaluateRelop(static_cast<IRTree::CJUMP_OP>(jump.condition), left, right);
+		replacement.push_back(w[0]);
+		replacement.push_back(CSlot(CInstrStream::Jump(jump.labels[taken ? 0 : 1])));
+		return true;
+	}
+
+	// Все правила; каждое заменяет окно более короткой последовательностью, поэтому применение конечно
+	static const vector<CPeepholeRule>& rules() {
+		static const vector<CPeepholeRule> table = {
+			{ "self move", 1, removeSelfMove },
+			{ "jump to next label", 2, removeJumpToNext },
+			{ "copy forwarding", 2, forwardCopy },
+			{ "operation retargeting", 3, retargetOperation },
+			{ "constant compare", 3, foldConstantCompare },
+		};
+		return table;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Driver
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Один проход окном по методу, возвращает число применённых правил
+	static int applyRules(CInstrStream& stream, map<string, int>& fired) {
+		CPeepholeContext context(stream);
+		vector<CSlot> code;
+		code.reserve(stream.Size());
+		for (int i = 0; i < stream.Size(); i++) {
+			code.push_back(CSlot(stream[i], i));
+		}
+		int applied = 0;
+		for (int i = 0; i < code.size();) {
+			bool rewritten = false;
+			for (int r = 0; r < rules().size() && !rewritten; r++) {
+				const CPeepholeRule& rule = rules()[r];
+				if (i + rule.window > code.size()) {
+					continue;
+				}
+				vector<CSlot> window(code.begin() + i, code.begin() + i + rule.window);
+				vector<CSlot> replacement;
+				if (rule.rewrite(window, context, replacement)) {
+					code.erase(code.begin() + i, code.begin() + i + rule.window);
+					code.insert(code.begin() + i, replacement.begin(), replacement.end());
+					fired[rule.name]++;
+					applied++;
+					rewritten = true;
+				}
+			}
+			if (!rewritten) {
+				i++;
+			}
+		}
+
+		if (applied != 0) {
+			stream.code.clear();
+			for (int i = 0; i < code.size(); i++) {
+				stream.code.push_back(code[i].instr);
+			}
+		}
+		return applied;
+	}
+
+	void Peephole(ostream& out, vector<CInstrStream>& blockInstructions, CPeepholeStatistics& stats) {
+		CDefaultMap defMap;
+		for (int i = 0; i < blockInstructions.size(); i++) {
+			CInstrStream& stream = blockInstructions[i];
+			int before = stream.Size();
+			map<string, int> fired;
+			int iterations = 0;
+			while (applyRules(stream, fired) != 0) {
+				iterations++;
+			}
+			stats.iterations += iterations;
+			int after = stream.Size();
+			stats.removedInstructions += before - after;
+
+			const CLabel* entry = stream.Entry();
+			out << "===========================" << endl;
+			out << ((entry != 0) ? entry->Name() : to_string(i)) << ": " << before << " -> " << after
+				<< " instructions, iterations " << iterations << endl;
+			for (map<string, int>::iterator it = fired.begin(); it != fired.end(); it++) {
+				out << "  " << it->first << ": " << it->second << endl;
+				stats.fired[it->first] += it->second;
+			}
+			for (int k = 0; k < stream.Size(); k++) {
+				out << stream.Format(stream[k], &defMap);
+			}
+		}
+		out << "peephole: removed " << stats.removedInstructions << " instructions";
+		for (map<string, int>::iterator it = stats.fired.begin(); it != stats.fired.end(); it++) {
+			out << ", " << it->first << " " << it->second;
+		}
+		out << endl;
+	}
+}
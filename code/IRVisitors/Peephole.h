@@ -0,0 +1,25 @@
+#ifndef COMPILERS_PEEPHOLE_H
+#define COMPILERS_PEEPHOLE_H
+#include "../common.h"
+#include "../Structs/Assembler.h"
+
+namespace CodeGenerator {
+	using namespace Assembler;
+
+	// Срабатывания правил по именам
+	struct CPeepholeStatistics {
+		CPeepholeStatistics() : iterations(0), removedInstructions(0) {}
+
+		map<string, int> fired;
+		int iterations;
+		int removedInstructions;
+	};
+
+	// Оптимизация окном над командами каждого метода. Правила собраны в одной таблице (см. Peephole.cpp):
+	// окно из нескольких соседних команд заменяется более короткой последовательностью. Правила применяются
+	// до неподвижной точки; живость переменных пересчитывается перед каждым проходом.
+	// Срабатывания правил по методам и итоговый код выводятся в out.
+	void Peephole(ostream& out, vector<CInstrStream>& blockInstructions, CPeepholeStatistics& stats);
+}
+
+#endif //COMPILERS_PEEPHOLE_H
@@ -109,6 +109,32 @@ void CIRPrinter::Visit(BINOP* node) {
 	--counter;
 }
 
+void CIRPrinter::Visit(CMP* node) {
+	print_tabs(counter++);
+	int newCount = count++;
+	out << "CMP " << CJumpOpStrings[node->relop] << endl;
+	gv << "\"" << newCount << "CMP\"->";
+	node->left->accept(this);
+	gv << "\"" << newCount << "CMP\"->";
+	node->right->accept(this);
+	--counter;
+}
+
+void CIRPrinter::Visit(SELECT* node) {
+	print_tabs(counter++);
+	int newCount = count++;
+	out << "SELECT " << CJumpOpStrings[node->relop] << endl;
+	gv << "\"" << newCount << "SELECT\"->";
+	node->left->accept(this);
+	gv << "\"" << newCount << "SELECT\"->";
+	node->right->accept(this);
+	gv << "\"" << newCount << "SELECT\"->";
+	node->iftrue->accept(this);
+	gv << "\"" << newCount << "SELECT\"->";
+	node->iffalse->accept(this);
+	--counter;
+}
+
 void CIRPrinter::Visit(MEM* node) {
 	print_tabs(counter++);
 	int newCount = count++;
@@ -121,12 +147,13 @@ void CIRPrinter::Visit(MEM* node) {
 void CIRPrinter::Visit(CALL* node) {
 	print_tabs(counter++);
 	int newCount = count++;
-	out << "CALL" << endl;
-	gv << "\"" << newCount << "CALL\"->";
+	const char* name = node->tail ? "CALL tail" : "CALL";
+	out << name << endl;
+	gv << "\"" << newCount << name << "\"->";
 	node->func->accept(this);
 	shared_ptr<ExpList> cur = node->args;
 	while(cur) {
-		gv << "\"" << newCount << "CALL\"->";
+		gv << "\"" << newCount << name << "\"->";
 		cur->head->accept(this);
 		cur = cur->tail;
 	}
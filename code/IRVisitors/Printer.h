@@ -18,6 +18,8 @@ public:
 	void Visit(NAME* node);
 	void Visit(TEMP* node);
 	void Visit(BINOP* node);
+	void Visit(CMP* node);
+	void Visit(SELECT* node);
 	void Visit(MEM* node);
 	void Visit(CALL* node);
 	void Visit(ESEQ* node);
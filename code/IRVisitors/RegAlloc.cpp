@@ -1,9 +1,10 @@
 #include "RegAlloc.h"
+#include "../Structs/Frame.h"
+#include <chrono>
 
 template <>
 ostream& operator<< <Assembler::CInstr*> (ostream& s, CGraphNode<Assembler::CInstr*> const & rhs){
-	s<<rhs.index<<" ";
-	(*rhs.value).Print(s);
+	s<<rhs.index<<" "<<(rhs.value->IsLabel() ? "ALABEL" : (rhs.value->move ? "AMOVE" : "AOPER"));
 	return s;
 }
 
@@ -14,23 +15,213 @@ ostream& operator<< <const Temp::CTemp*> (ostream& s, CGraphNode<const Temp::CTe
 }
 
 namespace RegAlloc {
-	void BuildFlowGraph( ostream &out, vector<shared_ptr<CInstrList>>& blockInstructions,
+	void BuildFlowGraph( ostream &out, vector<CInstrStream>& blockInstructions,
 						 vector<shared_ptr<CFlowGraph>>& graphs )
 	{
 		for (int i = 0; i < blockInstructions.size(); i++) {
 			graphs.push_back(make_shared<CFlowGraph>());
-			graphs.back()->Build(blockInstructions[i].get());
+			graphs.back()->Build(blockInstructions[i]);
 			out<<(*(graphs.back().get()));
 		}
 	}
 
+	// Команда нужна независимо от живости её результатов
+	static bool hasSideEffects( const CInstrStream& stream, const CInstr& instr )
+	{
+		if (instr.IsLabel() || instr.IsJump() || instr.defs.Empty() || instr.opcode == OP_Call) {
+			return true;
+		}
+		for (int temp : instr.defs) {
+			if (Frame::CFrame::IsRegister(stream.Temp(temp).get())) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Один проход по живости, возвращает число удалённых команд
+	static int removeDead( CInstrStream& stream )
+	{
+		vector<bool> dead(stream.Size(), false);
+		{
+			CFlowGraph graph;
+			graph.Build(stream);
+			Dataflow::CLiveness liveness(graph);
+			for (int i = 0; i < stream.Size(); i++) {
+				dead[i] = !hasSideEffects(stream, stream[i]);
+				for (int k = 0; k < stream[i].defs.Size() && dead[i]; k++) {
+					dead[i] = !liveness.LiveOut(i).Test(stream[i].defs[k]);
+				}
+			}
+		}
+		int kept = 0;
+		for (int i = 0; i < stream.Size(); i++) {
+			if (!dead[i]) {
+				stream[kept++] = stream[i];
+			}
+		}
+		int removed = stream.Size() - kept;
+		stream.code.resize(kept);
+		return removed;
+	}
+
+	void RemoveDeadInstructions( ostream &out, vector<CInstrStream>& blockInstructions )
+	{
+		CDefaultMap defMap;
+		int total = 0;
+		for (int i = 0; i < blockInstructions.size(); i++) {
+			CInstrStream& stream = blockInstructions[i];
+			int before = stream.Size();
+			int removed = 0;
+			int iterations = 0;
+			int count;
+			do {
+				count = removeDead(stream);
+				removed += count;
+				iterations++;
+			} while (count != 0);
+			total += removed;
+
+			const CLabel* entry = stream.Entry();
+			out << "===========================" << endl;
+			out << ((entry != 0) ? entry->Name() : to_string(i)) << ": removed " << removed << " of "
+				<< before << " instructions, iterations " << iterations << endl;
+			for (int k = 0; k < stream.Size(); k++) {
+				out << stream.Format(stream[k], &defMap);
+			}
+		}
+		out << "dead instructions: removed " << total << endl;
+	}
+
 	void BuildInterferenceGraph( ostream &out, vector<shared_ptr<CFlowGraph>>& flowGraphs,
 						 vector<shared_ptr<CInterferenceGraph>>& interferenceGraphs )
 	{
+		int registers = Frame::CFrame::AllocatableRegisters();
+		int spills = 0;
 		for (int i = 0; i < flowGraphs.size(); i++) {
 			interferenceGraphs.push_back(make_shared<CInterferenceGraph>());
 			interferenceGraphs.back()->Build(*flowGraphs[i]);
 			out<<(*(interferenceGraphs.back().get()));
+			int methodSpills = interferenceGraphs.back()->PotentialSpills(registers);
+			out << "potential spills: " << methodSpills << endl << endl;
+			spills += methodSpills;
+		}
+		out << Frame::CFrame::Target().name << ": " << registers << " registers, potential spills " << spills << endl;
+	}
+
+	static set<const CTemp*> tempSet( const CFlowGraph& flowGraph, const CTempIds& ids )
+	{
+		set<const CTemp*> temps;
+		for (int temp : ids) {
+			temps.insert(flowGraph.Stream().Temp(temp).get());
+		}
+		return temps;
+	}
+
+	// Живость на set<const CTemp*> (как прежде в CInterferenceGraph::Build), эталон для замеров битового решателя:
+	// in = use U (out - def), out - объединение in преемников, до неподвижной точки
+	static void setBasedLiveness( CFlowGraph& flowGraph, map< int, set<const CTemp*> >& in,
+								  map< int, set<const CTemp*> >& out )
+	{
+		bool cycled = false;
+		list<CGraphNode<CInstr*>*> ordered;
+		flowGraph.DFS(cycled, ordered);
+		bool changed;
+		do {
+			changed = false;
+			for (auto it = ordered.rbegin(); it != ordered.rend(); it++){
+				int index = (*it)->index;
+
+				set<const CTemp*> newOut;
+				set<int> succ = flowGraph.getNodesIndexFromNode(index);
+				for (auto i = succ.begin(); i != succ.end(); i++){
+					newOut.insert(in[*i].begin(), in[*i].end());
+				}
+
+				set<const CTemp*> use = tempSet(flowGraph, flowGraph.GetUse(index));
+				set<const CTemp*> def = tempSet(flowGraph, flowGraph.GetDef(index));
+				set<const CTemp*> diff;
+				set<const CTemp*> newIn;
+				set_difference(newOut.begin(), newOut.end(),
+							   def.begin(), def.end(),
+							   inserter(diff, diff.begin()));
+				set_union(use.begin(), use.end(),
+						  diff.begin(), diff.end(),
+						  inserter(newIn, newIn.begin()));
+
+				if (newIn != in[index] || newOut != out[index]) {
+					changed = true;
+					in[index].swap(newIn);
+					out[index].swap(newOut);
+				}
+			}
+		} while (changed);
+	}
+
+	static bool sameTemps( const CFlowGraph& flowGraph, const set<const CTemp*>& temps, const Dataflow::CBitSet& bits )
+	{
+		int count = 0;
+		bool same = true;
+		bits.ForEach([&](int temp) {
+			count++;
+			same = same && temps.count(flowGraph.Stream().Temp(temp).get()) != 0;
+		});
+		return same && count == temps.size();
+	}
+
+	// Среднее время вычисления живости на set<const CTemp*> и битовым решателем; результаты сверяются
+	static void benchmarkLiveness( ostream &out, CFlowGraph& graph, const Dataflow::CLiveness& liveness )
+	{
+		typedef std::chrono::steady_clock clock;
+		const int runs = 20;
+		map< int, set<const CTemp*> > in, live;
+		clock::time_point start = clock::now();
+		for (int r = 0; r < runs; r++) {
+			in.clear();
+			live.clear();
+			setBasedLiveness(graph, in, live);
+		}
+		double setTime = std::chrono::duration<double, std::micro>(clock::now() - start).count() / runs;
+
+		start = clock::now();
+		for (int r = 0; r < runs; r++) {
+			Dataflow::CLiveness bits(graph);
+		}
+		double bitTime = std::chrono::duration<double, std::micro>(clock::now() - start).count() / runs;
+
+		for (int n = 0; n < graph.Size(); n++) {
+			if (!sameTemps(graph, in[n], liveness.LiveIn(n)) || !sameTemps(graph, live[n], liveness.LiveOut(n))) {
+				throw new logic_error("liveness mismatch at instruction " + to_string(n) + ", see Logs/Dataflow.log");
+			}
+		}
+		out << "liveness time, us: set<const CTemp*> " << setTime << ", bit-set " << bitTime << endl;
+	}
+
+	void AnalyzeDataflow( ostream &out, vector<shared_ptr<CFlowGraph>>& flowGraphs, bool benchmark )
+	{
+		out << "bit-set kernels: " << Dataflow::CBitSet::KernelName() << endl;
+		for (int i = 0; i < flowGraphs.size(); i++) {
+			CFlowGraph& graph = *flowGraphs[i];
+			out << "===========================" << endl;
+
+			Dataflow::CLiveness liveness(graph);
+			Dataflow::CReachingDefinitions reaching(graph);
+			Dataflow::CAvailableExpressions available(graph);
+
+			int instructions = graph.getAllNodesCopy().size();
+			int maxLive = 0;
+			for (int n = 0; n < instructions; n++) {
+				maxLive = max(maxLive, liveness.LiveIn(n).Count());
+			}
+			out << "instructions: " << instructions << ", temps: " << graph.Stream().TempsCount() << endl;
+			out << "liveness: max live " << maxLive << ", visits " << liveness.Visits() << endl;
+			out << "reaching definitions: " << reaching.DefinitionsCount() << " definitions, visits "
+				<< reaching.Visits() << endl;
+			out << "available expressions: " << available.ExpressionsCount() << " expressions, visits "
+				<< available.Visits() << endl;
+			if (benchmark) {
+				benchmarkLiveness(out, graph, liveness);
+			}
 		}
 	}
 }
@@ -5,10 +5,16 @@
 namespace RegAlloc {
 	using namespace Assembler;
 	using namespace FlowGraph;
-	void BuildFlowGraph( ostream &out, vector<shared_ptr<CInstrList>>& blockInstructions,
+	void BuildFlowGraph( ostream &out, vector<CInstrStream>& blockInstructions,
 						 vector<shared_ptr<CFlowGraph>>& graphs );
+	// Удаление команд, определяющих только мёртвые переменные, до неподвижной точки.
+	// Вызовы, записи в память, переходы и записи в машинные регистры сохраняются.
+	void RemoveDeadInstructions( ostream &out, vector<CInstrStream>& blockInstructions );
 	void BuildInterferenceGraph( ostream &out, vector<shared_ptr<CFlowGraph>>& flowGraphs,
 								 vector<shared_ptr<CInterferenceGraph>>& interferenceGraphs );
+	// Живые переменные, достигающие определения и доступные выражения для каждой функции.
+	// С benchmark - сравнение времени битового решателя с вычислением живости на set<const CTemp*>
+	void AnalyzeDataflow( ostream &out, vector<shared_ptr<CFlowGraph>>& flowGraphs, bool benchmark );
 }
 
 #endif //COMPILERS_REGALLOC_H
@@ -0,0 +1,315 @@
+#include "SCCP.h"
+#include "../Structs/IRUtils.h"
+
+namespace SSA {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Значение переменной: ещё не вычислено, константа или неизвестно
+	struct CValue {
+		enum TKind { V_Top, V_Const, V_Bottom };
+
+		CValue(TKind _kind = V_Top, int _value = 0) : kind(_kind), value(_value) {}
+		bool operator==(const CValue& other) const {
+			return kind == other.kind && (kind != V_Const || value == other.value);
+		}
+		bool operator!=(const CValue& other) const { return !(*this == other); }
+
+		TKind kind;
+		int value;
+	};
+
+	static CValue meet(const CValue& a, const CValue& b) {
+		if (a.kind == CValue::V_Top) {
+			return b;
+		}
+		if (b.kind == CValue::V_Top) {
+			return a;
+		}
+		return (a == b) ? a : CValue(CValue::V_Bottom);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CPropagator
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CPropagator {
+	public:
+		CPropagator(CControlFlowGraph& _graph) : graph(_graph), executable(_graph.Size(), false) {}
+
+		void Run() {
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int p = 0; p < block.phis.size(); p++) {
+					values[block.phis[p].dst.get()] = CValue();
+					for (int a = 0; a < block.phis[p].args.size(); a++) {
+						users[block.phis[p].args[a].get()].push_back(b);
+					}
+				}
+				vector<TTemp> uses;
+				for (int i = 0; i <= block.stms.size(); i++) {
+					IStm* stm = (i < block.stms.size()) ? block.stms[i] : block.jump;
+					IRTree::CollectUses(stm, uses);
+					TTemp def = IRTree::DefinedTemp(stm);
+					if (def != nullptr) {
+						values[def.get()] = CValue();
+					}
+				}
+				for (int u = 0; u < uses.size(); u++) {
+					users[uses[u].get()].push_back(b);
+				}
+			}
+
+			executable[0] = true;
+			worklist.insert(0);
+			while (!worklist.empty()) {
+				int b = *worklist.begin();
+				worklist.erase(worklist.begin());
+				visit(b);
+			}
+		}
+
+		CValue Value(const CTemp* temp) const {
+			map<const CTemp*, CValue>::const_iterator it = values.find(temp);
+			// Переменные без определений (указатель кадра, параметры) неизвестны
+			return (it != values.end()) ? it->second : CValue(CValue::V_Bottom);
+		}
+
+		CValue Evaluate(IExp* exp) const {
+			CONST* constant = dynamic_cast<CONST*>(exp);
+			if (constant != 0) {
+				return CValue(CValue::V_Const, constant->value);
+			}
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				return Value(temp->temp.get());
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			if (binop != 0) {
+				CValue left = Evaluate(binop->left);
+				CValue right = Evaluate(binop->right);
+				if (left.kind == CValue::V_Bottom || right.kind == CValue::V_Bottom) {
+					return CValue(CValue::V_Bottom);
+				}
+				if (left.kind == CValue::V_Top || right.kind == CValue::V_Top) {
+					return CValue();
+				}
+				int result;
+				if (IRTree::FoldBinop(binop->binop, left.value, right.value, result)) {
+					return CValue(CValue::V_Const, result);
+				}
+			}
+			CMP* cmp = dynamic_cast<CMP*>(exp);
+			if (cmp != 0) {
+				CValue left = Evaluate(cmp->left);
+				CValue right = Evaluate(cmp->right);
+				if (left.kind == CValue::V_Bottom || right.kind == CValue::V_Bottom) {
+					return CValue(CValue::V_Bottom);
+				}
+				if (left.kind == CValue::V_Top || right.kind == CValue::V_Top) {
+					return CValue();
+				}
+				return CValue(CValue::V_Const, IRTree::EvaluateRelop(cmp->relop, left.value, right.value) ? 1 : 0);
+			}
+			return CValue(CValue::V_Bottom);
+		}
+
+		bool IsExecutable(int b) const { return executable[b]; }
+		bool IsExecutable(int from, int to) const { return executableEdges.count(make_pair(from, to)) != 0; }
+
+	private:
+		CControlFlowGraph& graph;
+		map<const CTemp*, CValue> values;
+		map<const CTemp*, vector<int>> users;
+		vector<bool> executable;
+		set<pair<int, int>> executableEdges;
+		set<int> worklist;
+
+		void markEdge(int from, int to) {
+			if (executableEdges.insert(make_pair(from, to)).second) {
+				executable[to] = true;
+				worklist.insert(to);
+			}
+		}
+
+		void update(const CTemp* temp, const CValue& value) {
+			CValue& old = values[temp];
+			CValue lowered = meet(old, value);
+			if (lowered != old) {
+				old = lowered;
+				const vector<int>& blocks = users[temp];
+				for (int i = 0; i < blocks.size(); i++) {
+					if (executable[blocks[i]]) {
+						worklist.insert(blocks[i]);
+					}
+				}
+			}
+		}
+
+		void visit(int b) {
+			CBlock& block = graph.blocks[b];
+			for (int p = 0; p < block.phis.size(); p++) {
+				CValue value;
+				for (int j = 0; j < block.preds.size(); j++) {
+					if (IsExecutable(block.preds[j], b)) {
+						value = meet(value, Value(block.phis[p].args[j].get()));
+					}
+				}
+				update(block.phis[p].dst.get(), value);
+			}
+			for (int i = 0; i < block.stms.size(); i++) {
+				TTemp def = IRTree::DefinedTemp(block.stms[i]);
+				if (def != nullptr) {
+					update(def.get(), Evaluate(static_cast<MOVE*>(block.stms[i])->src));
+				}
+			}
+
+			CJUMP* cjump = dynamic_cast<CJUMP*>(block.jump);
+			if (cjump == 0) {
+				for (int s = 0; s < block.succs.size(); s++) {
+					markEdge(b, block.succs[s]);
+				}
+				return;
+			}
+			CValue left = Evaluate(cjump->left);
+			CValue right = Evaluate(cjump->right);
+			if (left.kind == CValue::V_Const && right.kind == CValue::V_Const) {
+				bool taken = IRTree::EvaluateRelop(cjump->relop, left.value, right.value);
+				int target = graph.BlockByLabel(taken ? cjump->iftrue : cjump->iffalse);
+				if (target >= 0) {
+					markEdge(b, target);
+				}
+			} else if (left.kind == CValue::V_Bottom || right.kind == CValue::V_Bottom) {
+				for (int s = 0; s < block.succs.size(); s++) {
+					markEdge(b, block.succs[s]);
+				}
+			}
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Rewriting
+	//--------------------------------------------------------------------------------------------------------------
+
+	void PropagateConstants(CControlFlowGraph& graph, CConstantStatistics& stats) {
+		CPropagator propagator(graph);
+		propagator.Run();
+
+		IRTree::TExpRewriter rewriter = [&propagator, &stats](IExp* exp) -> IExp* {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				CValue value = propagator.Value(temp->temp.get());
+				if (value.kind == CValue::V_Const) {
+					stats.replacedUses++;
+					return new CONST(value.value);
+				}
+				return exp;
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			CONST* left = (binop != 0) ? dynamic_cast<CONST*>(binop->left) : 0;
+			CONST* right = (binop != 0) ? dynamic_cast<CONST*>(binop->right) : 0;
+			int result;
+			if (left != 0 && right != 0 && IRTree::FoldBinop(binop->binop, left->value, right->value, result)) {
+				stats.foldedExpressions++;
+				return new CONST(result);
+			}
+			CMP* cmp = dynamic_cast<CMP*>(exp);
+			if (cmp != 0 && dynamic_cast<CONST*>(cmp->left) != 0 && dynamic_cast<CONST*>(cmp->right) != 0) {
+				stats.foldedExpressions++;
+				bool holds = IRTree::EvaluateRelop(cmp->relop, static_cast<CONST*>(cmp->left)->value,
+					static_cast<CONST*>(cmp->right)->value);
+				return new CONST(holds ? 1 : 0);
+			}
+			return exp;
+		};
+
+		for (int b = 0; b < graph.Size(); b++) {
+			if (!propagator.IsExecutable(b)) {
+				continue;
+			}
+			CBlock& block = graph.blocks[b];
+			for (int i = 0; i < block.stms.size(); i++) {
+				TTemp def = IRTree::DefinedTemp(block.stms[i]);
+				CValue value = (def != nullptr) ? propagator.Value(def.get()) : CValue(CValue::V_Bottom);
+				MOVE* move = static_cast<MOVE*>(block.stms[i]);
+				if (value.kind == CValue::V_Const && dynamic_cast<CONST*>(move->src) == 0) {
+					block.stms[i] = new MOVE(move->dst, new CONST(value.value));
+					stats.foldedExpressions++;
+				} else {
+					block.stms[i] = IRTree::RewriteStm(block.stms[i], rewriter);
+				}
+			}
+
+			// Переход с известным исходом становится безусловным
+			CJUMP* cjump = dynamic_cast<CJUMP*>(block.jump);
+			if (cjump != 0) {
+				CValue left = propagator.Evaluate(cjump->left);
+				CValue right = propagator.Evaluate(cjump->right);
+				if (left.kind == CValue::V_Const && right.kind == CValue::V_Const) {
+					const CLabel* taken = IRTree::EvaluateRelop(cjump->relop, left.value, right.value) ?
+										  cjump->iftrue : cjump->iffalse;
+					block.jump = new JUMP(taken);
+					vector<int> succs = block.succs;
+					for (int s = 0; s < succs.size(); s++) {
+						if (graph.blocks[succs[s]].label != taken) {
+							graph.RemoveEdge(b, succs[s]);
+						}
+					}
+					stats.foldedJumps++;
+					continue;
+				}
+			}
+			block.jump = IRTree::RewriteStm(block.jump, rewriter);
+		}
+
+		stats.removedBlocks += graph.RemoveUnreachable();
+		stats.removedStatements += RemoveDeadDefinitions(graph);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Dead definitions
+	//--------------------------------------------------------------------------------------------------------------
+
+	int RemoveDeadDefinitions(CControlFlowGraph& graph) {
+		int removed = 0;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			map<const CTemp*, int> uses;
+			vector<TTemp> temps;
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int p = 0; p < block.phis.size(); p++) {
+					for (int a = 0; a < block.phis[p].args.size(); a++) {
+						uses[block.phis[p].args[a].get()]++;
+					}
+				}
+				for (int i = 0; i <= block.stms.size(); i++) {
+					IRTree::CollectUses((i < block.stms.size()) ? block.stms[i] : block.jump, temps);
+				}
+			}
+			for (int t = 0; t < temps.size(); t++) {
+				uses[temps[t].get()]++;
+			}
+
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int p = block.phis.size() - 1; p >= 0; p--) {
+					if (uses[block.phis[p].dst.get()] == 0) {
+						block.phis.erase(block.phis.begin() + p);
+						removed++;
+						changed = true;
+					}
+				}
+				for (int i = block.stms.size() - 1; i >= 0; i--) {
+					TTemp def = IRTree::DefinedTemp(block.stms[i]);
+					if (def != nullptr && uses[def.get()] == 0 && IRTree::IsPure(static_cast<MOVE*>(block.stms[i])->src)) {
+						block.stms.erase(block.stms.begin() + i);
+						removed++;
+						changed = true;
+					}
+				}
+			}
+		}
+		return removed;
+	}
+}
@@ -0,0 +1,30 @@
+#ifndef COMPILERS_SCCP_H
+#define COMPILERS_SCCP_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace SSA {
+	using namespace Canon;
+
+	struct CConstantStatistics {
+		CConstantStatistics() : replacedUses(0), foldedExpressions(0), foldedJumps(0), removedBlocks(0),
+			removedStatements(0) {}
+
+		int replacedUses;
+		int foldedExpressions;
+		int foldedJumps;
+		int removedBlocks;
+		int removedStatements;
+	};
+
+	// Разреженное условное распространение констант (Wegman, Zadeck) над SSA-формой:
+	// использования заменяются константами, условные переходы с известным исходом - безусловными,
+	// недостижимые блоки и ставшие ненужными определения констант удаляются
+	void PropagateConstants(CControlFlowGraph& graph, CConstantStatistics& stats);
+
+	// Удаляет phi и MOVE(TEMP, e) без побочных эффектов, результат которых не используется.
+	// Возвращает число удалённых операторов.
+	int RemoveDeadDefinitions(CControlFlowGraph& graph);
+}
+
+#endif //COMPILERS_SCCP_H
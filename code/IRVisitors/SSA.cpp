@@ -0,0 +1,565 @@
+#include "SSA.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/Dataflow.h"
+#include "../Structs/FrameSlots.h"
+#include "../Structs/Frame.h"
+
+namespace SSA {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Frame slots
+	//--------------------------------------------------------------------------------------------------------------
+
+	int PromoteFrameSlots(CControlFlowGraph& graph) {
+		CFrameSlots frameSlots(graph);
+		if (frameSlots.Empty()) {
+			return 0;
+		}
+
+		map<pair<const CTemp*, int>, TTemp> slots;
+		set<pair<const CTemp*, int>> readSlots;
+		auto slotTemp = [&](IExp* exp, bool read) -> TTemp {
+			pair<const CTemp*, int> key = frameSlots.Match(exp);
+			if (key.first == nullptr) {
+				return nullptr;
+			}
+			if (slots.count(key) == 0) {
+				slots[key] = make_shared<const CTemp>();
+			}
+			if (read) {
+				readSlots.insert(key);
+			}
+			return slots[key];
+		};
+		IRTree::TExpRewriter rewriter = [&](IExp* exp) -> IExp* {
+			TTemp temp = slotTemp(exp, true);
+			return (temp != nullptr) ? new TEMP(temp) : exp;
+		};
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			vector<IStm*> stms;
+			for (int i = 0; i < block.stms.size(); i++) {
+				if (frameSlots.IsAddress(block.stms[i])) {
+					continue;
+				}
+				MOVE* move = dynamic_cast<MOVE*>(block.stms[i]);
+				TTemp dst = (move != 0) ? slotTemp(move->dst, false) : nullptr;
+				if (dst != nullptr) {
+					stms.push_back(new MOVE(new TEMP(dst), IRTree::RewriteExp(move->src, rewriter)));
+				} else {
+					stms.push_back(IRTree::RewriteStm(block.stms[i], rewriter));
+				}
+			}
+			block.stms.swap(stms);
+			block.jump = IRTree::RewriteStm(block.jump, rewriter);
+		}
+
+		// Параметры (отрицательные смещения) приходят в кадре от вызывающей функции
+		vector<IStm*> loads;
+		for (set<pair<const CTemp*, int>>::iterator it = readSlots.begin(); it != readSlots.end(); it++) {
+			if (it->second < 0) {
+				IExp* address = new BINOP(PLUS_OP, new TEMP(frameSlots.Temp(it->first)), new CONST(it->second));
+				loads.push_back(new MOVE(new TEMP(slots[*it]), new MEM(address)));
+			}
+		}
+		vector<IStm*>& entry = graph.blocks[0].stms;
+		entry.insert(entry.begin(), loads.begin(), loads.end());
+		return slots.size();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Construction
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CRenamer {
+	public:
+		CRenamer(CControlFlowGraph& _graph, const map<const CTemp*, TTemp>& _variables, CStatistics& _stats) :
+			graph(_graph), variables(_variables), stats(_stats) {}
+
+		void Rename(int b) {
+			CBlock& block = graph.blocks[b];
+			vector<const CTemp*> pushed;
+			for (int p = 0; p < block.phis.size(); p++) {
+				block.phis[p].dst = newVersion(block.phis[p].variable, pushed);
+			}
+			IRTree::TExpRewriter rewriter = [this](IExp* exp) { return renameUse(exp); };
+			for (int i = 0; i < block.stms.size(); i++) {
+				IStm* stm = IRTree::RewriteStm(block.stms[i], rewriter);
+				TTemp def = IRTree::DefinedTemp(stm);
+				if (def != nullptr && variables.count(def.get()) != 0) {
+					stm = IRTree::ReplaceDefinedTemp(stm, newVersion(def, pushed));
+				}
+				block.stms[i] = stm;
+			}
+			block.jump = IRTree::RewriteStm(block.jump, rewriter);
+
+			for (int s = 0; s < block.succs.size(); s++) {
+				CBlock& succ = graph.blocks[block.succs[s]];
+				int j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+				for (int p = 0; p < succ.phis.size(); p++) {
+					succ.phis[p].args[j] = current(succ.phis[p].variable);
+				}
+			}
+			for (int c = 0; c < graph.domChildren[b].size(); c++) {
+				Rename(graph.domChildren[b][c]);
+			}
+			for (int i = 0; i < pushed.size(); i++) {
+				stacks[pushed[i]].pop_back();
+			}
+		}
+
+	private:
+		CControlFlowGraph& graph;
+		const map<const CTemp*, TTemp>& variables;
+		CStatistics& stats;
+		map<const CTemp*, vector<TTemp>> stacks;
+		map<const CTemp*, int> counters;
+
+		TTemp newVersion(TTemp variable, vector<const CTemp*>& pushed) {
+			TTemp version = make_shared<const CTemp>(variable->Name() + "_" + to_string(++counters[variable.get()]));
+			stacks[variable.get()].push_back(version);
+			pushed.push_back(variable.get());
+			stats.versions++;
+			return version;
+		}
+
+		// Переменная без достигающего определения сохраняет исходное имя
+		TTemp current(TTemp variable) {
+			map<const CTemp*, vector<TTemp>>::iterator it = stacks.find(variable.get());
+			return (it == stacks.end() || it->second.empty()) ? variable : it->second.back();
+		}
+
+		IExp* renameUse(IExp* exp) {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp == 0) {
+				return exp;
+			}
+			TTemp version = current(temp->temp);
+			return (version != temp->temp) ? new TEMP(version) : exp;
+		}
+	};
+
+	void Build(CControlFlowGraph& graph, CStatistics& stats) {
+		stats.removedBlocks += graph.RemoveUnreachable();
+		stats.promotedSlots += PromoteFrameSlots(graph);
+		graph.ComputeDominators();
+
+		// Определяемые переменные, блоки их определений и переменные, живые на входе хотя бы одного блока
+		map<const CTemp*, TTemp> variables;
+		map<const CTemp*, set<int>> defSites;
+		set<const CTemp*> globals;
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			set<const CTemp*> defined;
+			vector<TTemp> uses;
+			for (int i = 0; i <= block.stms.size(); i++) {
+				IStm* stm = (i < block.stms.size()) ? block.stms[i] : block.jump;
+				uses.clear();
+				IRTree::CollectUses(stm, uses);
+				for (int u = 0; u < uses.size(); u++) {
+					if (defined.count(uses[u].get()) == 0) {
+						globals.insert(uses[u].get());
+					}
+				}
+				TTemp def = IRTree::DefinedTemp(stm);
+				if (def != nullptr) {
+					defined.insert(def.get());
+					variables[def.get()] = def;
+					defSites[def.get()].insert(b);
+				}
+			}
+		}
+
+		for (map<const CTemp*, set<int>>::iterator it = defSites.begin(); it != defSites.end(); it++) {
+			if (globals.count(it->first) == 0) {
+				continue;
+			}
+			vector<bool> hasPhi(graph.Size(), false);
+			vector<int> worklist(it->second.begin(), it->second.end());
+			while (!worklist.empty()) {
+				int d = worklist.back();
+				worklist.pop_back();
+				for (int f = 0; f < graph.frontier[d].size(); f++) {
+					int y = graph.frontier[d][f];
+					if (hasPhi[y]) {
+						continue;
+					}
+					hasPhi[y] = true;
+					graph.blocks[y].phis.push_back(CPhi(variables[it->first], graph.blocks[y].preds.size()));
+					stats.phis++;
+					if (it->second.count(y) == 0) {
+						worklist.push_back(y);
+					}
+				}
+			}
+		}
+
+		CRenamer renamer(graph, variables, stats);
+		renamer.Rename(0);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Verification
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Переменные, которые получают значение вне промежуточного представления: параметры в регистрах
+	// (их пишет вход метода), указатели кадра и машинные регистры
+	static bool definedOutside(const CTemp* temp) {
+		return Frame::CFrame::FormalIndex(temp) >= 0 || Frame::CFrame::IsFramePointer(temp)
+			|| Frame::CFrame::IsRegister(temp);
+	}
+
+	bool Verify(CControlFlowGraph& graph, ostream& out) {
+		graph.ComputeDominators();
+		bool ok = true;
+		// Место определения: блок и номер оператора (-1 для phi)
+		map<const CTemp*, pair<int, int>> defs;
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			for (int s = 0; s < block.succs.size(); s++) {
+				vector<int>& preds = graph.blocks[block.succs[s]].preds;
+				if (find(preds.begin(), preds.end(), b) == preds.end()) {
+					out << "SSA: edge " << block.label->Name() << " -> "
+						<< graph.blocks[block.succs[s]].label->Name() << " has no back reference" << endl;
+					ok = false;
+				}
+			}
+			vector<pair<TTemp, int>> blockDefs;
+			for (int p = 0; p < block.phis.size(); p++) {
+				blockDefs.push_back(make_pair(block.phis[p].dst, -1));
+				if (block.phis[p].args.size() != block.preds.size()) {
+					out << "SSA: phi for " << block.phis[p].dst->Name() << " in " << block.label->Name()
+						<< " has " << block.phis[p].args.size() << " args for " << block.preds.size() << " preds" << endl;
+					ok = false;
+				}
+			}
+			for (int i = 0; i < block.stms.size(); i++) {
+				TTemp def = IRTree::DefinedTemp(block.stms[i]);
+				if (def != nullptr) {
+					blockDefs.push_back(make_pair(def, i));
+				}
+			}
+			for (int d = 0; d < blockDefs.size(); d++) {
+				const CTemp* temp = blockDefs[d].first.get();
+				if (defs.count(temp) != 0) {
+					out << "SSA: " << temp->Name() << " is defined more than once" << endl;
+					ok = false;
+				}
+				defs[temp] = make_pair(b, blockDefs[d].second);
+			}
+		}
+
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			vector<TTemp> uses;
+			for (int i = 0; i <= block.stms.size(); i++) {
+				uses.clear();
+				IRTree::CollectUses((i < block.stms.size()) ? block.stms[i] : block.jump, uses);
+				for (int u = 0; u < uses.size(); u++) {
+					map<const CTemp*, pair<int, int>>::iterator def = defs.find(uses[u].get());
+					if (def == defs.end()) {
+						// Использование без определения видно на входе метода
+						if (!definedOutside(uses[u].get())) {
+							out << "SSA: use of " << uses[u]->Name() << " in " << block.label->Name()
+								<< " has no definition" << endl;
+							ok = false;
+						}
+						continue;
+					}
+					bool dominated = (def->second.first == b) ? def->second.second < i
+															   : graph.Dominates(def->second.first, b);
+					if (!dominated) {
+						out << "SSA: use of " << uses[u]->Name() << " in " << block.label->Name()
+							<< " is not dominated by its definition" << endl;
+						ok = false;
+					}
+				}
+			}
+			for (int p = 0; p < block.phis.size(); p++) {
+				for (int j = 0; j < block.phis[p].args.size() && j < block.preds.size(); j++) {
+					map<const CTemp*, pair<int, int>>::iterator def = defs.find(block.phis[p].args[j].get());
+					if (def != defs.end() && !graph.Dominates(def->second.first, block.preds[j])) {
+						out << "SSA: phi argument " << block.phis[p].args[j]->Name() << " in " << block.label->Name()
+							<< " is not available at the end of its predecessor" << endl;
+						ok = false;
+					}
+				}
+			}
+		}
+		return ok;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Destruction
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Объединение имён, связанных phi-функциями, в паутины
+	class CWebs {
+	public:
+		CWebs(int size) : parent(size) {
+			for (int i = 0; i < size; i++) {
+				parent[i] = i;
+			}
+		}
+		int Find(int x) {
+			while (parent[x] != x) {
+				parent[x] = parent[parent[x]];
+				x = parent[x];
+			}
+			return x;
+		}
+		void Union(int a, int b) {
+			parent[Find(a)] = Find(b);
+		}
+	private:
+		vector<int> parent;
+	};
+
+	static void addUses(IStm* stm, const Dataflow::CTempNumbering& temps, Dataflow::CBitSet& live) {
+		vector<TTemp> uses;
+		IRTree::CollectUses(stm, uses);
+		for (int u = 0; u < uses.size(); u++) {
+			live.Set(temps.Find(uses[u].get()));
+		}
+	}
+
+	// Аргументы phi-функций преемников, приходящие из блока b: используются в конце b
+	static void addPhiUses(CControlFlowGraph& graph, int b, const Dataflow::CTempNumbering& temps,
+						   Dataflow::CBitSet& live) {
+		for (int s = 0; s < graph.blocks[b].succs.size(); s++) {
+			CBlock& succ = graph.blocks[graph.blocks[b].succs[s]];
+			int j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+			for (int p = 0; p < succ.phis.size(); p++) {
+				live.Set(temps.Find(succ.phis[p].args[j].get()));
+			}
+		}
+	}
+
+	// Паутины, в которых какие-то два имени одновременно живы
+	static vector<bool> findInterference(CControlFlowGraph& graph, const Dataflow::CTempNumbering& temps,
+										 CWebs& webs, const vector<int>& webSize) {
+		Dataflow::CDataflowGraph flow(graph.Size());
+		for (int b = 0; b < graph.Size(); b++) {
+			for (int s = 0; s < graph.blocks[b].succs.size(); s++) {
+				flow.AddEdge(b, graph.blocks[b].succs[s]);
+			}
+		}
+		Dataflow::CDataflowSolver<Dataflow::CUnionLattice, Dataflow::D_Backward> liveness(flow, temps.Size());
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			Dataflow::CBitSet& gen = liveness.gen[b];
+			addPhiUses(graph, b, temps, gen);
+			addUses(block.jump, temps, gen);
+			for (int i = block.stms.size() - 1; i >= 0; i--) {
+				TTemp def = IRTree::DefinedTemp(block.stms[i]);
+				if (def != nullptr) {
+					gen.Reset(temps.Find(def.get()));
+					liveness.kill[b].Set(temps.Find(def.get()));
+				}
+				addUses(block.stms[i], temps, gen);
+			}
+			for (int p = 0; p < block.phis.size(); p++) {
+				gen.Reset(temps.Find(block.phis[p].dst.get()));
+				liveness.kill[b].Set(temps.Find(block.phis[p].dst.get()));
+			}
+		}
+		liveness.Solve();
+
+		vector<bool> interferes(temps.Size(), false);
+		auto define = [&](int d, const Dataflow::CBitSet& live) {
+			int web = webs.Find(d);
+			if (webSize[web] < 2 || interferes[web]) {
+				return;
+			}
+			live.ForEach([&](int l) {
+				if (l != d && webs.Find(l) == web) {
+					interferes[web] = true;
+				}
+			});
+		};
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			Dataflow::CBitSet live = liveness.out[b];
+			addPhiUses(graph, b, temps, live);
+			addUses(block.jump, temps, live);
+			for (int i = block.stms.size() - 1; i >= 0; i--) {
+				TTemp def = IRTree::DefinedTemp(block.stms[i]);
+				if (def != nullptr) {
+					int d = temps.Find(def.get());
+					define(d, live);
+					live.Reset(d);
+				}
+				addUses(block.stms[i], temps, live);
+			}
+			for (int p = 0; p < block.phis.size(); p++) {
+				define(temps.Find(block.phis[p].dst.get()), live);
+			}
+		}
+		return interferes;
+	}
+
+	// Последовательность копий, эквивалентная параллельному присваиванию
+	static void sequentialize(vector<pair<TTemp, TTemp>> copies, vector<IStm*>& result, CStatistics& stats) {
+		for (int i = copies.size() - 1; i >= 0; i--) {
+			if (copies[i].first == copies[i].second) {
+				copies.erase(copies.begin() + i);
+			}
+		}
+		while (!copies.empty()) {
+			int ready = -1;
+			for (int i = 0; i < copies.size() && ready == -1; i++) {
+				bool isSource = false;
+				for (int j = 0; j < copies.size(); j++) {
+					isSource = isSource || (j != i && copies[j].second == copies[i].first);
+				}
+				if (!isSource) {
+					ready = i;
+				}
+			}
+			if (ready == -1) {
+				// Все приёмники ещё нужны как источники - цикл, разрываем его через новую переменную
+				TTemp saved = copies[0].first;
+				TTemp temp = make_shared<const CTemp>();
+				result.push_back(new MOVE(new TEMP(temp), new TEMP(saved)));
+				stats.copies++;
+				for (int j = 0; j < copies.size(); j++) {
+					if (copies[j].second == saved) {
+						copies[j].second = temp;
+					}
+				}
+				ready = 0;
+			}
+			result.push_back(new MOVE(new TEMP(copies[ready].first), new TEMP(copies[ready].second)));
+			stats.copies++;
+			copies.erase(copies.begin() + ready);
+		}
+	}
+
+	void Destruct(CControlFlowGraph& graph, CStatistics& stats) {
+		Dataflow::CTempNumbering temps;
+		vector<TTemp> byIndex;
+		vector<bool> defined;
+		auto number = [&](TTemp temp) {
+			int id = temps.Add(temp.get());
+			if (id == byIndex.size()) {
+				byIndex.push_back(temp);
+				defined.push_back(false);
+			}
+			return id;
+		};
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			for (int p = 0; p < block.phis.size(); p++) {
+				defined[number(block.phis[p].dst)] = true;
+				for (int a = 0; a < block.phis[p].args.size(); a++) {
+					number(block.phis[p].args[a]);
+				}
+			}
+			vector<TTemp> uses;
+			vector<TTemp> defs;
+			for (int i = 0; i <= block.stms.size(); i++) {
+				IStm* stm = (i < block.stms.size()) ? block.stms[i] : block.jump;
+				IRTree::CollectUses(stm, uses);
+				TTemp def = IRTree::DefinedTemp(stm);
+				if (def != nullptr) {
+					uses.push_back(def);
+					defs.push_back(def);
+				}
+			}
+			for (int u = 0; u < uses.size(); u++) {
+				number(uses[u]);
+			}
+			for (int d = 0; d < defs.size(); d++) {
+				defined[temps.Find(defs[d].get())] = true;
+			}
+		}
+
+		CWebs webs(temps.Size());
+		for (int b = 0; b < graph.Size(); b++) {
+			for (int p = 0; p < graph.blocks[b].phis.size(); p++) {
+				CPhi& phi = graph.blocks[b].phis[p];
+				for (int a = 0; a < phi.args.size(); a++) {
+					webs.Union(temps.Find(phi.dst.get()), temps.Find(phi.args[a].get()));
+				}
+			}
+		}
+		vector<int> webSize(temps.Size(), 0);
+		for (int t = 0; t < temps.Size(); t++) {
+			webSize[webs.Find(t)]++;
+		}
+		vector<bool> interferes = findInterference(graph, temps, webs, webSize);
+
+		// Имя без определения в IR (параметр в регистре, машинный регистр, переменная без присваивания)
+		// получает значение снаружи, переименовывать его нельзя - оно становится именем паутины.
+		// Паутина с двумя такими именами остаётся с копиями
+		vector<int> external(temps.Size(), -1);
+		for (int t = 0; t < temps.Size(); t++) {
+			int web = webs.Find(t);
+			if (defined[t] || webSize[web] < 2) {
+				continue;
+			}
+			if (external[web] != -1) {
+				interferes[web] = true;
+			}
+			external[web] = t;
+		}
+
+		// Паутины без пересечений получают одно имя, их phi-функции исчезают
+		map<const CTemp*, TTemp> coalesced;
+		for (int t = 0; t < temps.Size(); t++) {
+			int web = webs.Find(t);
+			int name = (external[web] != -1) ? external[web] : web;
+			if (webSize[web] > 1 && !interferes[web] && name != t) {
+				coalesced[byIndex[t].get()] = byIndex[name];
+			}
+		}
+		IRTree::TExpRewriter rewriter = [&coalesced](IExp* exp) -> IExp* {
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp == 0) {
+				return exp;
+			}
+			map<const CTemp*, TTemp>::iterator it = coalesced.find(temp->temp.get());
+			return (it != coalesced.end()) ? new TEMP(it->second) : exp;
+		};
+		for (int b = 0; b < graph.Size(); b++) {
+			CBlock& block = graph.blocks[b];
+			for (int p = block.phis.size() - 1; p >= 0; p--) {
+				if (!interferes[webs.Find(temps.Find(block.phis[p].dst.get()))]) {
+					block.phis.erase(block.phis.begin() + p);
+					stats.coalescedPhis++;
+				}
+			}
+			for (int i = 0; i < block.stms.size(); i++) {
+				IStm* stm = IRTree::RewriteStm(block.stms[i], rewriter);
+				TTemp def = IRTree::DefinedTemp(stm);
+				if (def != nullptr && coalesced.count(def.get()) != 0) {
+					stm = IRTree::ReplaceDefinedTemp(stm, coalesced[def.get()]);
+				}
+				block.stms[i] = stm;
+			}
+			block.jump = IRTree::RewriteStm(block.jump, rewriter);
+		}
+
+		// Оставшиеся phi-функции заменяются копиями в предшественниках
+		int size = graph.Size();
+		for (int b = 0; b < size; b++) {
+			if (graph.blocks[b].phis.empty()) {
+				continue;
+			}
+			for (int j = 0; j < graph.blocks[b].preds.size(); j++) {
+				int pred = graph.blocks[b].preds[j];
+				if (graph.blocks[pred].succs.size() > 1) {
+					pred = graph.SplitEdge(pred, b);
+					stats.splitEdges++;
+				}
+				vector<pair<TTemp, TTemp>> copies;
+				for (int p = 0; p < graph.blocks[b].phis.size(); p++) {
+					copies.push_back(make_pair(graph.blocks[b].phis[p].dst, graph.blocks[b].phis[p].args[j]));
+				}
+				sequentialize(copies, graph.blocks[pred].stms, stats);
+			}
+			graph.blocks[b].phis.clear();
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef COMPILERS_SSA_H
+#define COMPILERS_SSA_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+// SSA-форма над графом потока управления линеаризованных деревьев
+namespace SSA {
+	using namespace Canon;
+
+	struct CStatistics {
+		CStatistics() : promotedSlots(0), removedBlocks(0), phis(0), versions(0), coalescedPhis(0), copies(0), splitEdges(0) {}
+
+		// Ячейки кадра, перенесённые во временные переменные
+		int promotedSlots;
+		int removedBlocks;
+		int phis;
+		// Новые имена переменных, созданные при переименовании
+		int versions;
+		// phi-функции, снятые слиянием непересекающихся имён без копий
+		int coalescedPhis;
+		int copies;
+		int splitEdges;
+	};
+
+	// Заменяет ячейки кадра MEM(fp + c) временными переменными, если указатель кадра используется
+	// только в таких выражениях (адрес локальной переменной в MiniJava не может утечь).
+	// Параметры загружаются из кадра во входном блоке. Возвращает число перенесённых ячеек.
+	int PromoteFrameSlots(CControlFlowGraph& graph);
+	// Перенос ячеек кадра, размещение phi-функций по границам доминирования (полуусечённая форма)
+	// и переименование
+	void Build(CControlFlowGraph& graph, CStatistics& stats);
+	// Единственность определений, доминирование определений над использованиями, согласованность phi.
+	// Нарушения пишет в out, возвращает true, если их нет.
+	bool Verify(CControlFlowGraph& graph, ostream& out);
+	// Выход из SSA: имена одной phi-паутины без пересечений живости сливаются,
+	// для остальных phi на рёбрах (с расщеплением критических) вставляются последовательные копии
+	void Destruct(CControlFlowGraph& graph, CStatistics& stats);
+}
+
+#endif //COMPILERS_SSA_H
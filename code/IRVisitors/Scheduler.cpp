@@ -0,0 +1,379 @@
+#include "Scheduler.h"
+#include "../Structs/Frame.h"
+
+namespace CodeGenerator {
+	//--------------------------------------------------------------------------------------------------------------
+	// Machine model
+	//--------------------------------------------------------------------------------------------------------------
+
+	struct CLatency {
+		TOpcode opcode;
+		int latency;
+	};
+
+	// Задержки результата в тактах для современного внеочередного ядра x86-64 (порядок величин - по таблицам
+	// Агнера Фога); setcc и cmovcc - по одной строке на все условия, команды, которых нет в таблице, - 1 такт
+	static const CLatency latencies[] = {
+		{ OP_Mov, 1 }, { OP_Lea, 1 }, { OP_Add, 1 }, { OP_Sub, 1 }, { OP_And, 1 }, { OP_Or, 1 }, { OP_Xor, 1 },
+		{ OP_Shl, 1 }, { OP_Shr, 1 }, { OP_Sar, 1 }, { OP_Cmp, 1 }, { OP_Test, 1 }, { OP_Set, 1 }, { OP_Movzx, 1 },
+		{ OP_Cmov, 1 }, { OP_Imul, 3 }, { OP_Cdq, 1 }, { OP_Cqo, 1 }, { OP_Idiv, 26 },
+	};
+	// Чтение из памяти (попадание в L1) добавляется к задержке команды
+	static const int loadLatency = 4;
+	// Запись в память и чтение того же адреса: передача из буфера записи
+	static const int storeForwarding = 4;
+	// Команд, выдаваемых за такт
+	static const int issueWidth = 4;
+
+	static bool intersects(const CTempIds& a, const CTempIds& b) {
+		for (int temp : a) {
+			if (b.Contains(temp)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Что команда делает кроме записи и чтения переменных
+	struct CEffects {
+		CEffects() : barrier(false), loads(false), stores(false), writesFlags(false), readsFlags(false), latency(1) {}
+
+		// Команда не переставляется и делит блок на участки
+		bool barrier;
+		bool loads;
+		bool stores;
+		bool writesFlags;
+		bool readsFlags;
+		int latency;
+	};
+
+	// sp - номер указателя стека в таблице переменных метода или -1
+	static CEffects effectsOf(const CInstr& instr, int sp) {
+		CEffects effects;
+		TOpcode op = instr.opcode;
+		if (op == OP_Label || instr.IsJump() || op == OP_None || op == OP_Call || op == OP_Push || op == OP_Pop
+			|| op == OP_Ret || instr.defs.Contains(sp) || instr.uses.Contains(sp)) {
+			effects.barrier = true;
+			effects.readsFlags = op == OP_Jcc;
+			return effects;
+		}
+		for (int i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+			if (op == latencies[i].opcode) {
+				effects.latency = latencies[i].latency;
+			}
+		}
+		effects.readsFlags = op == OP_Set || op == OP_Cmov;
+		effects.writesFlags = op == OP_Add || op == OP_Sub || op == OP_And || op == OP_Or || op == OP_Xor
+			|| op == OP_Shl || op == OP_Shr || op == OP_Sar || op == OP_Cmp || op == OP_Test || op == OP_Imul
+			|| op == OP_Idiv;
+
+		// Адрес lea не читается; ячейка первым операндом пишется (mov), читается (cmp, test и однооперандные
+		// imul, idiv) или и то и другое
+		int memory = instr.MemoryOperand();
+		if (memory != -1 && op != OP_Lea) {
+			if (instr.operandCount == 1 || memory > 0 || op == OP_Cmp || op == OP_Test) {
+				effects.loads = true;
+			} else {
+				effects.stores = true;
+				effects.loads = op != OP_Mov;
+			}
+		}
+		if (effects.loads) {
+			effects.latency += loadLatency;
+		}
+		return effects;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Dependence graph
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Участок команд без барьеров: ребро i -> j с задержкой latency[i][j] (-1 - нет ребра)
+	class CRegion {
+	public:
+		CRegion(const CInstrStream& _stream, const vector<const CInstr*>& _code, int sp, bool flagsLiveOut) :
+			stream(_stream), code(_code), n(_code.size()), edges(n, vector<int>(n, -1)), height(n, 0) {
+			for (int i = 0; i < n; i++) {
+				effects.push_back(effectsOf(*code[i], sp));
+			}
+			for (int j = 0; j < n; j++) {
+				for (int i = 0; i < j; i++) {
+					if (intersects(code[i]->defs, code[j]->uses)) {
+						addEdge(i, j, effects[i].latency);
+					}
+					if (intersects(code[i]->uses, code[j]->defs) || intersects(code[i]->defs, code[j]->defs)) {
+						addEdge(i, j, 0);
+					}
+					if (effects[i].stores && effects[j].loads) {
+						addEdge(i, j, storeForwarding);
+					}
+					if ((effects[i].loads || effects[i].stores) && effects[j].stores) {
+						addEdge(i, j, 0);
+					}
+				}
+			}
+			addFlagEdges(flagsLiveOut);
+			for (int i = n - 1; i >= 0; i--) {
+				height[i] = effects[i].latency;
+				for (int j = i + 1; j < n; j++) {
+					if (edges[i][j] != -1) {
+						height[i] = max(height[i], edges[i][j] + height[j]);
+					}
+				}
+			}
+		}
+
+		// Такты упорядоченной выдачи: не больше issueWidth команд за такт, каждая - не раньше готовности операндов
+		int Cycles(const vector<int>& order) const {
+			vector<int> issue(n, 0);
+			int cycle = 0;
+			int issued = 0;
+			int finish = 0;
+			for (int k = 0; k < order.size(); k++) {
+				int j = order[k];
+				int ready = cycle;
+				for (int i = 0; i < n; i++) {
+					if (edges[i][j] != -1) {
+						ready = max(ready, issue[i] + edges[i][j]);
+					}
+				}
+				if (ready > cycle || issued == issueWidth) {
+					cycle = max(ready, cycle + 1);
+					issued = 0;
+				}
+				issue[j] = cycle;
+				issued++;
+				finish = max(finish, cycle + effects[j].latency);
+			}
+			return finish;
+		}
+
+		// usesOutside - число чтений каждой переменной метода вне участка
+		vector<int> Schedule(TSchedulingMode mode, const vector<int>& usesOutside) const {
+			return (mode == SM_Latency) ? byLatency() : byPressure(usesOutside);
+		}
+
+	private:
+		const CInstrStream& stream;
+		const vector<const CInstr*>& code;
+		int n;
+		vector<CEffects> effects;
+		vector<vector<int>> edges;
+		// Самый длинный путь задержек от команды до конца участка
+		vector<int> height;
+
+		void addEdge(int i, int j, int latency) {
+			edges[i][j] = max(edges[i][j], latency);
+		}
+
+		// Флаги читает последняя запись перед чтением. Остальные записи флагов не должны попасть между ней и её
+		// чтениями; последняя запись участка живёт дальше, если за участком стоит условный переход
+		void addFlagEdges(bool flagsLiveOut) {
+			int writer = -1;
+			vector<pair<int, int>> live;
+			for (int j = 0; j < n; j++) {
+				if (effects[j].readsFlags && writer != -1) {
+					addEdge(writer, j, effects[writer].latency);
+					if (live.empty() || live.back().first != writer) {
+						live.push_back(make_pair(writer, j));
+					}
+					live.back().second = j;
+				}
+				if (effects[j].writesFlags) {
+					writer = j;
+				}
+			}
+			if (flagsLiveOut && writer != -1) {
+				live.push_back(make_pair(writer, n));
+			}
+			for (int k = 0; k < live.size(); k++) {
+				for (int x = 0; x < n; x++) {
+					if (!effects[x].writesFlags || x == live[k].first) {
+						continue;
+					}
+					if (x < live[k].first) {
+						addEdge(x, live[k].first, 0);
+					} else if (x > live[k].second) {
+						addEdge(live[k].second, x, 0);
+					}
+				}
+			}
+		}
+
+		vector<int> predecessors() const {
+			vector<int> count(n, 0);
+			for (int i = 0; i < n; i++) {
+				for (int j = 0; j < n; j++) {
+					count[j] += (edges[i][j] != -1) ? 1 : 0;
+				}
+			}
+			return count;
+		}
+
+		void release(int i, vector<int>& waiting) const {
+			for (int j = 0; j < n; j++) {
+				if (edges[i][j] != -1) {
+					waiting[j]--;
+				}
+			}
+		}
+
+		// По тактам: из готовых к такту команд - с наибольшей высотой, при равенстве - исходный порядок
+		vector<int> byLatency() const {
+			vector<int> waiting = predecessors();
+			vector<int> ready(n, 0);
+			vector<bool> done(n, false);
+			vector<int> order;
+			int cycle = 0;
+			while (order.size() < n) {
+				int issued = 0;
+				while (issued < issueWidth) {
+					int best = -1;
+					for (int j = 0; j < n; j++) {
+						if (!done[j] && waiting[j] == 0 && ready[j] <= cycle && (best == -1 || height[j] > height[best])) {
+							best = j;
+						}
+					}
+					if (best == -1) {
+						break;
+					}
+					done[best] = true;
+					order.push_back(best);
+					release(best, waiting);
+					for (int j = 0; j < n; j++) {
+						if (edges[best][j] != -1) {
+							ready[j] = max(ready[j], cycle + edges[best][j]);
+						}
+					}
+					issued++;
+				}
+				cycle++;
+			}
+			return order;
+		}
+
+		// Из команд, все предшественники которых уже выбраны, - с наименьшим приростом живых переменных: новые
+		// значения минус переменные, последнее использование которых в методе - эта команда.
+		// При равенстве - с наибольшей высотой, затем исходный порядок
+		vector<int> byPressure(const vector<int>& usesOutside) const {
+			vector<int> remaining(stream.TempsCount(), 0);
+			for (int i = 0; i < n; i++) {
+				for (int temp : code[i]->uses) {
+					remaining[temp]++;
+				}
+			}
+			vector<int> waiting = predecessors();
+			vector<bool> done(n, false);
+			vector<int> order;
+			while (order.size() < n) {
+				int best = -1;
+				int bestDelta = 0;
+				for (int j = 0; j < n; j++) {
+					if (done[j] || waiting[j] != 0) {
+						continue;
+					}
+					int delta = 0;
+					for (int temp : code[j]->defs) {
+						delta += (!code[j]->uses.Contains(temp)) ? 1 : 0;
+					}
+					for (int temp : code[j]->uses) {
+						// Чтение машинного регистра - обычно копия аргумента или результата вызова; чем раньше она
+						// выполнена, тем короче жизнь предраскрашенного регистра
+						bool last = Frame::CFrame::IsRegister(stream.Temp(temp).get())
+							|| (remaining[temp] == 1 && usesOutside[temp] == 0);
+						delta -= (last && !code[j]->defs.Contains(temp)) ? 1 : 0;
+					}
+					if (best == -1 || delta < bestDelta || (delta == bestDelta && height[j] > height[best])) {
+						best = j;
+						bestDelta = delta;
+					}
+				}
+				done[best] = true;
+				order.push_back(best);
+				release(best, waiting);
+				for (int temp : code[best]->uses) {
+					remaining[temp]--;
+				}
+			}
+			return order;
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Driver
+	//--------------------------------------------------------------------------------------------------------------
+
+	void Schedule(ostream& out, vector<CInstrStream>& blockInstructions, TSchedulingMode mode,
+		CSchedulerStatistics& stats) {
+		CDefaultMap defMap;
+		const CTemp* stackPointer = Frame::CFrame::allRegisters[Frame::CFrame::Target().stackPointer].get();
+		for (int m = 0; m < blockInstructions.size(); m++) {
+			CInstrStream& stream = blockInstructions[m];
+			int sp = stream.Find(stackPointer);
+			vector<int> uses(stream.TempsCount(), 0);
+			for (int i = 0; i < stream.Size(); i++) {
+				for (int temp : stream[i].uses) {
+					uses[temp]++;
+				}
+			}
+			// Участки читаются из stream, переставленные команды пишутся в code
+			vector<CInstr> code = stream.code;
+			int regions = 0;
+			int moved = 0;
+			int cyclesBefore = 0;
+			int cyclesAfter = 0;
+			for (int begin = 0; begin < stream.Size();) {
+				if (effectsOf(stream[begin], sp).barrier) {
+					begin++;
+					continue;
+				}
+				int end = begin;
+				while (end < stream.Size() && !effectsOf(stream[end], sp).barrier) {
+					end++;
+				}
+				vector<const CInstr*> region;
+				for (int k = begin; k < end; k++) {
+					region.push_back(&stream[k]);
+				}
+				bool flagsLiveOut = end < stream.Size() && effectsOf(stream[end], sp).readsFlags;
+				// Использования вне участка: переменная, которая там ещё читается, не освобождается внутри
+				vector<int> usesOutside = uses;
+				for (int k = 0; k < region.size(); k++) {
+					for (int temp : region[k]->uses) {
+						usesOutside[temp]--;
+					}
+				}
+				CRegion graph(stream, region, sp, flagsLiveOut);
+				vector<int> original;
+				for (int k = 0; k < region.size(); k++) {
+					original.push_back(k);
+				}
+				vector<int> order = graph.Schedule(mode, usesOutside);
+				regions++;
+				cyclesBefore += graph.Cycles(original);
+				cyclesAfter += graph.Cycles(order);
+				for (int k = 0; k < order.size(); k++) {
+					moved += (order[k] != k) ? 1 : 0;
+					code[begin + k] = *region[order[k]];
+				}
+				begin = end;
+			}
+			stream.code.swap(code);
+			stats.regions += regions;
+			stats.moved += moved;
+			stats.cyclesBefore += cyclesBefore;
+			stats.cyclesAfter += cyclesAfter;
+
+			const CLabel* entry = stream.Entry();
+			out << "===========================" << endl;
+			out << ((entry != 0) ? entry->Name() : to_string(m)) << ": regions " << regions << ", moved "
+				<< moved << ", estimated cycles " << cyclesBefore << " -> " << cyclesAfter << endl;
+			for (int i = 0; i < stream.Size(); i++) {
+				out << stream.Format(stream[i], &defMap);
+			}
+		}
+		out << "scheduling (" << ((mode == SM_Latency) ? "latency" : "register pressure") << "): regions "
+			<< stats.regions << ", moved " << stats.moved << ", estimated cycles " << stats.cyclesBefore << " -> "
+			<< stats.cyclesAfter << endl;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef COMPILERS_SCHEDULER_H
+#define COMPILERS_SCHEDULER_H
+#include "../common.h"
+#include "../Structs/Assembler.h"
+
+namespace CodeGenerator {
+	using namespace Assembler;
+
+	enum TSchedulingMode {
+		// До распределения регистров: из готовых команд первой идёт та, что меньше всего увеличивает число живых
+		// переменных
+		SM_Pressure,
+		// После распределения: первой идёт команда с самым длинным путём задержек до конца участка
+		SM_Latency
+	};
+
+	struct CSchedulerStatistics {
+		CSchedulerStatistics() : regions(0), moved(0), cyclesBefore(0), cyclesAfter(0) {}
+
+		// Участки между барьерами и команды, сменившие место
+		int regions;
+		int moved;
+		// Оценка тактов всех участков до и после планирования
+		int cyclesBefore;
+		int cyclesAfter;
+	};
+
+	// Списочное планирование внутри базовых блоков. Барьеры - метки, переходы, вызовы и команды над указателем
+	// стека - делят блок на участки; внутри участка граф зависимостей строится по defs/uses, флагам и памяти,
+	// задержки команд берутся из таблицы latencies (Scheduler.cpp). Оценка тактов - упорядоченная выдача
+	// issueWidth команд за такт с теми же задержками; она и перестановки по методам выводятся в out.
+	void Schedule(ostream& out, vector<CInstrStream>& blockInstructions, TSchedulingMode mode,
+		CSchedulerStatistics& stats);
+}
+
+#endif //COMPILERS_SCHEDULER_H
@@ -0,0 +1,521 @@
+#include "StrengthReduction.h"
+#include "../Structs/IRUtils.h"
+#include "../IRVisitors/SCCP.h"
+
+namespace SSA {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Линейная форма scale * i + sum(coefficient * t) + constant, t - инварианты цикла
+	struct CAffine {
+		CAffine() : valid(true), scale(0), constant(0) {}
+
+		bool valid;
+		int scale;
+		int constant;
+		map<const CTemp*, pair<TTemp, int>> terms;
+
+		bool IsConstant() const { return valid && scale == 0 && terms.empty(); }
+
+		// Коэффициенты считаются как константы целевой машины (IRTree::FoldBinop); если коэффициент не
+		// помещается в константу, форма недействительна
+		void Add(const CAffine& other, int factor) {
+			valid = valid && other.valid && combine(scale, other.scale, factor) && combine(constant, other.constant, factor);
+			for (map<const CTemp*, pair<TTemp, int>>::const_iterator it = other.terms.begin(); it != other.terms.end() && valid; it++) {
+				pair<TTemp, int>& term = terms[it->first];
+				term.first = it->second.first;
+				valid = combine(term.second, it->second.second, factor);
+				if (term.second == 0) {
+					terms.erase(it->first);
+				}
+			}
+		}
+
+		void Multiply(int factor) {
+			CAffine product;
+			product.Add(*this, factor);
+			*this = product;
+		}
+
+		// into += factor * value
+		static bool combine(int& into, int value, int factor) {
+			int product;
+			return IRTree::FoldBinop(MULT_OP, factor, value, product) && IRTree::FoldBinop(PLUS_OP, into, product, into);
+		}
+	};
+
+	static CAffine invalidAffine() {
+		CAffine affine;
+		affine.valid = false;
+		return affine;
+	}
+
+	static bool containsMultiplication(IExp* exp) {
+		BINOP* binop = dynamic_cast<BINOP*>(exp);
+		if (binop != 0 && binop->binop == MULT_OP) {
+			return true;
+		}
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			if (containsMultiplication(l->head)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static int countMultiplications(IStm* stm) {
+		int count = 0;
+		vector<IExp*> stack;
+		shared_ptr<ExpList> kids = stm->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			stack.push_back(l->head);
+		}
+		while (!stack.empty()) {
+			IExp* exp = stack.back();
+			stack.pop_back();
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			count += (binop != 0 && binop->binop == MULT_OP) ? 1 : 0;
+			kids = exp->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				stack.push_back(l->head);
+			}
+		}
+		return count;
+	}
+
+	// Условие a op b равносильно b op' a
+	static bool swapRelop(CJUMP_OP op, CJUMP_OP& swapped) {
+		switch (op) {
+			case EQ: case NE: swapped = op; return true;
+			case LT: swapped = GT; return true;
+			case GT: swapped = LT; return true;
+			case LE: swapped = GE; return true;
+			case GE: swapped = LE; return true;
+			default: return false;
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CStrengthReducer
+	//--------------------------------------------------------------------------------------------------------------
+
+	class CStrengthReducer {
+	public:
+		CStrengthReducer(CControlFlowGraph& _graph, CInductionStatistics& _stats) : graph(_graph), stats(_stats) {}
+
+		void Run() {
+			graph.ComputeDominators();
+			vector<CLoop> loops = graph.FindLoops();
+			if (loops.empty()) {
+				return;
+			}
+			for (int i = 0; i < loops.size(); i++) {
+				graph.InsertPreheader(loops[i]);
+			}
+			graph.ComputeDominators();
+			loops = graph.FindLoops();
+
+			for (int b = 0; b < graph.Size(); b++) {
+				CBlock& block = graph.blocks[b];
+				for (int p = 0; p < block.phis.size(); p++) {
+					definitions[block.phis[p].dst.get()] = make_pair(b, (IExp*) 0);
+				}
+				for (int i = 0; i < block.stms.size(); i++) {
+					TTemp def = IRTree::DefinedTemp(block.stms[i]);
+					if (def != nullptr) {
+						definitions[def.get()] = make_pair(b, static_cast<MOVE*>(block.stms[i])->src);
+					}
+				}
+			}
+
+			stats.loopMultiplicationsBefore += weightedMultiplications(loops);
+			for (int i = 0; i < loops.size(); i++) {
+				if (loops[i].preheader != -1) {
+					reduce(loops[i]);
+				}
+			}
+			stats.loopMultiplicationsAfter += weightedMultiplications(loops);
+			RemoveDeadDefinitions(graph);
+		}
+
+	private:
+		// i = phi(init, next), next = i + step
+		struct CInduction {
+			TTemp variable;
+			TTemp next;
+			TTemp init;
+			int step;
+		};
+
+		// p = phi(init, advanced), advanced = p + scale * step; p == scale * i + terms + constant
+		struct CRecurrence {
+			int induction;
+			CAffine form;
+			// scale * step
+			int step;
+			TTemp current;
+			TTemp advanced;
+		};
+
+		CControlFlowGraph& graph;
+		CInductionStatistics& stats;
+		// Блок и правая часть определения (0 для phi)
+		map<const CTemp*, pair<int, IExp*>> definitions;
+
+		int weightedMultiplications(const vector<CLoop>& loops) const {
+			int count = 0;
+			for (int i = 0; i < loops.size(); i++) {
+				for (int j = 0; j < loops[i].blocks.size(); j++) {
+					const CBlock& block = graph.blocks[loops[i].blocks[j]];
+					for (int s = 0; s < block.stms.size(); s++) {
+						count += countMultiplications(block.stms[s]);
+					}
+					count += countMultiplications(block.jump);
+				}
+			}
+			return count;
+		}
+
+		bool isInvariant(const CLoop& loop, const CTemp* temp) const {
+			map<const CTemp*, pair<int, IExp*>>::const_iterator it = definitions.find(temp);
+			return it == definitions.end() || !loop.contains[it->second.first];
+		}
+
+		void define(TTemp temp, int block, IExp* exp) {
+			graph.blocks[block].stms.push_back(new MOVE(new TEMP(temp), exp));
+			definitions[temp.get()] = make_pair(block, exp);
+		}
+
+		vector<CInduction> findInductions(const CLoop& loop, int entry) const {
+			vector<CInduction> inductions;
+			const CBlock& header = graph.blocks[loop.header];
+			for (int p = 0; p < header.phis.size(); p++) {
+				const CPhi& phi = header.phis[p];
+				CInduction induction;
+				induction.variable = phi.dst;
+				induction.init = phi.args[entry];
+				induction.next = nullptr;
+				bool same = true;
+				for (int a = 0; a < phi.args.size(); a++) {
+					if (a != entry) {
+						same = same && (induction.next == nullptr || induction.next == phi.args[a]);
+						induction.next = phi.args[a];
+					}
+				}
+				map<const CTemp*, pair<int, IExp*>>::const_iterator def = definitions.find(induction.next.get());
+				if (!same || def == definitions.end() || !loop.contains[def->second.first]) {
+					continue;
+				}
+				BINOP* binop = dynamic_cast<BINOP*>(def->second.second);
+				if (binop == 0 || (binop->binop != PLUS_OP && binop->binop != MINUS_OP)) {
+					continue;
+				}
+				TEMP* temp = dynamic_cast<TEMP*>(binop->left);
+				CONST* step = dynamic_cast<CONST*>(binop->right);
+				if (binop->binop == PLUS_OP && temp == 0) {
+					temp = dynamic_cast<TEMP*>(binop->right);
+					step = dynamic_cast<CONST*>(binop->left);
+				}
+				if (temp != 0 && step != 0 && temp->temp == phi.dst
+					&& IRTree::FoldBinop(binop->binop, 0, step->value, induction.step)) {
+					inductions.push_back(induction);
+				}
+			}
+			return inductions;
+		}
+
+		// Выражение как линейная функция индукционной переменной; определения внутри цикла раскрываются
+		CAffine affine(const CLoop& loop, const CInduction& induction, IExp* exp, int depth) const {
+			CONST* constant = dynamic_cast<CONST*>(exp);
+			if (constant != 0) {
+				CAffine result;
+				result.constant = constant->value;
+				return result;
+			}
+			TEMP* temp = dynamic_cast<TEMP*>(exp);
+			if (temp != 0) {
+				CAffine result;
+				if (temp->temp == induction.variable || temp->temp == induction.next) {
+					result.scale = 1;
+					result.constant = (temp->temp == induction.next) ? induction.step : 0;
+					return result;
+				}
+				if (isInvariant(loop, temp->temp.get())) {
+					result.terms[temp->temp.get()] = make_pair(temp->temp, 1);
+					return result;
+				}
+				IExp* src = definitions.find(temp->temp.get())->second.second;
+				if (dynamic_cast<BINOP*>(src) == 0 || depth > 8) {
+					return invalidAffine();
+				}
+				return affine(loop, induction, src, depth + 1);
+			}
+			BINOP* binop = dynamic_cast<BINOP*>(exp);
+			if (binop == 0) {
+				return invalidAffine();
+			}
+			CAffine left = affine(loop, induction, binop->left, depth);
+			CAffine right = affine(loop, induction, binop->right, depth);
+			switch (binop->binop) {
+				case PLUS_OP:
+					left.Add(right, 1);
+					return left;
+				case MINUS_OP:
+					left.Add(right, -1);
+					return left;
+				case MULT_OP:
+					if (right.IsConstant()) {
+						left.Multiply(right.constant);
+						return left;
+					}
+					if (left.IsConstant()) {
+						right.Multiply(left.constant);
+						return right;
+					}
+					return invalidAffine();
+				default:
+					return invalidAffine();
+			}
+		}
+
+		// scale * x + terms + constant; постоянный x сворачивается
+		static IExp* build(const CAffine& form, IExp* x) {
+			CONST* constant = dynamic_cast<CONST*>(x);
+			CAffine folded = form;
+			if (constant != 0 && CAffine::combine(folded.constant, constant->value, form.scale)) {
+				folded.scale = 0;
+				return build(folded, 0);
+			}
+			IExp* result = (form.scale == 0) ? 0 : (form.scale == 1) ? x : new BINOP(MULT_OP, x, new CONST(form.scale));
+			for (map<const CTemp*, pair<TTemp, int>>::const_iterator it = form.terms.begin(); it != form.terms.end(); it++) {
+				IExp* term = new TEMP(it->second.first);
+				term = (it->second.second == 1) ? term : new BINOP(MULT_OP, term, new CONST(it->second.second));
+				result = (result != 0) ? new BINOP(PLUS_OP, term, result) : term;
+			}
+			if (result == 0) {
+				return new CONST(form.constant);
+			}
+			return (form.constant != 0) ? new BINOP(PLUS_OP, result, new CONST(form.constant)) : result;
+		}
+
+		IExp* reduceExp(const CLoop& loop, const vector<CInduction>& inductions, vector<CRecurrence>& recurrences, IExp* exp) {
+			if (IRTree::IsLeaf(exp)) {
+				return exp;
+			}
+			if (containsMultiplication(exp)) {
+				for (int k = 0; k < inductions.size(); k++) {
+					CAffine form = affine(loop, inductions[k], exp, 0);
+					int step;
+					if (form.valid && form.scale != 0 && IRTree::FoldBinop(MULT_OP, form.scale, inductions[k].step, step)) {
+						stats.reducedExpressions++;
+						return recurrence(recurrences, k, form, step);
+					}
+				}
+			}
+			shared_ptr<ExpList> kids = exp->kids();
+			if (kids == nullptr) {
+				return exp;
+			}
+			vector<IExp*> reduced;
+			bool changed = false;
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				reduced.push_back(reduceExp(loop, inductions, recurrences, l->head));
+				changed = changed || reduced.back() != l->head;
+			}
+			return changed ? exp->build(IRTree::MakeExpList(reduced)) : exp;
+		}
+
+		// Рекурренты, отличающиеся только константой, объединяются: p + (c1 - c0)
+		IExp* recurrence(vector<CRecurrence>& recurrences, int induction, const CAffine& form, int step) {
+			int r = 0;
+			int delta = 0;
+			while (r < recurrences.size() && !(recurrences[r].induction == induction
+				   && recurrences[r].form.scale == form.scale && recurrences[r].form.terms == form.terms
+				   && IRTree::FoldBinop(MINUS_OP, form.constant, recurrences[r].form.constant, delta))) {
+				r++;
+			}
+			if (r == recurrences.size()) {
+				CRecurrence recurrence;
+				recurrence.induction = induction;
+				recurrence.form = form;
+				recurrence.step = step;
+				recurrence.current = make_shared<const CTemp>();
+				recurrence.advanced = make_shared<const CTemp>();
+				recurrences.push_back(recurrence);
+				delta = 0;
+			}
+			IExp* current = new TEMP(recurrences[r].current);
+			return (delta != 0) ? new BINOP(PLUS_OP, current, new CONST(delta)) : current;
+		}
+
+		void insertAfterDefinition(TTemp temp, IStm* stm) {
+			vector<IStm*>& stms = graph.blocks[definitions[temp.get()].first].stms;
+			for (int i = 0; i < stms.size(); i++) {
+				if (IRTree::DefinedTemp(stms[i]) == temp) {
+					stms.insert(stms.begin() + i + 1, stm);
+					return;
+				}
+			}
+			assert(false);
+		}
+
+		void reduce(const CLoop& loop) {
+			CBlock& header = graph.blocks[loop.header];
+			int entry = find(header.preds.begin(), header.preds.end(), loop.preheader) - header.preds.begin();
+			vector<CInduction> inductions = findInductions(loop, entry);
+			stats.inductionVariables += inductions.size();
+			if (inductions.empty()) {
+				return;
+			}
+
+			vector<CRecurrence> recurrences;
+			for (int i = 0; i < loop.blocks.size(); i++) {
+				CBlock& block = graph.blocks[loop.blocks[i]];
+				for (int s = 0; s < block.stms.size(); s++) {
+					IStm* stm = block.stms[s];
+					shared_ptr<ExpList> kids = stm->kids();
+					vector<IExp*> reduced;
+					bool changed = false;
+					for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+						reduced.push_back(reduceExp(loop, inductions, recurrences, l->head));
+						changed = changed || reduced.back() != l->head;
+					}
+					if (changed) {
+						block.stms[s] = stm->build(IRTree::MakeExpList(reduced));
+						TTemp def = IRTree::DefinedTemp(block.stms[s]);
+						if (def != nullptr) {
+							definitions[def.get()].second = static_cast<MOVE*>(block.stms[s])->src;
+						}
+					}
+				}
+			}
+
+			for (int r = 0; r < recurrences.size(); r++) {
+				CRecurrence& recurrence = recurrences[r];
+				const CInduction& induction = inductions[recurrence.induction];
+				TTemp init = make_shared<const CTemp>();
+				map<const CTemp*, pair<int, IExp*>>::iterator start = definitions.find(induction.init.get());
+				IExp* initial = (start != definitions.end() && dynamic_cast<CONST*>(start->second.second) != 0)
+								? start->second.second : new TEMP(induction.init);
+				define(init, loop.preheader, build(recurrence.form, initial));
+				IExp* advance = new BINOP(PLUS_OP, new TEMP(recurrence.current), new CONST(recurrence.step));
+				insertAfterDefinition(induction.next, new MOVE(new TEMP(recurrence.advanced), advance));
+				definitions[recurrence.advanced.get()] = make_pair(definitions[induction.next.get()].first, advance);
+
+				CPhi phi(recurrence.current, header.preds.size());
+				for (int a = 0; a < phi.args.size(); a++) {
+					phi.args[a] = (a == entry) ? init : recurrence.advanced;
+				}
+				header.phis.push_back(phi);
+				definitions[recurrence.current.get()] = make_pair(loop.header, (IExp*) 0);
+				stats.recurrences++;
+			}
+
+			// Вычисления через i, заменённые рекуррентами, больше не нужны и не должны мешать удалить i
+			RemoveDeadDefinitions(graph);
+			for (int k = 0; k < inductions.size(); k++) {
+				for (int r = 0; r < recurrences.size(); r++) {
+					if (recurrences[r].induction == k && replaceTest(loop, inductions[k], recurrences[r])) {
+						break;
+					}
+				}
+			}
+		}
+
+		// Linear function test replacement: i op bound  ->  p op' scale * bound + terms + constant
+		bool replaceTest(const CLoop& loop, const CInduction& induction, const CRecurrence& recurrence) {
+			map<const CTemp*, int> uses;
+			vector<TTemp> temps;
+			for (int b = 0; b < graph.Size(); b++) {
+				const CBlock& block = graph.blocks[b];
+				for (int p = 0; p < block.phis.size(); p++) {
+					temps.insert(temps.end(), block.phis[p].args.begin(), block.phis[p].args.end());
+				}
+				for (int s = 0; s < block.stms.size(); s++) {
+					IRTree::CollectUses(block.stms[s], temps);
+				}
+				IRTree::CollectUses(block.jump, temps);
+			}
+			for (int t = 0; t < temps.size(); t++) {
+				uses[temps[t].get()]++;
+			}
+
+			for (int i = 0; i < loop.blocks.size(); i++) {
+				CBlock& block = graph.blocks[loop.blocks[i]];
+				CJUMP* test = dynamic_cast<CJUMP*>(block.jump);
+				if (test == 0) {
+					continue;
+				}
+				TEMP* left = dynamic_cast<TEMP*>(test->left);
+				bool inductionLeft = left != 0 && (left->temp == induction.variable || left->temp == induction.next);
+				IExp* x = inductionLeft ? test->left : test->right;
+				IExp* bound = inductionLeft ? test->right : test->left;
+				TEMP* variable = dynamic_cast<TEMP*>(x);
+				if (variable == 0 || (variable->temp != induction.variable && variable->temp != induction.next)
+					|| !isInvariantExp(loop, bound)) {
+					continue;
+				}
+				// При отрицательном множителе сравнение меняет направление; беззнаковые сравнения не переписываются
+				CJUMP_OP op;
+				if (!swapRelop(test->relop, op)) {
+					return false;
+				}
+				op = (recurrence.form.scale > 0) ? test->relop : op;
+				// Кроме проверки, i используется только в собственном приращении и в phi заголовка
+				int expected = 2 + (graph.blocks[loop.header].preds.size() - 1);
+				if (uses[induction.variable.get()] + uses[induction.next.get()] != expected) {
+					return false;
+				}
+
+				TTemp limit = make_shared<const CTemp>();
+				define(limit, loop.preheader, build(recurrence.form, bound));
+				IExp* pointer = new TEMP((variable->temp == induction.variable) ? recurrence.current : recurrence.advanced);
+				IExp* newLeft = inductionLeft ? pointer : new TEMP(limit);
+				IExp* newRight = inductionLeft ? new TEMP(limit) : pointer;
+				block.jump = new CJUMP(op, newLeft, newRight, test->iftrue, test->iffalse);
+
+				removeInduction(loop, induction);
+				stats.replacedTests++;
+				stats.removedVariables++;
+				return true;
+			}
+			return false;
+		}
+
+		bool isInvariantExp(const CLoop& loop, IExp* exp) const {
+			if (!IRTree::IsPure(exp)) {
+				return false;
+			}
+			vector<TTemp> temps;
+			IRTree::CollectUses(exp, temps);
+			for (int t = 0; t < temps.size(); t++) {
+				if (!isInvariant(loop, temps[t].get())) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void removeInduction(const CLoop& loop, const CInduction& induction) {
+			vector<CPhi>& phis = graph.blocks[loop.header].phis;
+			for (int p = 0; p < phis.size(); p++) {
+				if (phis[p].dst == induction.variable) {
+					phis.erase(phis.begin() + p);
+					break;
+				}
+			}
+			vector<IStm*>& stms = graph.blocks[definitions[induction.next.get()].first].stms;
+			for (int i = 0; i < stms.size(); i++) {
+				if (IRTree::DefinedTemp(stms[i]) == induction.next) {
+					stms.erase(stms.begin() + i);
+					break;
+				}
+			}
+		}
+	};
+
+	void ReduceStrength(CControlFlowGraph& graph, CInductionStatistics& stats) {
+		CStrengthReducer reducer(graph, stats);
+		reducer.Run();
+	}
+}
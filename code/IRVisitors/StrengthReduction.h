@@ -0,0 +1,33 @@
+#ifndef COMPILERS_STRENGTHREDUCTION_H
+#define COMPILERS_STRENGTHREDUCTION_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace SSA {
+	using namespace Canon;
+
+	struct CInductionStatistics {
+		CInductionStatistics() : inductionVariables(0), reducedExpressions(0), recurrences(0), replacedTests(0),
+			removedVariables(0), loopMultiplicationsBefore(0), loopMultiplicationsAfter(0) {}
+
+		// Базовые индукционные переменные: i = phi(i0, i + c)
+		int inductionVariables;
+		// Выражения c * i + b, заменённые переменными-рекуррентами
+		int reducedExpressions;
+		int recurrences;
+		// Условия выхода, переписанные через рекурренту (linear function test replacement)
+		int replacedTests;
+		int removedVariables;
+		// Умножения в телах циклов с весом - глубиной вложенности
+		int loopMultiplicationsBefore;
+		int loopMultiplicationsAfter;
+	};
+
+	// Снижение стоимости операций над индукционными переменными: выражение c * i + b с умножением
+	// (адрес элемента массива a + (i + 1) * 4) заменяется рекуррентой p = phi(p0, p + c * step),
+	// которая увеличивается вместе с i. Если после этого i нужна только для проверки выхода
+	// из цикла, проверка переписывается через p, а i удаляется. Нужны предзаголовки циклов.
+	void ReduceStrength(CControlFlowGraph& graph, CInductionStatistics& stats);
+}
+
+#endif //COMPILERS_STRENGTHREDUCTION_H
@@ -0,0 +1,261 @@
+#include "TailCalls.h"
+#include "../Structs/ControlFlowGraph.h"
+#include "../Structs/FrameSlots.h"
+#include "../Structs/IRUtils.h"
+
+namespace Canon {
+	using Frame::CFrame;
+	using Frame::CFragment;
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Вызов в операторе MOVE(TEMP t, CALL) или EXP(CALL), иначе 0
+	static CALL* callOf(IStm* stm) {
+		if (MOVE* move = dynamic_cast<MOVE*>(stm)) {
+			return (dynamic_cast<TEMP*>(move->dst) != 0) ? dynamic_cast<CALL*>(move->src) : 0;
+		}
+		EXP* exp = dynamic_cast<EXP*>(stm);
+		return (exp != 0) ? dynamic_cast<CALL*>(exp->exp) : 0;
+	}
+
+	// Запись результата метода MOVE(TEMP rv, e)
+	static bool isReturn(IStm* stm) {
+		MOVE* move = dynamic_cast<MOVE*>(stm);
+		TEMP* temp = (move != 0) ? dynamic_cast<TEMP*>(move->dst) : 0;
+		return temp != 0 && temp->temp == CFrame::ReturnValue();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CTailPath
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Путь от вызова до выхода из метода: разрешены переходы, копирования результата вызова и записи,
+	// которые после выхода никто не прочитает
+	class CTailPath {
+	public:
+		CTailPath(const CControlFlowGraph& _graph, const CFrameSlots& _frameSlots) : graph(_graph), frameSlots(_frameSlots) {}
+
+		// Вызов в операторе index блока block хвостовой. Результатом метода может быть константа, если вызывается
+		// сам метод: его единственный return вернул бы её же. Вызов может и сам быть return: MOVE(TEMP rv, CALL)
+		bool IsTail(int block, int index, bool selfCall) {
+			copies.clear();
+			slots.clear();
+			bool returned = isReturn(graph.blocks[block].stms[index]);
+			TTemp result = IRTree::DefinedTemp(graph.blocks[block].stms[index]);
+			if (result != nullptr) {
+				copies.insert(result.get());
+			}
+			set<int> visited;
+			int b = block;
+			int i = index + 1;
+			while (true) {
+				const CBlock& current = graph.blocks[b];
+				for (; i < current.stms.size(); i++) {
+					IStm* stm = current.stms[i];
+					if (isReturn(stm)) {
+						if (returned) {
+							return false;
+						}
+						IExp* value = static_cast<MOVE*>(stm)->src;
+						JUMP* jump = dynamic_cast<JUMP*>(current.jump);
+						return i + 1 == current.stms.size() && jump != 0 && jump->target == graph.exit
+							&& (isResult(value) || (selfCall && dynamic_cast<CONST*>(value) != 0));
+					}
+					if (!skip(stm)) {
+						return false;
+					}
+				}
+				JUMP* jump = dynamic_cast<JUMP*>(current.jump);
+				if (jump == 0) {
+					return false;
+				}
+				if (returned && jump->target == graph.exit) {
+					return true;
+				}
+				b = graph.BlockByLabel(jump->target);
+				if (b == -1 || !visited.insert(b).second) {
+					return false;
+				}
+				i = 0;
+			}
+		}
+
+	private:
+		const CControlFlowGraph& graph;
+		const CFrameSlots& frameSlots;
+		// Переменные и ячейки кадра, в которых сейчас лежит результат вызова
+		set<const CTemp*> copies;
+		set<pair<const CTemp*, int>> slots;
+
+		bool isResult(IExp* exp) const {
+			if (TEMP* temp = dynamic_cast<TEMP*>(exp)) {
+				return copies.count(temp->temp.get()) != 0;
+			}
+			pair<const CTemp*, int> slot = frameSlots.Match(exp);
+			return slot.first != nullptr && slots.count(slot) != 0;
+		}
+
+		// Оператор можно удалить: после выхода из метода ни переменные, ни его кадр не читаются
+		bool skip(IStm* stm) {
+			MOVE* move = dynamic_cast<MOVE*>(stm);
+			if (move == 0) {
+				return false;
+			}
+			bool result = isResult(move->src);
+			if (!result && !IRTree::IsPure(move->src)) {
+				return false;
+			}
+			if (TEMP* temp = dynamic_cast<TEMP*>(move->dst)) {
+				if (result) {
+					copies.insert(temp->temp.get());
+				} else {
+					copies.erase(temp->temp.get());
+				}
+				return true;
+			}
+			pair<const CTemp*, int> slot = frameSlots.Match(move->dst);
+			if (slot.first == nullptr) {
+				return false;
+			}
+			if (result) {
+				slots.insert(slot);
+			} else {
+				slots.erase(slot);
+			}
+			return true;
+		}
+	};
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Rewriting
+	//--------------------------------------------------------------------------------------------------------------
+
+	// Аргументы сначала вычисляются во временные переменные: они могут читать параметры, которые перезаписываются
+	static void replaceByJump(CBlock& block, int index, CALL* call, CFrame* frame, const CLabel* loop) {
+		vector<IStm*> stms(block.stms.begin(), block.stms.begin() + index);
+		vector<TTemp> values;
+		for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get()) {
+			values.push_back(make_shared<const CTemp>());
+			stms.push_back(new MOVE(new TEMP(values.back()), arg->head));
+		}
+		assert(values.size() == frame->formalsCount());
+		for (int k = 0; k < values.size(); k++) {
+			stms.push_back(new MOVE(frame->getFormal(k)->getExp(), new TEMP(values[k])));
+		}
+		block.stms.swap(stms);
+		block.jump = new JUMP(loop);
+	}
+
+	// Все аргументы помещаются в регистры: в стек пришлось бы писать поверх аргументов, которые положил
+	// вызывающий этот метод, а их может быть меньше
+	static bool argumentsInRegisters(CALL* call) {
+		int count = 0;
+		for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get()) {
+			count++;
+		}
+		return count == 0 || CFrame::ArgumentRegister(count - 1) != nullptr;
+	}
+
+	// MOVE(TEMP rv, CALL tail) и переход на выход. Адрес метода и аргументы вычисляются заранее, чтобы
+	// после восстановления сохраняемых регистров (CFrame::ProcEntryExit1) оставалось только переложить их
+	// в регистры аргументов
+	static void replaceByTailCall(CBlock& block, int index, CALL* call, const CLabel* exit) {
+		vector<IStm*> stms(block.stms.begin(), block.stms.begin() + index);
+		IExp* func = call->func;
+		if (dynamic_cast<NAME*>(func) == 0) {
+			TTemp address = make_shared<const CTemp>();
+			stms.push_back(new MOVE(new TEMP(address), func));
+			func = new TEMP(address);
+		}
+		vector<IExp*> values;
+		for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get()) {
+			if (dynamic_cast<CONST*>(arg->head) != 0 || dynamic_cast<TEMP*>(arg->head) != 0) {
+				values.push_back(arg->head);
+				continue;
+			}
+			TTemp value = make_shared<const CTemp>();
+			stms.push_back(new MOVE(new TEMP(value), arg->head));
+			values.push_back(new TEMP(value));
+		}
+		shared_ptr<ExpList> args;
+		for (int k = values.size() - 1; k >= 0; k--) {
+			args = make_shared<ExpList>(values[k], args);
+		}
+		stms.push_back(new MOVE(new TEMP(CFrame::ReturnValue()), new CALL(func, args, true)));
+		block.stms.swap(stms);
+		block.jump = new JUMP(exit);
+	}
+
+	void EliminateTailCalls(ostream& out, vector<shared_ptr<StmtList>>& stmts, const vector<CFragment>& fragments,
+		CTailCallStatistics& stats)
+	{
+		assert(stmts.size() == fragments.size());
+		set<const CLabel*> methods;
+		for (int i = 0; i < fragments.size(); i++) {
+			methods.insert(fragments[i].label.get());
+		}
+
+		for (int f = 0; f < stmts.size(); f++) {
+			CControlFlowGraph graph(stmts[f]);
+			const CLabel* self = fragments[f].label.get();
+			if (graph.blocks[0].label != self) {
+				continue;
+			}
+			CFrameSlots frameSlots(graph);
+			CTailPath path(graph, frameSlots);
+			const CLabel* loop = 0;
+			bool changed = false;
+			for (int b = 0; b < graph.Size(); b++) {
+				for (int i = 0; i < graph.blocks[b].stms.size(); i++) {
+					CALL* call = callOf(graph.blocks[b].stms[i]);
+					NAME* name = (call != 0) ? dynamic_cast<NAME*>(call->func) : 0;
+					if (call == 0 || (name != 0 && methods.count(name->label.get()) == 0)) {
+						continue;
+					}
+					stats.calls++;
+					string callee = (name != 0) ? name->label->Name() : "<virtual>";
+					if (name != 0 && name->label.get() == self) {
+						if (!path.IsTail(b, i, true)) {
+							continue;
+						}
+						if (loop == 0) {
+							loop = new CLabel();
+						}
+						replaceByJump(graph.blocks[b], i, call, fragments[f].frame.get(), loop);
+						stats.selfTailCalls++;
+						out << self->Name() << ": " << callee << " - self tail call, replaced by jump" << endl;
+						// Остаток блока заменён переходом
+						break;
+					}
+					if (!path.IsTail(b, i, false)) {
+						continue;
+					}
+					stats.otherTailCalls++;
+					if (!argumentsInRegisters(call)) {
+						out << self->Name() << ": " << callee << " - tail call, frame is not reused: arguments on stack"
+							<< endl;
+						continue;
+					}
+					replaceByTailCall(graph.blocks[b], i, call, graph.exit);
+					stats.reusedFrames++;
+					changed = true;
+					out << self->Name() << ": " << callee << " - tail call, frame is reused" << endl;
+					break;
+				}
+			}
+			if (loop == 0) {
+				if (changed) {
+					stmts[f] = graph.ToStmtList();
+				}
+				continue;
+			}
+
+			// Пролог метода остаётся перед меткой цикла
+			CBlock body = graph.blocks[0];
+			body.label = loop;
+			graph.blocks[0].stms.clear();
+			graph.blocks[0].jump = new JUMP(loop);
+			graph.blocks.insert(graph.blocks.begin() + 1, body);
+			stmts[f] = graph.ToStmtList();
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef COMPILERS_TAILCALLS_H
+#define COMPILERS_TAILCALLS_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+#include "../Structs/Frame.h"
+
+namespace Canon {
+	using namespace IRTree;
+
+	struct CTailCallStatistics {
+		CTailCallStatistics() : calls(0), selfTailCalls(0), otherTailCalls(0), reusedFrames(0) {}
+
+		// Вызовы методов программы (без _malloc и _print)
+		int calls;
+		// Хвостовые вызовы метода самого себя, заменённые переходом
+		int selfTailCalls;
+		// Хвостовые вызовы других методов и те из них, что выполняются переходом в освобождённом кадре
+		int otherTailCalls;
+		int reusedFrames;
+	};
+
+	// Устранение хвостовой рекурсии в линеаризованных деревьях. Вызов MOVE(TEMP t, CALL(NAME f, this, args))
+	// или EXP(CALL(NAME f, ...)) в методе f хвостовой, если после него до записи результата в регистр возврата
+	// выполняются только переходы, копирования t и записи в ячейки кадра, а результат - t или константа
+	// (у метода единственный return, поэтому вложенный вызов вернул бы ту же константу).
+	// Вызов MOVE(TEMP rv, CALL) (return f(...)) хвостовой, если дальше до выхода только переходы и такие же записи.
+	// Такой вызов заменяется записью аргументов в ячейки параметров кадра и переходом на метку сразу после входа.
+	// Хвостовой вызов другого метода (результат - t) помечается CALL::tail, если все его аргументы помещаются
+	// в регистры: генератор кода восстанавливает сохраняемые регистры, снимает кадр эпилогом и переходит
+	// в вызываемый метод командой jmp, и тот возвращается прямо к вызывающему этот метод. Аргументы в стеке
+	// пришлось бы писать на место аргументов этого метода, поэтому такие вызовы остаются обычными.
+	// Отчёт о каждом хвостовом вызове выводится в out.
+	void EliminateTailCalls(ostream& out, vector<shared_ptr<StmtList>>& stmts, const vector<Frame::CFragment>& fragments,
+		CTailCallStatistics& stats);
+}
+
+#endif //COMPILERS_TAILCALLS_H
@@ -12,6 +12,8 @@ namespace IRTree {
 	class NAME;
 	class TEMP;
 	class BINOP;
+	class CMP;
+	class SELECT;
 	class MEM;
 	class CALL;
 	class ESEQ;
@@ -32,6 +34,8 @@ public:
 	virtual void Visit(IRTree::NAME* node) = 0;
 	virtual void Visit(IRTree::TEMP* node) = 0;
 	virtual void Visit(IRTree::BINOP* node) = 0;
+	virtual void Visit(IRTree::CMP* node) = 0;
+	virtual void Visit(IRTree::SELECT* node) = 0;
 	virtual void Visit(IRTree::MEM* node)= 0;
 	virtual void Visit(IRTree::CALL* node) = 0;
 	virtual void Visit(IRTree::ESEQ* node) = 0;
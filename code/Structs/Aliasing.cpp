@@ -0,0 +1,142 @@
+#include "../Structs/Aliasing.h"
+#include "../Structs/Frame.h"
+#include "../Structs/IRUtils.h"
+
+namespace Canon {
+	// this - первый параметр метода
+	static int thisOffset() {
+		return -Frame::CFrame::wordSize;
+	}
+
+	set<const CTemp*> CAliasAnalysis::inlinedFields;
+
+	void CAliasAnalysis::AddInlinedFields(shared_ptr<const CTemp> framePointer) {
+		inlinedFields.insert(framePointer.get());
+	}
+
+	CAliasAnalysis::CAliasAnalysis(const CControlFlowGraph& graph) : separateFields(true) {
+		set<const CTemp*> defined;
+		vector<shared_ptr<const CTemp>> used;
+		for (int b = 0; b < graph.Size(); b++) {
+			const CBlock& block = graph.blocks[b];
+			for (int p = 0; p < block.phis.size(); p++) {
+				defined.insert(block.phis[p].dst.get());
+				merged.insert(block.phis[p].dst.get());
+				used.insert(used.end(), block.phis[p].args.begin(), block.phis[p].args.end());
+			}
+			for (int i = 0; i < block.stms.size(); i++) {
+				shared_ptr<const CTemp> def = IRTree::DefinedTemp(block.stms[i]);
+				if (def != nullptr) {
+					// Повторное определение (вне SSA-формы) делает значение неизвестным
+					if (defined.insert(def.get()).second) {
+						definitions[def.get()] = static_cast<MOVE*>(block.stms[i])->src;
+					} else {
+						definitions.erase(def.get());
+					}
+				}
+				IRTree::CollectUses(block.stms[i], used);
+			}
+			IRTree::CollectUses(block.jump, used);
+		}
+		for (int i = 0; i < used.size(); i++) {
+			if (defined.find(used[i].get()) == defined.end()) {
+				if (inlinedFields.find(used[i].get()) != inlinedFields.end()) {
+					separateFields = false;
+				}
+				// Параметры, хранящиеся в переменных, тоже не определяются в теле
+				if (Frame::CFrame::FormalIndex(used[i].get()) == -1) {
+					framePointers.insert(used[i].get());
+				}
+			}
+		}
+	}
+
+	void CAliasAnalysis::Define(shared_ptr<const CTemp> temp, IExp* exp) {
+		definitions[temp.get()] = exp;
+	}
+
+	IExp* CAliasAnalysis::resolve(IExp* exp) const {
+		TEMP* temp = dynamic_cast<TEMP*>(exp);
+		// Глубина ограничена на случай цепочек копий вне SSA-формы
+		for (int depth = 0; temp != 0 && depth < 8; depth++) {
+			map<const CTemp*, IExp*>::const_iterator it = definitions.find(temp->temp.get());
+			if (it == definitions.end() || (dynamic_cast<BINOP*>(it->second) == 0 && dynamic_cast<TEMP*>(it->second) == 0)) {
+				break;
+			}
+			exp = it->second;
+			temp = dynamic_cast<TEMP*>(exp);
+		}
+		return exp;
+	}
+
+	bool CAliasAnalysis::isFramePointer(IExp* exp) const {
+		TEMP* temp = dynamic_cast<TEMP*>(exp);
+		return temp != 0 && framePointers.find(temp->temp.get()) != framePointers.end();
+	}
+
+	bool CAliasAnalysis::isThis(IExp* exp) const {
+		if (!separateFields) {
+			return false;
+		}
+		exp = resolve(exp);
+		TEMP* temp = dynamic_cast<TEMP*>(exp);
+		if (temp != 0 && Frame::CFrame::FormalIndex(temp->temp.get()) == 0) {
+			return true;
+		}
+		if (temp != 0) {
+			map<const CTemp*, IExp*>::const_iterator it = definitions.find(temp->temp.get());
+			exp = (it != definitions.end()) ? it->second : exp;
+		}
+		MEM* mem = dynamic_cast<MEM*>(exp);
+		if (mem == 0) {
+			return false;
+		}
+		BINOP* address = dynamic_cast<BINOP*>(resolve(mem->exp));
+		CONST* offset = (address != 0) ? dynamic_cast<CONST*>(address->right) : 0;
+		return offset != 0 && address->binop == PLUS_OP && offset->value == thisOffset() && isFramePointer(resolve(address->left));
+	}
+
+	// Ссылка на объект или массив: параметр, значение, загруженное из памяти, возвращённое вызовом или слитое phi.
+	// Адрес ячейки кадра не может храниться в памяти и передаваться между методами.
+	bool CAliasAnalysis::isHeapReference(IExp* exp) const {
+		TEMP* temp = dynamic_cast<TEMP*>(exp);
+		if (temp != 0) {
+			const CTemp* t = temp->temp.get();
+			return definitions.find(t) != definitions.end() || merged.find(t) != merged.end()
+				|| Frame::CFrame::FormalIndex(t) != -1;
+		}
+		return dynamic_cast<MEM*>(exp) != 0 || dynamic_cast<CALL*>(exp) != 0;
+	}
+
+	string CAliasAnalysis::Classify(IExp* address) const {
+		address = resolve(address);
+		if (isFramePointer(address)) {
+			return "s0";
+		}
+		if (isThis(address)) {
+			return "f0";
+		}
+		BINOP* binop = dynamic_cast<BINOP*>(address);
+		if (binop == 0) {
+			return isHeapReference(address) ? "a" : "?";
+		}
+		if (binop->binop != PLUS_OP) {
+			return "?";
+		}
+		IExp* base = resolve(binop->left);
+		CONST* offset = dynamic_cast<CONST*>(binop->right);
+		if (isFramePointer(base)) {
+			return (offset != 0) ? "s" + to_string(offset->value) : "?";
+		}
+		if (isThis(base)) {
+			return (offset != 0) ? "f" + to_string(offset->value) : "?";
+		}
+		// Элемент массива, в том числе с постоянным индексом после свёртки
+		return isHeapReference(base) ? "a" : "?";
+	}
+
+	bool CAliasAnalysis::IsSafe(IExp* address) const {
+		string memoryClass = Classify(address);
+		return memoryClass[0] == 's' || memoryClass[0] == 'f';
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef COMPILERS_ALIASING_H
+#define COMPILERS_ALIASING_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace Canon {
+	// Классы ячеек памяти функции. В MiniJava к полям обращаются только через this,
+	// адрес локальной переменной не может утечь, поэтому по базе адреса различаются:
+	// "s<c>" - ячейка кадра fp + c, "f<c>" - поле this + c, "a" - прочая куча (элементы и длины
+	// массивов, поля только что созданных объектов), "?" - адрес неизвестного вида.
+	// Ячейки разных классов не пересекаются, "?" пересекается со всеми.
+	// Встроенный метод обращается к полям другого объекта, который может оказаться и this:
+	// в такой функции поля this относятся к "a".
+	class CAliasAnalysis {
+	public:
+		// Указатель кадра - переменная, которая используется, но нигде не определяется (кроме параметров
+		// в переменных, см. CFrame::FormalIndex)
+		CAliasAnalysis(const CControlFlowGraph& graph);
+
+		// Отмечает функцию (по указателю кадра или переменной this), в которую встроены обращения к полям других объектов
+		static void AddInlinedFields(shared_ptr<const CTemp> framePointer);
+
+		// Новая переменная, созданная проходом; адреса через неизвестные переменные относятся к "?"
+		void Define(shared_ptr<const CTemp> temp, IExp* exp);
+
+		string Classify(IExp* address) const;
+		// Чтение по адресу не может обратиться к несуществующей памяти: ячейка кадра или поле this
+		bool IsSafe(IExp* address) const;
+
+	private:
+		// Выражения, которыми определены переменные (в SSA-форме определение единственно)
+		map<const CTemp*, IExp*> definitions;
+		set<const CTemp*> framePointers;
+		// Поля this отделены от остальной кучи
+		bool separateFields;
+		static set<const CTemp*> inlinedFields;
+		// Результаты phi-функций
+		set<const CTemp*> merged;
+
+		// Переменная, определённая копией, заменяется исходным выражением
+		IExp* resolve(IExp* exp) const;
+		bool isFramePointer(IExp* exp) const;
+		bool isThis(IExp* exp) const;
+		bool isHeapReference(IExp* exp) const;
+	};
+}
+
+#endif //COMPILERS_ALIASING_H
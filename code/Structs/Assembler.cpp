@@ -2,163 +2,266 @@
 
 
 namespace Assembler {
-	//--------------------------------------------------------------------------------------------------------------
-	// CTargets
-	//--------------------------------------------------------------------------------------------------------------
-	
-	CTargets::CTargets(CLabelList* _labels) : labels(_labels) {}
+	static const char* const opcodeNames[] = { "", "", "mov", "movzx", "lea", "add", "sub", "imul", "idiv", "cdq",
+		"cqo", "and", "or", "xor", "shl", "shr", "sar", "cmp", "test", "set", "cmov", "j", "jmp", "CALL", "push", "pop",
+		"ret" };
+	static const char* const conditionNames[] = { "e", "ne", "l", "g", "le", "ge", "b", "be", "a", "ae" };
+
+	const char* OpcodeName(TOpcode opcode) {
+		return opcodeNames[opcode];
+	}
+
+	const char* ConditionName(TCondition condition) {
+		return conditionNames[condition];
+	}
 
 	//--------------------------------------------------------------------------------------------------------------
-	// CInstr
+	// CInstrOperand
 	//--------------------------------------------------------------------------------------------------------------
-	
-	CInstr::CInstr(const std::string& a) : assemCmd(a) {}
 
-	shared_ptr<const CTemp> CInstr::getTemp(CTempList* l, int tempNumber) {
-		if (l == 0) {
-			std::cerr << tempNumber << std::endl;
-			//return  std::make_shared<CTemp>();
-		}
-		if (tempNumber == 0) {
-			return l->head;
-		} else {
-			if (l->tail == 0) {
-				std::cerr << tempNumber << std::endl;
-			}
-			return getTemp(l->tail, tempNumber - 1);
-		}
+	CInstrOperand CInstrOperand::Def(int number) {
+		CInstrOperand operand;
+		operand.kind = K_Def;
+		operand.temp = number;
+		return operand;
 	}
 
-	const CLabel* CInstr::getLabel(CLabelList* l, int tempNumber) {
-		if (l == 0) {
-			//std::cerr << tempNumber << std::endl;
-			//return new CLabel();
-		}
-		if (tempNumber == 0) {
-			return l->head;
-		} else {
-			if (l->tail == 0) {
-				//std::cerr << tempNumber << std::endl;
-			}
-			return getLabel(l->tail, tempNumber - 1);
-		}
+	CInstrOperand CInstrOperand::Use(int number) {
+		CInstrOperand operand;
+		operand.kind = K_Use;
+		operand.temp = number;
+		return operand;
 	}
 
-	std::string CInstr::format(CTempMap* m) {
-		CTempList* dst = def();
-		CTempList* src = use();
-		CTargets* j = jumps();
-		CLabelList* jump = ( j == nullptr) ? nullptr : j->labels;
-		std::string s;
-		//std::cerr << assemCmd << std::endl;
-		int len = assemCmd.length();
-		for (int i = 0; i < len; ++i) {
-			if (assemCmd[i] == '`') {
-
-				int n = 0;
-				switch(assemCmd[++i]) {
-					case 's':
-						n = std::stoi(&assemCmd[++i]);
-						s.append(m->tempMap(getTemp(src, n)));
-						break;
-					case 'd':
-						n = std::stoi(&assemCmd[++i]);
-						s.append(m->tempMap(getTemp(dst, n)));
-						break;
-					case 'j':
-						n = std::stoi(&assemCmd[++i]);
-						s.append(getLabel(jump, n)->Name());
-						break;
-					case '`':
-						s.append("`");
-						break;
-					default:
-						std::cerr << "ERROR" << std::endl;
-						std::cerr << assemCmd << std::endl;
-						throw new std::invalid_argument("assembler syntax error");
-				}
-			} else {
-				s += assemCmd[i];
-			}
-		}
-		return s;
+	CInstrOperand CInstrOperand::Imm(int value) {
+		CInstrOperand operand;
+		operand.kind = K_Imm;
+		operand.value = value;
+		return operand;
 	}
 
-	//--------------------------------------------------------------------------------------------------------------
-	// CInstrList
-	//--------------------------------------------------------------------------------------------------------------
-	
-	CInstrList::CInstrList(CInstr* _head, CInstrList* _tail): head(_head), tail(_tail) {}
+	CInstrOperand CInstrOperand::Name(const CLabel* label) {
+		CInstrOperand operand;
+		operand.kind = K_Name;
+		operand.label = label;
+		return operand;
+	}
+
+	CInstrOperand CInstrOperand::Memory(int base, int index, int scale, int value, int size) {
+		CInstrOperand operand;
+		operand.kind = K_Memory;
+		operand.base = base;
+		operand.index = index;
+		operand.scale = scale;
+		operand.value = value;
+		operand.size = size;
+		return operand;
+	}
+
+	CInstrOperand CInstrOperand::Label(int number) {
+		CInstrOperand operand;
+		operand.kind = K_Label;
+		operand.temp = number;
+		return operand;
+	}
 
 	//--------------------------------------------------------------------------------------------------------------
-	// ALABEL
+	// CTempIds
 	//--------------------------------------------------------------------------------------------------------------
-	
-	ALABEL::ALABEL(const std::string& a, const CLabel* l) : CInstr(a), label(l) {}
 
-	CTempList* ALABEL::use() {
-		return nullptr;
+	void CTempIds::Add(int id) {
+		assert(count < capacity);
+		ids[count++] = id;
 	}
 
-	CTempList* ALABEL::def() {
-		return nullptr;
+	bool CTempIds::Contains(int id) const {
+		for (int i = 0; i < count; i++) {
+			if (ids[i] == id) {
+				return true;
+			}
+		}
+		return false;
 	}
 
-	CTargets* ALABEL::jumps() {
-		return nullptr;
+	//--------------------------------------------------------------------------------------------------------------
+	// CInstr
+	//--------------------------------------------------------------------------------------------------------------
+
+	CInstr::CInstr(TOpcode _opcode, std::initializer_list<CInstrOperand> _operands) :
+		opcode(_opcode), condition(C_E), operandCount(0), labelCount(0), move(false) {
+		for (const CInstrOperand& operand : _operands) {
+			AddOperand(operand);
+		}
 	}
 
-	void ALABEL::Print(ostream& s){
-		s<<"ALABEL";
+	void CInstr::AddOperand(const CInstrOperand& operand) {
+		assert(operandCount < maxOperands);
+		operands[operandCount++] = operand;
 	}
 
+	int CInstr::MemoryOperand() const {
+		for (int i = 0; i < operandCount; i++) {
+			if (operands[i].kind == CInstrOperand::K_Memory) {
+				return i;
+			}
+		}
+		return -1;
+	}
 
 	//--------------------------------------------------------------------------------------------------------------
-	// AMOVE
+	// CInstrStream
 	//--------------------------------------------------------------------------------------------------------------
-	
-	AMOVE::AMOVE(const std::string& a, shared_ptr<const CTemp> d, shared_ptr<const CTemp> s) : CInstr(a), dst(d), src(s) {}	
 
-	CTempList* AMOVE::use() {
-		return new CTempList(src, nullptr);
+	int CInstrStream::Intern(const shared_ptr<const CTemp>& temp) {
+		std::unordered_map<const CTemp*, int>::iterator it = ids.find(temp.get());
+		if (it != ids.end()) {
+			return it->second;
+		}
+		ids[temp.get()] = temps.size();
+		temps.push_back(temp);
+		return temps.size() - 1;
 	}
 
-	CTempList* AMOVE::def() {
-		return new CTempList(dst, nullptr);
-	}
-	CTargets* AMOVE::jumps() {
-		return nullptr;
+	int CInstrStream::Find(const CTemp* temp) const {
+		std::unordered_map<const CTemp*, int>::const_iterator it = ids.find(temp);
+		return (it != ids.end()) ? it->second : -1;
 	}
 
-	void AMOVE::Print(ostream& s){
-		s<<"AMOVE";
+	CInstr CInstrStream::Instr(TOpcode opcode, std::initializer_list<CInstrOperand> operands,
+		const vector<shared_ptr<const CTemp>>& defs, const vector<shared_ptr<const CTemp>>& uses) {
+		CInstr instr(opcode, operands);
+		for (int i = 0; i < defs.size(); i++) {
+			instr.defs.Add(Intern(defs[i]));
+		}
+		for (int i = 0; i < uses.size(); i++) {
+			instr.uses.Add(Intern(uses[i]));
+		}
+		return instr;
 	}
 
-	//--------------------------------------------------------------------------------------------------------------
-	// AOPER
-	//--------------------------------------------------------------------------------------------------------------
-	
-	AOPER::AOPER(const std::string& a, CTempList* d, CTempList* s, CLabelList* j) 
-	: CInstr(a), dst(d), src(s), jump(new CTargets(j)) {}
+	CInstr CInstrStream::Move(const shared_ptr<const CTemp>& dst, const shared_ptr<const CTemp>& src) {
+		CInstr instr(OP_Mov, { CInstrOperand::Def(0), CInstrOperand::Use(0) });
+		instr.defs.Add(Intern(dst));
+		instr.uses.Add(Intern(src));
+		instr.move = true;
+		return instr;
+	}
 
-	AOPER::AOPER(const std::string& a, CTempList* d, CTempList* s) 
-	: CInstr(a), dst(d), src(s), jump(nullptr) {}
+	CInstr CInstrStream::Label(const CLabel* label) {
+		CInstr instr(OP_Label);
+		instr.labels[instr.labelCount++] = label;
+		return instr;
+	}
 
+	CInstr CInstrStream::Jump(const CLabel* target) {
+		CInstr instr(OP_Jmp, { CInstrOperand::Label(0) });
+		instr.labels[instr.labelCount++] = target;
+		return instr;
+	}
 
-	CTempList* AOPER::use() {
-		return src;
+	CInstr CInstrStream::ConditionalJump(TCondition condition, const CLabel* iftrue, const CLabel* iffalse) {
+		CInstr instr(OP_Jcc, { CInstrOperand::Label(0) });
+		instr.condition = condition;
+		instr.labels[instr.labelCount++] = iftrue;
+		instr.labels[instr.labelCount++] = iffalse;
+		return instr;
 	}
 
-	CTempList* AOPER::def() {
-		return dst;
+	const CLabel* CInstrStream::Entry() const {
+		return (!code.empty() && code[0].IsLabel()) ? code[0].labels[0] : 0;
 	}
 
-	CTargets* AOPER::jumps() {
-		return jump;
+	//--------------------------------------------------------------------------------------------------------------
+	// Formatting
+	//--------------------------------------------------------------------------------------------------------------
+
+	static void appendNumber(std::string& s, long long value) {
+		char buffer[24];
+		int length = 0;
+		unsigned long long magnitude = (value < 0) ? -(unsigned long long) value : value;
+		do {
+			buffer[length++] = '0' + magnitude % 10;
+			magnitude /= 10;
+		} while (magnitude != 0);
+		if (value < 0) {
+			s += '-';
+		}
+		while (length > 0) {
+			s += buffer[--length];
+		}
 	}
 
-	void AOPER::Print(ostream& s){
-		s<<"AOPER";
+	static void appendOperand(std::string& s, const CInstrOperand& operand, const CInstr& instr,
+		const CInstrStream& stream, CTempMap* m) {
+		switch (operand.kind) {
+			case CInstrOperand::K_Def:
+				s += m->tempMap(stream.Temp(instr.defs[operand.temp]));
+				break;
+			case CInstrOperand::K_Use:
+				s += m->tempMap(stream.Temp(instr.uses[operand.temp]));
+				break;
+			case CInstrOperand::K_Imm:
+				appendNumber(s, operand.value);
+				break;
+			case CInstrOperand::K_Name:
+				s += operand.label->Name();
+				break;
+			case CInstrOperand::K_Label:
+				s += instr.labels[operand.temp]->Name();
+				break;
+			case CInstrOperand::K_Memory: {
+				if (operand.size != 0) {
+					s += (operand.size == 8) ? "qword " : "dword ";
+				}
+				s += '[';
+				bool empty = true;
+				if (operand.base != -1) {
+					s += m->tempMap(stream.Temp(instr.uses[operand.base]));
+					empty = false;
+				}
+				if (operand.index != -1) {
+					s += empty ? "" : " + ";
+					s += m->tempMap(stream.Temp(instr.uses[operand.index]));
+					if (operand.scale != 1) {
+						s += '*';
+						appendNumber(s, operand.scale);
+					}
+					empty = false;
+				}
+				if (empty) {
+					appendNumber(s, operand.value);
+				} else if (operand.value != 0) {
+					s += (operand.value > 0) ? " + " : " - ";
+					appendNumber(s, (operand.value > 0) ? (long long) operand.value : -(long long) operand.value);
+				}
+				s += ']';
+				break;
+			}
+			default:
+				throw new std::invalid_argument("empty operand");
+		}
 	}
 
-}
\ No newline at end of file
+	std::string CInstrStream::Format(const CInstr& instr, CTempMap* m) const {
+		std::string s;
+		if (instr.opcode == OP_None) {
+			return s;
+		}
+		if (instr.opcode == OP_Label) {
+			s = instr.labels[0]->Name();
+			s += ":\n";
+			return s;
+		}
+		s.reserve(32);
+		s += opcodeNames[instr.opcode];
+		if (instr.opcode == OP_Set || instr.opcode == OP_Cmov || instr.opcode == OP_Jcc) {
+			s += conditionNames[instr.condition];
+		}
+		for (int i = 0; i < instr.operandCount; i++) {
+			s += (i == 0) ? " " : ", ";
+			appendOperand(s, instr.operands[i], instr, *this, m);
+		}
+		s += '\n';
+		return s;
+	}
+}
@@ -1,81 +1,154 @@
 #ifndef ASSEMBLER_H_INCLUDED
 #define ASSEMBLER_H_INCLUDED
 #include "../Structs/TempMap.h"
+#include <initializer_list>
+#include <unordered_map>
 
 using namespace Temp;
 
 namespace Assembler {
 
-	class CTargets {
-	public:
-		CTargets(CLabelList* _labels);
-		CLabelList* labels;
+	// Команды, которые выпускают генератор кода и кадр. OP_None - пустая команда-сток в конце метода
+	enum TOpcode {
+		OP_None, OP_Label,
+		OP_Mov, OP_Movzx, OP_Lea, OP_Add, OP_Sub, OP_Imul, OP_Idiv, OP_Cdq, OP_Cqo, OP_And, OP_Or, OP_Xor,
+		OP_Shl, OP_Shr, OP_Sar, OP_Cmp, OP_Test,
+		// Условие - поле condition команды
+		OP_Set, OP_Cmov, OP_Jcc,
+		OP_Jmp, OP_Call, OP_Push, OP_Pop, OP_Ret,
+		OP_Count
+	};
 
+	// Условия setcc, cmovcc и jcc в порядке CJUMP_OP
+	enum TCondition { C_E, C_NE, C_L, C_G, C_LE, C_GE, C_B, C_BE, C_A, C_AE, C_Count };
+
+	const char* OpcodeName(TOpcode opcode);
+	const char* ConditionName(TCondition condition);
+
+	// Операнд команды. Переменные хранятся номерами в defs и uses команды: распределение регистров и
+	// переписывание команд меняют переменные, не трогая операнды
+	struct CInstrOperand {
+		enum TKind {
+			K_None,
+			// defs[temp] или uses[temp]
+			K_Def, K_Use,
+			K_Imm,
+			// Адрес метки label
+			K_Name,
+			// [uses[base] + uses[index]*scale + value]; отсутствующие base и index равны -1,
+			// size - размер ячейки в байтах, если он не следует из других операндов, иначе 0
+			K_Memory,
+			// labels[temp]
+			K_Label
+		};
+
+		CInstrOperand() : kind(K_None), temp(-1), base(-1), index(-1), scale(1), size(0), value(0), label(0) {}
+
+		static CInstrOperand Def(int number);
+		static CInstrOperand Use(int number);
+		static CInstrOperand Imm(int value);
+		static CInstrOperand Name(const CLabel* label);
+		static CInstrOperand Memory(int base, int index, int scale, int value, int size);
+		static CInstrOperand Label(int number);
+
+		TKind kind;
+		signed char temp;
+		signed char base;
+		signed char index;
+		unsigned char scale;
+		unsigned char size;
+		int value;
+		const CLabel* label;
 	};
 
-	class CInstr {
+	// Переменные команды - номера в таблице CInstrStream::temps, хранятся в самой команде. Больше всего их
+	// у вызова (портящиеся регистры), у стока в конце метода и у хвостового вызова (аргументы и сохраняемые регистры)
+	class CTempIds {
 	public:
-		CInstr(const std::string& a);
-  		std::string assemCmd;
+		static const int capacity = 16;
 
-		virtual CTempList* use() = 0;
-		virtual CTempList* def() = 0;
-		virtual CTargets* jumps() = 0;
+		CTempIds() : count(0) {}
 
-		shared_ptr<const CTemp> getTemp(CTempList* l, int tempNumber);
-  		const CLabel* getLabel(CLabelList* l, int tempNumber);
-  		std::string format(CTempMap* m);
+		int Size() const { return count; }
+		bool Empty() const { return count == 0; }
+		int operator[](int i) const { return ids[i]; }
+		const int* begin() const { return ids; }
+		const int* end() const { return ids + count; }
 
-		virtual void Print(ostream& s) = 0;
-	};
+		void Add(int id);
+		void Set(int i, int id) { ids[i] = id; }
+		bool Contains(int id) const;
 
-	class CInstrList {
-	public:
-		CInstrList(CInstr* _head, CInstrList* _tail);
-		CInstr* head;
-		CInstrList* tail;
+	private:
+		int count;
+		int ids[capacity];
 	};
 
-	class ALABEL: public CInstr {
-	public:	
-		ALABEL(const std::string& a, const CLabel* l);
-		const CLabel* label;
-
-		CTempList* use();
-		CTempList* def();
-		CTargets* jumps();
-		virtual void Print(ostream& s);
+	class CInstr {
+	public:
+		static const int maxOperands = 2;
+		static const int maxLabels = 2;
+
+		CInstr(TOpcode _opcode = OP_None, std::initializer_list<CInstrOperand> _operands = {});
+
+		TOpcode opcode;
+		// Для OP_Set, OP_Cmov и OP_Jcc
+		TCondition condition;
+		CInstrOperand operands[maxOperands];
+		int operandCount;
+		CTempIds defs;
+		CTempIds uses;
+		// Метка OP_Label или цели OP_Jmp и OP_Jcc (у jcc первой идёт цель при выполненном условии)
+		const CLabel* labels[maxLabels];
+		int labelCount;
+		// Пересылка регистр-регистр mov defs[0], uses[0]: распределение регистров может слить её переменные
+		bool move;
+
+		void AddOperand(const CInstrOperand& operand);
+		// Номер операнда-ячейки памяти или -1
+		int MemoryOperand() const;
+		bool IsLabel() const { return opcode == OP_Label; }
+		// Переход: поток управления идёт только в labels
+		bool IsJump() const { return opcode == OP_Jmp || opcode == OP_Jcc; }
+		// Хвостовой вызов jmp f: переход без меток, в этот метод управление не возвращается
+		bool IsTailCall() const { return opcode == OP_Jmp && labelCount == 0; }
 	};
 
-
-	class AMOVE: public CInstr {
+	// Команды метода подряд и таблица его переменных. Номера переменных плотные, поэтому живость и граф
+	// интерференции работают с ними напрямую, без поиска по указателям
+	class CInstrStream {
 	public:
-		shared_ptr<const CTemp> dst;
-		shared_ptr<const CTemp> src;
-		AMOVE(const std::string& a, shared_ptr<const CTemp> d, shared_ptr<const CTemp> s);
-
-		CTempList* use();
-		CTempList* def();
-		CTargets* jumps();
-		virtual void Print(ostream& s);
+		vector<CInstr> code;
+
+		int Size() const { return code.size(); }
+		CInstr& operator[](int i) { return code[i]; }
+		const CInstr& operator[](int i) const { return code[i]; }
+
+		// Номер переменной, новая переменная добавляется в конец таблицы
+		int Intern(const shared_ptr<const CTemp>& temp);
+		// Номер переменной или -1
+		int Find(const CTemp* temp) const;
+		const shared_ptr<const CTemp>& Temp(int id) const { return temps[id]; }
+		int TempsCount() const { return temps.size(); }
+
+		// Команды над переменными этого метода
+		CInstr Instr(TOpcode opcode, std::initializer_list<CInstrOperand> operands,
+			const vector<shared_ptr<const CTemp>>& defs, const vector<shared_ptr<const CTemp>>& uses);
+		CInstr Move(const shared_ptr<const CTemp>& dst, const shared_ptr<const CTemp>& src);
+		static CInstr Label(const CLabel* label);
+		static CInstr Jump(const CLabel* target);
+		static CInstr ConditionalJump(TCondition condition, const CLabel* iftrue, const CLabel* iffalse);
+
+		// Метка входа метода или 0
+		const CLabel* Entry() const;
+		std::string Format(const CInstr& instr, CTempMap* m) const;
+
+	private:
+		vector<shared_ptr<const CTemp>> temps;
+		std::unordered_map<const CTemp*, int> ids;
 	};
 
-   	class AOPER: public CInstr {
-   	public:
-   		CTempList* dst;
-   		CTempList* src;
-   		CTargets* jump;
-
-   		AOPER(const std::string& a, CTempList* d, CTempList* s, CLabelList* j);
-   		AOPER(const std::string& a, CTempList* d, CTempList* s);
-
-   		CTempList* use();
-		CTempList* def();
-		CTargets* jumps();
-		virtual void Print(ostream& s);
-   };
-
 }
 
 
-#endif
\ No newline at end of file
+#endif
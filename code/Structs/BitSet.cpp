@@ -0,0 +1,255 @@
+#include "../Structs/BitSet.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Dataflow {
+	//--------------------------------------------------------------------------------------------------------------
+	// Kernels
+	//--------------------------------------------------------------------------------------------------------------
+	// Все ядра работают над n словами, n кратно 4. Возвращают true, если dst изменился.
+
+#if defined(__AVX2__)
+	static bool unionKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m256i changed = _mm256_setzero_si256();
+		for (int i = 0; i < n; i += 4) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			changed = _mm256_or_si256(changed, _mm256_andnot_si256(a, b));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(a, b));
+		}
+		return !_mm256_testz_si256(changed, changed);
+	}
+
+	static bool intersectKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m256i changed = _mm256_setzero_si256();
+		for (int i = 0; i < n; i += 4) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			changed = _mm256_or_si256(changed, _mm256_andnot_si256(b, a));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(a, b));
+		}
+		return !_mm256_testz_si256(changed, changed);
+	}
+
+	static bool diffKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m256i changed = _mm256_setzero_si256();
+		for (int i = 0; i < n; i += 4) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			changed = _mm256_or_si256(changed, _mm256_and_si256(a, b));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_andnot_si256(b, a));
+		}
+		return !_mm256_testz_si256(changed, changed);
+	}
+
+	static bool transferKernel(uint64_t* dst, const uint64_t* gen, const uint64_t* input, const uint64_t* kill, int n) {
+		__m256i changed = _mm256_setzero_si256();
+		for (int i = 0; i < n; i += 4) {
+			__m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gen + i));
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+			__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kill + i));
+			__m256i r = _mm256_or_si256(g, _mm256_andnot_si256(k, x));
+			changed = _mm256_or_si256(changed, _mm256_xor_si256(r, old));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+		}
+		return !_mm256_testz_si256(changed, changed);
+	}
+
+	const char* CBitSet::KernelName() {
+		return "AVX2";
+	}
+#elif defined(__SSE2__)
+	static bool anyBits(__m128i v) {
+		return _mm_movemask_epi8(_mm_cmpeq_epi32(v, _mm_setzero_si128())) != 0xFFFF;
+	}
+
+	static bool unionKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m128i changed = _mm_setzero_si128();
+		for (int i = 0; i < n; i += 2) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			changed = _mm_or_si128(changed, _mm_andnot_si128(a, b));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(a, b));
+		}
+		return anyBits(changed);
+	}
+
+	static bool intersectKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m128i changed = _mm_setzero_si128();
+		for (int i = 0; i < n; i += 2) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			changed = _mm_or_si128(changed, _mm_andnot_si128(b, a));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(a, b));
+		}
+		return anyBits(changed);
+	}
+
+	static bool diffKernel(uint64_t* dst, const uint64_t* src, int n) {
+		__m128i changed = _mm_setzero_si128();
+		for (int i = 0; i < n; i += 2) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			changed = _mm_or_si128(changed, _mm_and_si128(a, b));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_andnot_si128(b, a));
+		}
+		return anyBits(changed);
+	}
+
+	static bool transferKernel(uint64_t* dst, const uint64_t* gen, const uint64_t* input, const uint64_t* kill, int n) {
+		__m128i changed = _mm_setzero_si128();
+		for (int i = 0; i < n; i += 2) {
+			__m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gen + i));
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+			__m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kill + i));
+			__m128i r = _mm_or_si128(g, _mm_andnot_si128(k, x));
+			changed = _mm_or_si128(changed, _mm_xor_si128(r, old));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+		}
+		return anyBits(changed);
+	}
+
+	const char* CBitSet::KernelName() {
+		return "SSE2";
+	}
+#else
+	static bool unionKernel(uint64_t* dst, const uint64_t* src, int n) {
+		uint64_t changed = 0;
+		for (int i = 0; i < n; i++) {
+			changed |= src[i] & ~dst[i];
+			dst[i] |= src[i];
+		}
+		return changed != 0;
+	}
+
+	static bool intersectKernel(uint64_t* dst, const uint64_t* src, int n) {
+		uint64_t changed = 0;
+		for (int i = 0; i < n; i++) {
+			changed |= dst[i] & ~src[i];
+			dst[i] &= src[i];
+		}
+		return changed != 0;
+	}
+
+	static bool diffKernel(uint64_t* dst, const uint64_t* src, int n) {
+		uint64_t changed = 0;
+		for (int i = 0; i < n; i++) {
+			changed |= dst[i] & src[i];
+			dst[i] &= ~src[i];
+		}
+		return changed != 0;
+	}
+
+	static bool transferKernel(uint64_t* dst, const uint64_t* gen, const uint64_t* input, const uint64_t* kill, int n) {
+		uint64_t changed = 0;
+		for (int i = 0; i < n; i++) {
+			uint64_t r = gen[i] | (input[i] & ~kill[i]);
+			changed |= r ^ dst[i];
+			dst[i] = r;
+		}
+		return changed != 0;
+	}
+
+	const char* CBitSet::KernelName() {
+		return "scalar";
+	}
+#endif
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CBitSet
+	//--------------------------------------------------------------------------------------------------------------
+
+	CBitSet::CBitSet(int _size, bool filled) :
+		size(_size),
+		words(((_size + 64 * wordsPerBlock - 1) / (64 * wordsPerBlock)) * wordsPerBlock, 0)
+	{
+		if (filled) {
+			Fill(true);
+		}
+	}
+
+	int CBitSet::Size() const {
+		return size;
+	}
+
+	bool CBitSet::Test(int i) const {
+		assert(i >= 0 && i < size);
+		return (words[i / 64] >> (i % 64)) & 1;
+	}
+
+	void CBitSet::Set(int i) {
+		assert(i >= 0 && i < size);
+		words[i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	void CBitSet::Reset(int i) {
+		assert(i >= 0 && i < size);
+		words[i / 64] &= ~(uint64_t(1) << (i % 64));
+	}
+
+	void CBitSet::Fill(bool value) {
+		std::fill(words.begin(), words.end(), value ? ~uint64_t(0) : uint64_t(0));
+		clearTail();
+	}
+
+	int CBitSet::Count() const {
+		int count = 0;
+		for (int i = 0; i < words.size(); i++) {
+			count += __builtin_popcountll(words[i]);
+		}
+		return count;
+	}
+
+	bool CBitSet::Empty() const {
+		for (int i = 0; i < words.size(); i++) {
+			if (words[i] != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool CBitSet::UnionWith(const CBitSet& other) {
+		assert(size == other.size);
+		return unionKernel(words.data(), other.words.data(), words.size());
+	}
+
+	bool CBitSet::IntersectWith(const CBitSet& other) {
+		assert(size == other.size);
+		return intersectKernel(words.data(), other.words.data(), words.size());
+	}
+
+	bool CBitSet::Subtract(const CBitSet& other) {
+		assert(size == other.size);
+		return diffKernel(words.data(), other.words.data(), words.size());
+	}
+
+	bool CBitSet::Transfer(const CBitSet& gen, const CBitSet& input, const CBitSet& kill) {
+		assert(size == gen.size && size == input.size && size == kill.size);
+		return transferKernel(words.data(), gen.words.data(), input.words.data(), kill.words.data(), words.size());
+	}
+
+	bool CBitSet::operator==(const CBitSet& other) const {
+		return size == other.size && words == other.words;
+	}
+
+	bool CBitSet::operator!=(const CBitSet& other) const {
+		return !(*this == other);
+	}
+
+	void CBitSet::clearTail() {
+		for (int i = size; i < words.size() * 64; i++) {
+			if (i % 64 == 0) {
+				std::fill(words.begin() + i / 64, words.end(), 0);
+				return;
+			}
+			words[i / 64] &= ~(uint64_t(1) << (i % 64));
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef COMPILERS_BITSET_H
+#define COMPILERS_BITSET_H
+#include "../common.h"
+#include <cstdint>
+
+namespace Dataflow {
+	// Плотное битовое множество над универсумом [0, size).
+	// Слова хранятся с выравниванием длины до блока из 4 слов,
+	// чтобы операции над множествами шли целыми векторами SSE2/AVX2 без хвостов.
+	class CBitSet {
+	public:
+		CBitSet(int _size = 0, bool filled = false);
+
+		int Size() const;
+		bool Test(int i) const;
+		void Set(int i);
+		void Reset(int i);
+		void Fill(bool value);
+		int Count() const;
+		bool Empty() const;
+
+		// Операции возвращают true, если множество изменилось
+		bool UnionWith(const CBitSet& other);
+		bool IntersectWith(const CBitSet& other);
+		bool Subtract(const CBitSet& other);
+		// this = gen | (input & ~kill)
+		bool Transfer(const CBitSet& gen, const CBitSet& input, const CBitSet& kill);
+
+		bool operator==(const CBitSet& other) const;
+		bool operator!=(const CBitSet& other) const;
+
+		template<class F>
+		void ForEach(F f) const {
+			for (int w = 0; w < words.size(); w++) {
+				uint64_t word = words[w];
+				while (word != 0) {
+					int bit = __builtin_ctzll(word);
+					f(w * 64 + bit);
+					word &= word - 1;
+				}
+			}
+		}
+
+		// Имя набора команд, которым собраны ядра (для отчётов)
+		static const char* KernelName();
+
+	private:
+		static const int wordsPerBlock = 4;
+		int size;
+		vector<uint64_t> words;
+
+		void clearTail();
+	};
+}
+
+#endif //COMPILERS_BITSET_H
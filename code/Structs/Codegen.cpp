@@ -1,330 +1,1045 @@
 #include "../Structs/Codegen.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/ConstantArithmetic.h"
+#include <cctype>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
 
 using namespace IRTree;
 using namespace Frame;
+using namespace CodeGenerator;
 
-CCodegen::CCodegen():  instrList(0), last(0) {}
-	
+typedef shared_ptr<const CTemp> TTemp;
 
-void CCodegen::MunchStm(IStm* s) {
-	SEQ* seq = dynamic_cast<SEQ*>(s);
-	if ( seq != 0 ) {
-		MunchStm(seq);
-	} else {
-		MOVE* move = dynamic_cast<MOVE*>(s);
-		if (move != 0) {
-			MunchMove(move->dst, move->src);
-		} else {
-			LABEL* label = dynamic_cast<LABEL*>(s);
-			if (label != 0) {
-				MunchStm(label);
-			} else {
-				EXP* exp = dynamic_cast<EXP*>(s);
-				if (exp != 0) {
-					CALL* call = dynamic_cast<CALL*>(exp->exp);
-					if (call != 0) {
-						MunchExpCall(call);
-					}
-				} else {
-					JUMP* jmp = dynamic_cast<JUMP*>(s);
-					if (jmp != 0) {
-						emit(new AOPER("jmp `j0\n", 
-								nullptr, 
-								nullptr, 
-								
-								new CLabelList(jmp->target, nullptr)		)
-							);
-					}
-					CJUMP* cjump = dynamic_cast<CJUMP*>(s);
-					if (cjump != 0) {
-						emit(new AOPER("cmp `s0, `s1\n", nullptr, 
-										new CTempList( 
-													MunchExp(cjump->left), 
-													new CTempList(MunchExp(cjump->right), nullptr)
-													)
-										)
-							);
-						std::string jumpCmdName;
-						if (cjump->relop == EQ) {
-							jumpCmdName = "je";
-						} else if (cjump->relop == LT) {
-							jumpCmdName = "jl";
-						}
-						emit(new AOPER(jumpCmdName + "   `j0\n", nullptr, nullptr,
-							new CLabelList(cjump->iftrue, new CLabelList(cjump->iffalse, nullptr))));
-					}
+//----------------------------------------------------------------------------------------------------------------------
+// Grammar
+//----------------------------------------------------------------------------------------------------------------------
 
-				}
-			}
+enum TNonterminal {
+	N_Stm, N_Reg, N_Temp, N_Imm,
+	// Константа 1, 2, 4 или 8 - множитель индекса в адресе
+	N_Scale,
+	N_Name,
+	// index*scale + disp
+	N_Index,
+	// Адрес [base + index*scale + disp] и ячейка по нему
+	N_Addr, N_Mem,
+	// Допустимые операнды-источники: регистр, константа или память; регистр или константа; регистр или память
+	N_Src, N_Ri, N_Rm,
+	N_Count
+};
+static const char* const nonterminalNames[] = { "stm", "reg", "temp", "imm", "scale", "name", "index", "addr", "mem",
+	"src", "ri", "rm" };
+
+enum TOperator {
+	O_Move, O_Exp, O_Jump, O_CJump, O_Label, O_Seq, O_Mem, O_Plus, O_Minus, O_Mul, O_Div, O_And, O_Or, O_Shl, O_Shr,
+	O_Sar, O_Cmp, O_Select, O_Const, O_Temp, O_Name, O_Call, O_Count
+};
+static const char* const operatorNames[] = { "MOVE", "EXP", "JUMP", "CJUMP", "LABEL", "SEQ", "MEM", "PLUS", "MINUS",
+	"MUL", "DIV", "AND", "OR", "SHL", "SHR", "SAR", "CMP", "SELECT", "CONST", "TEMP", "NAME", "CALL" };
+
+enum TAction {
+	// Команды шаблона assem
+	A_Emit,
+	A_Temp, A_Const, A_Name,
+	// Операнд единственного нетерминала без изменений
+	A_Same,
+	// Сумма операндов как адрес
+	A_Address,
+	A_Call, A_Jump, A_Label,
+	// Хвостовой вызов MOVE(TEMP rv, CALL tail): переход вместо call, результат пишет вызываемый метод
+	A_TailCall,
+	// Чтение-изменение-запись: адрес второго MEM совпадает с адресом первого и не вычисляется повторно
+	A_ReadModifyWrite,
+	// Умножение или деление на константу: команды и их число зависят от константы (см. constantSequence)
+	A_Constant
+};
+
+enum TPredicate { P_None, P_Scale, P_SameMemoryLeft, P_SameMemoryRight, P_DstNotInRight, P_ZeroRight, P_ElseIsDst,
+	P_DstNotInSelect, P_TailCall };
+
+struct CTileRule {
+	TNonterminal result;
+	// Операторы - заглавными буквами, нетерминалы - строчными. Оператор без аргументов сопоставляется
+	// с узлом независимо от его потомков
+	const char* pattern;
+	// Команды плюс обращения к памяти; imul и idiv дороже на свою задержку
+	int cost;
+	TAction action;
+	// Команды через ';': %d - результат, %0, %1... - нетерминалы шаблона слева направо,
+	// %a и %r - делимое и остаток целевой архитектуры (см. CTargetDescription), %t - вспомогательная переменная.
+	// В имени команды %c - условие сравнения CJUMP, CMP или SELECT, %C - условие для переставленных операндов;
+	// команда перехода j%c получает метки CJUMP
+	const char* assem;
+	TPredicate predicate;
+};
+
+static constexpr CTileRule tileRules[] = {
+	{ N_Temp, "TEMP", 0, A_Temp, "", P_None },
+	{ N_Imm, "CONST", 0, A_Const, "", P_None },
+	{ N_Scale, "CONST", 0, A_Const, "", P_Scale },
+	{ N_Name, "NAME", 0, A_Name, "", P_None },
+
+	{ N_Reg, "temp", 0, A_Same, "", P_None },
+	{ N_Reg, "imm", 1, A_Emit, "mov %d, %0", P_None },
+	{ N_Reg, "name", 1, A_Emit, "mov %d, %0", P_None },
+	{ N_Reg, "mem", 1, A_Emit, "mov %d, %0", P_None },
+	{ N_Reg, "addr", 1, A_Emit, "lea %d, %0", P_None },
+	{ N_Src, "reg", 0, A_Same, "", P_None },
+	{ N_Src, "imm", 0, A_Same, "", P_None },
+	{ N_Src, "name", 0, A_Same, "", P_None },
+	{ N_Src, "mem", 0, A_Same, "", P_None },
+	{ N_Ri, "reg", 0, A_Same, "", P_None },
+	{ N_Ri, "imm", 0, A_Same, "", P_None },
+	{ N_Ri, "name", 0, A_Same, "", P_None },
+	{ N_Rm, "reg", 0, A_Same, "", P_None },
+	{ N_Rm, "mem", 0, A_Same, "", P_None },
+
+	{ N_Index, "MUL(reg,scale)", 0, A_Address, "", P_None },
+	{ N_Index, "MUL(scale,reg)", 0, A_Address, "", P_None },
+	{ N_Index, "MUL(PLUS(reg,imm),scale)", 0, A_Address, "", P_None },
+	{ N_Addr, "reg", 0, A_Address, "", P_None },
+	{ N_Addr, "index", 0, A_Address, "", P_None },
+	{ N_Addr, "imm", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(reg,imm)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(imm,reg)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(reg,reg)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(reg,index)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(index,reg)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(index,imm)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(PLUS(reg,index),imm)", 0, A_Address, "", P_None },
+	{ N_Addr, "PLUS(reg,PLUS(index,imm))", 0, A_Address, "", P_None },
+	{ N_Mem, "MEM(addr)", 1, A_Same, "", P_None },
+
+	{ N_Reg, "PLUS(src,src)", 2, A_Emit, "mov %d, %0; add %d, %1", P_None },
+	{ N_Reg, "MINUS(src,src)", 2, A_Emit, "mov %d, %0; sub %d, %1", P_None },
+	{ N_Reg, "MUL(reg,CONST)", 0, A_Constant, "", P_None },
+	{ N_Reg, "MUL(CONST,reg)", 0, A_Constant, "", P_None },
+	{ N_Reg, "DIV(reg,CONST)", 0, A_Constant, "", P_None },
+	{ N_Reg, "MUL(src,src)", 3, A_Emit, "mov %d, %0; imul %d, %1", P_None },
+	{ N_Reg, "DIV(src,rm)", 20, A_Emit, "mov %a, %0; cdq; idiv %1; mov %d, %a", P_None },
+	{ N_Reg, "AND(src,src)", 2, A_Emit, "mov %d, %0; and %d, %1", P_None },
+	{ N_Reg, "OR(src,src)", 2, A_Emit, "mov %d, %0; or %d, %1", P_None },
+	{ N_Reg, "SHL(src,imm)", 2, A_Emit, "mov %d, %0; shl %d, %1", P_None },
+	{ N_Reg, "SHR(src,imm)", 2, A_Emit, "mov %d, %0; shr %d, %1", P_None },
+	{ N_Reg, "SAR(src,imm)", 2, A_Emit, "mov %d, %0; sar %d, %1", P_None },
+	{ N_Reg, "CMP(reg,CONST)", 3, A_Emit, "test %0, %0; set%c %t; movzx %d, %t", P_ZeroRight },
+	{ N_Reg, "CMP(reg,src)", 3, A_Emit, "cmp %0, %1; set%c %t; movzx %d, %t", P_None },
+	{ N_Reg, "CMP(mem,ri)", 3, A_Emit, "cmp %0, %1; set%c %t; movzx %d, %t", P_None },
+	{ N_Reg, "CMP(ri,mem)", 3, A_Emit, "cmp %1, %0; set%C %t; movzx %d, %t", P_None },
+	{ N_Reg, "CMP(imm,reg)", 3, A_Emit, "cmp %1, %0; set%C %t; movzx %d, %t", P_None },
+	{ N_Reg, "SELECT(reg,CONST,rm,src)", 3, A_Emit, "mov %d, %2; test %0, %0; cmov%c %d, %1", P_ZeroRight },
+	{ N_Reg, "SELECT(reg,src,rm,src)", 3, A_Emit, "mov %d, %3; cmp %0, %1; cmov%c %d, %2", P_None },
+	{ N_Reg, "CALL", 2, A_Call, "", P_None },
+
+	{ N_Stm, "MOVE(temp,src)", 1, A_Emit, "mov %0, %1", P_None },
+	{ N_Stm, "MOVE(temp,addr)", 1, A_Emit, "lea %0, %1", P_None },
+	{ N_Stm, "MOVE(temp,PLUS(src,src))", 2, A_Emit, "mov %0, %1; add %0, %2", P_DstNotInRight },
+	{ N_Stm, "MOVE(temp,MINUS(src,src))", 2, A_Emit, "mov %0, %1; sub %0, %2", P_DstNotInRight },
+	{ N_Stm, "MOVE(temp,MUL(src,src))", 3, A_Emit, "mov %0, %1; imul %0, %2", P_DstNotInRight },
+	{ N_Stm, "MOVE(temp,AND(src,src))", 2, A_Emit, "mov %0, %1; and %0, %2", P_DstNotInRight },
+	{ N_Stm, "MOVE(temp,OR(src,src))", 2, A_Emit, "mov %0, %1; or %0, %2", P_DstNotInRight },
+	{ N_Stm, "MOVE(temp,CMP(reg,src))", 3, A_Emit, "cmp %1, %2; set%c %t; movzx %0, %t", P_None },
+	{ N_Stm, "MOVE(temp,SELECT(reg,src,rm,temp))", 2, A_Emit, "cmp %1, %2; cmov%c %0, %3", P_ElseIsDst },
+	{ N_Stm, "MOVE(temp,SELECT(reg,src,rm,src))", 3, A_Emit, "mov %0, %4; cmp %1, %2; cmov%c %0, %3",
+		P_DstNotInSelect },
+	{ N_Stm, "MOVE(MEM(addr),ri)", 2, A_Emit, "mov %0, %1", P_None },
+	{ N_Stm, "MOVE(MEM(addr),PLUS(MEM(addr),ri))", 3, A_ReadModifyWrite, "add %0, %2", P_SameMemoryLeft },
+	{ N_Stm, "MOVE(MEM(addr),PLUS(ri,MEM(addr)))", 3, A_ReadModifyWrite, "add %0, %1", P_SameMemoryRight },
+	{ N_Stm, "MOVE(MEM(addr),MINUS(MEM(addr),ri))", 3, A_ReadModifyWrite, "sub %0, %2", P_SameMemoryLeft },
+	{ N_Stm, "MOVE(MEM(addr),AND(MEM(addr),ri))", 3, A_ReadModifyWrite, "and %0, %2", P_SameMemoryLeft },
+	{ N_Stm, "MOVE(MEM(addr),OR(MEM(addr),ri))", 3, A_ReadModifyWrite, "or %0, %2", P_SameMemoryLeft },
+	{ N_Stm, "EXP(reg)", 0, A_Same, "", P_None },
+	{ N_Stm, "MOVE(temp,CALL)", 1, A_TailCall, "", P_TailCall },
+	{ N_Stm, "JUMP", 1, A_Jump, "", P_None },
+	{ N_Stm, "CJUMP(reg,CONST)", 2, A_Emit, "test %0, %0; j%c", P_ZeroRight },
+	{ N_Stm, "CJUMP(reg,src)", 2, A_Emit, "cmp %0, %1; j%c", P_None },
+	{ N_Stm, "CJUMP(mem,ri)", 2, A_Emit, "cmp %0, %1; j%c", P_None },
+	{ N_Stm, "CJUMP(ri,mem)", 2, A_Emit, "cmp %1, %0; j%C", P_None },
+	{ N_Stm, "CJUMP(imm,reg)", 2, A_Emit, "cmp %1, %0; j%C", P_None },
+	{ N_Stm, "LABEL", 0, A_Label, "", P_None },
+	{ N_Stm, "SEQ(stm,stm)", 0, A_Emit, "", P_None },
+};
+
+static const int rulesCount = sizeof(tileRules) / sizeof(tileRules[0]);
+
+// Машинный регистр по имени или роли из шаблона
+static TTemp machineRegister(const string& name) {
+	if (name == "%a") {
+		return CFrame::allRegisters[CFrame::Target().accumulator];
+	}
+	if (name == "%r") {
+		return CFrame::allRegisters[CFrame::Target().remainder];
+	}
+	assert(CFrame::allRegisters.count(name) != 0);
+	return CFrame::allRegisters[name];
+}
+
+// Какие регистры читает и пишет команда: первый операнд-регистр может быть результатом, остальные только читаются
+struct CMnemonic {
+	const char* name;
+	TOpcode opcode;
+	bool firstDefined;
+	bool firstUsed;
+	// Неявные операнды через пробел, в обозначениях шаблонов
+	const char* implicitDefs;
+	const char* implicitUses;
+};
+
+static constexpr CMnemonic mnemonics[] = {
+	{ "mov", OP_Mov, true, false, "", "" },
+	{ "lea", OP_Lea, true, false, "", "" },
+	{ "add", OP_Add, true, true, "", "" },
+	{ "sub", OP_Sub, true, true, "", "" },
+	{ "imul", OP_Imul, true, true, "", "" },
+	// Однооперандная форма imul: старшая половина произведения на %a - в %r
+	{ "imul1", OP_Imul, false, true, "%a %r", "%a" },
+	{ "and", OP_And, true, true, "", "" },
+	{ "or", OP_Or, true, true, "", "" },
+	{ "xor", OP_Xor, true, true, "", "" },
+	{ "shl", OP_Shl, true, true, "", "" },
+	{ "shr", OP_Shr, true, true, "", "" },
+	{ "sar", OP_Sar, true, true, "", "" },
+	{ "cmp", OP_Cmp, false, true, "", "" },
+	{ "test", OP_Test, false, true, "", "" },
+	// setcc пишет младший байт, movzx расширяет его до слова
+	{ "set", OP_Set, true, false, "", "" },
+	{ "movzx", OP_Movzx, true, false, "", "" },
+	// cmovcc при ложном условии оставляет прежнее значение
+	{ "cmov", OP_Cmov, true, true, "", "" },
+	{ "push", OP_Push, false, true, "", "" },
+	// cdq или cqo - по CTargetDescription::signExtension
+	{ "cdq", OP_Cdq, false, false, "%r", "%a" },
+	{ "idiv", OP_Idiv, false, true, "%a %r", "%a %r" },
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Patterns
+//----------------------------------------------------------------------------------------------------------------------
+
+struct CPatternNode {
+	bool nonterminal;
+	int symbol;
+	vector<CPatternNode> kids;
+};
+
+static int lookup(const char* const* names, int count, const string& name) {
+	for (int i = 0; i < count; i++) {
+		if (name == names[i]) {
+			return i;
 		}
 	}
+	return -1;
 }
 
-void CCodegen::MunchExpCall(CALL* call) {
-	NAME* name = dynamic_cast<NAME*>(call->func);
-	if (name != 0) {
-		CTempList* l = MunchArgs(call->args);
-		emit(new AOPER("CALL " + name->label->Name() + "\n", CFrame::PreColoredRegisters(), l)); 
-	} else {
-		shared_ptr<const CTemp> r = MunchExp(call->func);
-		CTempList* l = MunchArgs(call->args);
-		emit(new AOPER("CALL `s0\n", CFrame::PreColoredRegisters(), new CTempList(r, l))); 
+static CPatternNode parsePattern(const char*& p) {
+	string name;
+	while (isalpha(*p)) {
+		name += *p++;
+	}
+	CPatternNode node;
+	node.nonterminal = islower(name[0]);
+	node.symbol = node.nonterminal ? lookup(nonterminalNames, N_Count, name) : lookup(operatorNames, O_Count, name);
+	assert(node.symbol != -1);
+	if (*p == '(') {
+		do {
+			p++;
+			node.kids.push_back(parsePattern(p));
+		} while (*p == ',');
+		assert(*p == ')');
+		p++;
 	}
+	return node;
 }
 
-CTempList* CCodegen::MunchArgs(shared_ptr<ExpList> args) {
-	CTempList* l = nullptr;
-	while(args != 0) {
-		if (l != nullptr) {
-			l->tail = new CTempList(std::make_shared<CTemp>(), nullptr);
-			l = l->tail;
-		} else {
-			l = new CTempList(std::make_shared<CTemp>(), nullptr);
+// Шаблоны разбираются один раз при первом обращении
+static const vector<CPatternNode>& patterns() {
+	static vector<CPatternNode> parsed;
+	if (parsed.empty()) {
+		for (int r = 0; r < rulesCount; r++) {
+			const char* p = tileRules[r].pattern;
+			parsed.push_back(parsePattern(p));
+			assert(*p == '\0');
 		}
-		emit(new AOPER("push `s0\n", nullptr, new CTempList(MunchExp(args->head), nullptr)
-						)
-			);
-		args = args->tail;
 	}
+	return parsed;
 }
 
-
-/*munchStm(EXP(CALL(e,args)))
-{Temp r = munchExp(e); TempList l = munchArgs(0,args);
-emit(new OPER("CALL 's0\n",calldefs,L(r,l)));}*/
-
-void CCodegen::MunchMove(IExp* dst, IExp* src) {
-	MEM* mem = dynamic_cast<MEM*>(dst);
-	if (mem != 0) {
-		MunchMove(mem, src);
-	} else {
-		TEMP* temp = dynamic_cast<TEMP*>(dst);
-		if (temp != 0)  {
-			//MOVE(TEMP(i), e2)
-			MunchMove(temp, src);
-		}
+static int operatorOf(INode* node) {
+	if (dynamic_cast<MOVE*>(node) != 0) return O_Move;
+	if (dynamic_cast<EXP*>(node) != 0) return O_Exp;
+	if (dynamic_cast<JUMP*>(node) != 0) return O_Jump;
+	if (dynamic_cast<CJUMP*>(node) != 0) return O_CJump;
+	if (dynamic_cast<LABEL*>(node) != 0) return O_Label;
+	if (dynamic_cast<SEQ*>(node) != 0) return O_Seq;
+	if (dynamic_cast<MEM*>(node) != 0) return O_Mem;
+	if (dynamic_cast<CONST*>(node) != 0) return O_Const;
+	if (dynamic_cast<TEMP*>(node) != 0) return O_Temp;
+	if (dynamic_cast<NAME*>(node) != 0) return O_Name;
+	if (dynamic_cast<CALL*>(node) != 0) return O_Call;
+	if (dynamic_cast<CMP*>(node) != 0) return O_Cmp;
+	if (dynamic_cast<SELECT*>(node) != 0) return O_Select;
+	BINOP* binop = dynamic_cast<BINOP*>(node);
+	if (binop == 0) {
+		return -1;
+	}
+	switch (binop->binop) {
+		case PLUS_OP: return O_Plus;
+		case MINUS_OP: return O_Minus;
+		case MULT_OP: return O_Mul;
+		case DIV_OP: return O_Div;
+		case AND_OP: return O_And;
+		case OR_OP: return O_Or;
+		case LSHIFT_OP: return O_Shl;
+		case RSHIFT_OP: return O_Shr;
+		case ARSHIFT_OP: return O_Sar;
 	}
+	return -1;
 }
 
-void CCodegen::MunchMove(MEM* dst, IExp* src) {
-	
-	BINOP* binop = dynamic_cast<BINOP*>(dst->exp);
-	if (binop != 0) {
-
-		CONST* cst = dynamic_cast<CONST*>(binop->right);
-		if (cst != 0) {
-			//MOVE(MEM(BINOP(PLUS,e1,CONST(i))),e2)
-
-			emit(new AOPER("mov [`s0 " + CCodegen::opSymbols[binop->binop] + std::to_string(cst->value) + "],	`s1\n", 
-				nullptr, new CTempList( MunchExp(binop->left), 
-										new CTempList(MunchExp(src), nullptr)
-										)
-							)
-				);
-			return;
-		} 
-
-		cst = dynamic_cast<CONST*>(binop->left);
-		if (cst != 0) {
-			//MOVE(MEM(BINOP(PLUS,CONST(i),e1)),e2)
-			emit(new AOPER("mov [`s0 " + CCodegen::opSymbols[binop->binop] + std::to_string(cst->value) + "],	`s1\n", 
-			nullptr, new CTempList( MunchExp(binop->right), 
-									new CTempList(MunchExp(src), nullptr)
-									)
-						)
-			);
-			return;
+// Потомки в порядке вычисления; приёмник MOVE - первый потомок
+static vector<INode*> childrenOf(INode* node) {
+	vector<INode*> kids;
+	if (MOVE* move = dynamic_cast<MOVE*>(node)) {
+		kids.push_back(move->dst);
+		kids.push_back(move->src);
+	} else if (EXP* exp = dynamic_cast<EXP*>(node)) {
+		kids.push_back(exp->exp);
+	} else if (CJUMP* cjump = dynamic_cast<CJUMP*>(node)) {
+		kids.push_back(cjump->left);
+		kids.push_back(cjump->right);
+	} else if (SEQ* seq = dynamic_cast<SEQ*>(node)) {
+		kids.push_back(seq->left);
+		kids.push_back(seq->right);
+	} else if (MEM* mem = dynamic_cast<MEM*>(node)) {
+		kids.push_back(mem->exp);
+	} else if (BINOP* binop = dynamic_cast<BINOP*>(node)) {
+		kids.push_back(binop->left);
+		kids.push_back(binop->right);
+	} else if (CMP* cmp = dynamic_cast<CMP*>(node)) {
+		kids.push_back(cmp->left);
+		kids.push_back(cmp->right);
+	} else if (SELECT* select = dynamic_cast<SELECT*>(node)) {
+		kids.push_back(select->left);
+		kids.push_back(select->right);
+		kids.push_back(select->iftrue);
+		kids.push_back(select->iffalse);
+	} else if (CALL* call = dynamic_cast<CALL*>(node)) {
+		kids.push_back(call->func);
+		for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get()) {
+			kids.push_back(arg->head);
 		}
-
-	
 	}
+	return kids;
+}
 
-	//???
-	MEM* mem = dynamic_cast<MEM*>(src);
-	if (mem != 0) {
-		emit(new AMOVE("mov `d0, `s0\n", MunchExp(dst->exp), MunchExp(mem->exp)
-					  )
-			);
+// Листья шаблона (узел и нетерминал) слева направо
+static void collectLeaves(const CPatternNode& pattern, INode* node, vector<pair<INode*, int>>& leaves) {
+	if (pattern.nonterminal) {
+		leaves.push_back(make_pair(node, pattern.symbol));
 		return;
 	}
-	CONST* cst = dynamic_cast<CONST*>(dst->exp);
-	if (cst != 0) {
-		emit(new AOPER("mov [" + std::to_string(cst->value) + "], `s0\n", nullptr, 
-						new CTempList( MunchExp(src), nullptr)));
-		return;
+	vector<INode*> kids = childrenOf(node);
+	for (int i = 0; i < pattern.kids.size(); i++) {
+		collectLeaves(pattern.kids[i], kids[i], leaves);
 	}
+}
 
-	emit(new AMOVE("mov `d0, `s0\n", MunchExp(dst->exp), MunchExp(src) 
-				  )
-		);
+static bool sameTree(IExp* a, IExp* b) {
+	if (operatorOf(a) != operatorOf(b)) {
+		return false;
+	}
+	if (TEMP* temp = dynamic_cast<TEMP*>(a)) {
+		return temp->temp == static_cast<TEMP*>(b)->temp;
+	}
+	if (CONST* constant = dynamic_cast<CONST*>(a)) {
+		return constant->value == static_cast<CONST*>(b)->value;
+	}
+	if (CMP* cmp = dynamic_cast<CMP*>(a)) {
+		if (cmp->relop != static_cast<CMP*>(b)->relop) {
+			return false;
+		}
+	}
+	if (SELECT* select = dynamic_cast<SELECT*>(a)) {
+		if (select->relop != static_cast<SELECT*>(b)->relop) {
+			return false;
+		}
+	}
+	if (NAME* name = dynamic_cast<NAME*>(a)) {
+		return name->label->Name() == static_cast<NAME*>(b)->label->Name();
+	}
+	if (dynamic_cast<CALL*>(a) != 0) {
+		return false;
+	}
+	vector<INode*> left = childrenOf(a);
+	vector<INode*> right = childrenOf(b);
+	for (int i = 0; i < left.size(); i++) {
+		if (!sameTree(static_cast<IExp*>(left[i]), static_cast<IExp*>(right[i]))) {
+			return false;
+		}
+	}
+	return true;
+}
 
+static bool containsTemp(INode* node, const TTemp& temp) {
+	TEMP* t = dynamic_cast<TEMP*>(node);
+	if (t != 0 && t->temp == temp) {
+		return true;
+	}
+	vector<INode*> kids = childrenOf(node);
+	for (int i = 0; i < kids.size(); i++) {
+		if (containsTemp(kids[i], temp)) {
+			return true;
+		}
+	}
+	return false;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+// Constant multiplication and division
+//----------------------------------------------------------------------------------------------------------------------
 
-void CCodegen::MunchMove(TEMP* dst, IExp* src) {
-	//MOVE(TEMP(i), e2)
-	//???
-	emit(new AOPER("mov 	`d0, `s0\n", new CTempList(dst->temp, nullptr), 
-		new CTempList(MunchExp(src), nullptr)));
+// Шаблон команд умножения или деления на константу для правила rule. Операнд %0 - второй множитель или делимое,
+// следующие - добавленные здесь адреса и непосредственные значения. Пустая строка, если умножение не укладывается
+// в две команды lea и shl или делитель не подходит
+string CCodegen::constantSequence(int rule, INode* node, const COperand& result, vector<COperand>& operands) {
+	BINOP* binop = static_cast<BINOP*>(node);
+	int constant = static_cast<CONST*>(patterns()[rule].kids[0].nonterminal ? binop->right : binop->left)->value;
+	const COperand x = operands[0];
+	auto immediate = [&](int value) {
+		COperand operand;
+		operand.kind = COperand::K_Imm;
+		operand.value = value;
+		operands.push_back(operand);
+		return "%" + to_string(operands.size() - 1);
+	};
+	string assem;
+	if (binop->binop == MULT_OP) {
+		vector<int> leaFactors;
+		int shift;
+		if (!DecomposeMultiplier(constant, leaFactors, shift)) {
+			return "";
+		}
+		for (int i = 0; i < leaFactors.size(); i++) {
+			COperand address;
+			address.kind = COperand::K_Memory;
+			address.index = (i == 0) ? x.reg : result.reg;
+			address.scale = leaFactors[i];
+			if (leaFactors[i] % 2 != 0 || leaFactors[i] == 2) {
+				address.reg = address.index;
+				address.scale = leaFactors[i] - 1;
+			}
+			operands.push_back(address);
+			assem += "lea %d, %" + to_string(operands.size() - 1) + "; ";
+		}
+		if (shift != 0) {
+			assem += (leaFactors.empty() ? "mov %d, %0; shl %d, " : "shl %d, ") + immediate(shift) + "; ";
+		}
+		return assem.substr(0, assem.size() - 2);
+	}
+	assert(binop->binop == DIV_OP);
+	if (constant < 2) {
+		return "";
+	}
+	const int bits = CFrame::wordSize * 8;
+	if ((constant & (constant - 1)) == 0) {
+		// Отрицательное делимое увеличивается на d - 1, чтобы сдвиг округлял к нулю
+		int k = 0;
+		while ((1 << k) != constant) {
+			k++;
+		}
+		assem = "mov %d, %0; ";
+		if (k > 1) {
+			assem += "sar %d, " + immediate(k - 1) + "; ";
+		}
+		return assem + "shr %d, " + immediate(bits - k) + "; add %d, %0; sar %d, " + immediate(k);
+	}
+	// Множитель x86-64 не помещается в 32-битный непосредственный операнд
+	if (bits != 32) {
+		return "";
+	}
+	uint32_t magic;
+	int shift;
+	SignedMagic<uint32_t>(constant, magic, shift);
+	assem = "mov %a, " + immediate(static_cast<int>(magic)) + "; imul %0; ";
+	if (static_cast<int>(magic) < 0) {
+		assem += "add %r, %0; ";
+	}
+	if (shift != 0) {
+		assem += "sar %r, " + immediate(shift) + "; ";
+	}
+	return assem + "mov %t, %0; shr %t, " + immediate(bits - 1) + "; add %r, %t; mov %d, %r";
 }
 
-void CCodegen::MunchStm(SEQ* s) {
-	MunchStm(s->left);
-	MunchStm(s->right);
+//----------------------------------------------------------------------------------------------------------------------
+// Labelling
+//----------------------------------------------------------------------------------------------------------------------
+
+CCodegen::CStatistics::CStatistics() : nodes(0), tiles(0), cost(0), instructions(0), memoryAccesses(0), reordered(0),
+	ruleUses(rulesCount, 0) {}
+
+CCodegen::CCodegen():  stream(0) {}
+
+int CCodegen::RulesCount() {
+	return rulesCount;
 }
 
+string CCodegen::RuleText(int rule) {
+	return string(nonterminalNames[tileRules[rule].result]) + ": " + tileRules[rule].pattern;
+}
 
-void CCodegen::MunchStm(LABEL* label) {
-	emit(new ALABEL(label->label->Name() + ":\n", label->label));
+void CCodegen::label(INode* node) {
+	if (states.count(node) != 0) {
+		return;
+	}
+	vector<INode*> kids = childrenOf(node);
+	for (int i = 0; i < kids.size(); i++) {
+		label(kids[i]);
+	}
+	vector<pair<int, int>> state(N_Count, make_pair(INT_MAX, -1));
+	int op = operatorOf(node);
+	for (int r = 0; r < rulesCount; r++) {
+		const CPatternNode& pattern = patterns()[r];
+		int cost = tileRules[r].cost;
+		if (pattern.nonterminal || pattern.symbol != op || !matchCost(r, node, cost) || !checkPredicate(r, node)) {
+			continue;
+		}
+		if (op == O_Call || tileRules[r].action == A_TailCall) {
+			int arguments = callCost(static_cast<CALL*>(op == O_Call ? node : static_cast<MOVE*>(node)->src));
+			if (arguments == INT_MAX) {
+				continue;
+			}
+			cost += arguments;
+		}
+		if (tileRules[r].action == A_Constant) {
+			vector<COperand> operands(1);
+			string assem = constantSequence(r, node, COperand(), operands);
+			if (assem.empty()) {
+				continue;
+			}
+			cost += count(assem.begin(), assem.end(), ';') + 1;
+		}
+		if (cost < state[tileRules[r].result].first) {
+			state[tileRules[r].result] = make_pair(cost, r);
+		}
+	}
+	// Цепные правила: стоимости положительны или нулевые без циклов, поэтому замыкание конечно
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int r = 0; r < rulesCount; r++) {
+			const CPatternNode& pattern = patterns()[r];
+			if (!pattern.nonterminal || state[pattern.symbol].first == INT_MAX) {
+				continue;
+			}
+			int cost = state[pattern.symbol].first + tileRules[r].cost;
+			if (cost < state[tileRules[r].result].first) {
+				state[tileRules[r].result] = make_pair(cost, r);
+				changed = true;
+			}
+		}
+	}
+	states[node] = state;
 }
 
-shared_ptr<const Temp::CTemp>  CCodegen::MunchExp(IExp* exp) {
-	MEM* mem = dynamic_cast<MEM*>(exp);
-	if ( mem != 0) {
-		BINOP* binop = dynamic_cast<BINOP*>(mem->exp);
-		 if (binop != 0) {
-			CONST* cst = dynamic_cast<CONST*>(binop->right);
-			if (cst != 0) {
-				//MEM(BINOP(PLUS,e1,CONST(i)))
-				shared_ptr<const CTemp> r = make_shared<const CTemp>();
-				emit(new AOPER("mov `d0, [`s0 " + CCodegen::opSymbols[binop->binop] + std::to_string(cst->value) + "]\n",
-								new CTempList(r, nullptr), new CTempList(MunchExp(binop->left), nullptr)
-								)
-					);
-				return r;
-			} 
-			cst = dynamic_cast<CONST*>(binop->left);
-			if (cst != 0 ) {
-				//MEM(BINOP(PLUS,CONST(i),e1))
-				shared_ptr<const CTemp> r = make_shared<const CTemp>();
-				emit(new AOPER("mov `d0, [`s0 " + CCodegen::opSymbols[binop->binop] + std::to_string(cst->value) + "]\n",
-								new CTempList(r, nullptr), new CTempList(MunchExp(binop->right), nullptr)
-								)
-					);
-				return r;
+bool CCodegen::matchCost(int rule, INode* node, int& cost) {
+	function<bool(const CPatternNode&, INode*)> match = [&](const CPatternNode& pattern, INode* n) {
+		if (pattern.nonterminal) {
+			int leafCost = states[n][pattern.symbol].first;
+			if (leafCost == INT_MAX) {
+				return false;
+			}
+			cost += leafCost;
+			return true;
+		}
+		if (operatorOf(n) != pattern.symbol) {
+			return false;
+		}
+		if (pattern.kids.empty()) {
+			return true;
+		}
+		vector<INode*> kids = childrenOf(n);
+		if (kids.size() != pattern.kids.size()) {
+			return false;
+		}
+		for (int i = 0; i < kids.size(); i++) {
+			if (!match(pattern.kids[i], kids[i])) {
+				return false;
 			}
 		}
-		CONST* cst = dynamic_cast<CONST*>(mem->exp);
-		if (cst != 0) {
-			//MEM(CONST(i))
-			shared_ptr<const CTemp> r = make_shared<const CTemp>();
-			emit(new AOPER("mov `d0, [" + std::to_string(cst->value) + "]\n", 
-					new CTempList(r, nullptr), nullptr));
-			return r; 
+		return true;
+	};
+	return match(patterns()[rule], node);
+}
+
+bool CCodegen::checkPredicate(int rule, INode* node) {
+	switch (tileRules[rule].predicate) {
+		case P_None:
+			return true;
+		case P_Scale: {
+			int value = static_cast<CONST*>(node)->value;
+			return value == 1 || value == 2 || value == 4 || value == 8;
+		}
+		case P_SameMemoryLeft:
+		case P_SameMemoryRight: {
+			MOVE* move = static_cast<MOVE*>(node);
+			BINOP* binop = static_cast<BINOP*>(move->src);
+			return sameTree(move->dst, (tileRules[rule].predicate == P_SameMemoryLeft) ? binop->left : binop->right);
+		}
+		case P_DstNotInRight: {
+			MOVE* move = static_cast<MOVE*>(node);
+			return !containsTemp(static_cast<BINOP*>(move->src)->right, static_cast<TEMP*>(move->dst)->temp);
+		}
+		case P_ZeroRight: {
+			vector<INode*> kids = childrenOf(node);
+			return static_cast<CONST*>(kids[1])->value == 0;
+		}
+		case P_ElseIsDst: {
+			MOVE* move = static_cast<MOVE*>(node);
+			TEMP* iffalse = static_cast<TEMP*>(static_cast<SELECT*>(move->src)->iffalse);
+			return static_cast<TEMP*>(move->dst)->temp == iffalse->temp;
+		}
+		case P_DstNotInSelect: {
+			MOVE* move = static_cast<MOVE*>(node);
+			SELECT* select = static_cast<SELECT*>(move->src);
+			const TTemp& dst = static_cast<TEMP*>(move->dst)->temp;
+			return !containsTemp(select->left, dst) && !containsTemp(select->right, dst) && !containsTemp(select->iftrue, dst);
+		}
+		case P_TailCall: {
+			MOVE* move = static_cast<MOVE*>(node);
+			return static_cast<CALL*>(move->src)->tail && static_cast<TEMP*>(move->dst)->temp == CFrame::ReturnValue();
 		}
-		shared_ptr<const CTemp> r = make_shared<const CTemp>();
-		//MEM(e1)
-		//?????
-		emit(new AMOVE("mov `d0, `s0\n", r, MunchExp(mem->exp) 
-						)
-			);
-		return r;
 	}
+	return false;
+}
 
-	BINOP* binop = dynamic_cast<BINOP*>(exp);
-	if ( (binop != 0) ) {
-		return MunchBinop(binop->left, binop->right, binop->binop);
+// Каждый аргумент - одна команда (mov в регистр или push), косвенный вызов читает адрес из регистра или памяти
+int CCodegen::callCost(CALL* call) {
+	int cost = 0;
+	if (dynamic_cast<NAME*>(call->func) == 0) {
+		cost = states[call->func][N_Rm].first;
 	}
-	CONST* cst = dynamic_cast<CONST*>(exp);
-	if (cst != 0) {
-		//CONST(i)
-		shared_ptr<const CTemp> r = make_shared<const CTemp>();
-		emit(new AOPER("mov `d0, " + std::to_string(cst->value) + "\n", new CTempList(r, nullptr), nullptr )
-			);
-		return r;
+	for (ExpList* arg = call->args.get(); arg != 0 && cost != INT_MAX; arg = arg->tail.get()) {
+		int argCost = states[arg->head][N_Src].first;
+		cost = (argCost == INT_MAX) ? INT_MAX : cost + argCost + 1;
 	}
-	TEMP* t = dynamic_cast<TEMP*>(exp);
-	if (t != 0) {
-		return t->temp;
+	return cost;
+}
+
+// Регистры для вычисления поддерева (числа Сетхи-Ульмана для n-арных узлов): потомки вычисляются в порядке убывания
+// потребности, и готовые значения занимают регистры, пока вычисляются следующие. Переменные и константы новых
+// регистров не требуют, ячейка памяти - один на адрес или прочитанное значение, вызов портит все регистры
+int CCodegen::registerNeed(INode* node) {
+	auto found = needs.find(node);
+	if (found != needs.end()) {
+		return found->second;
 	}
-	CALL* call = dynamic_cast<CALL*>(exp);
-	if (call != 0) {
-		MunchExpCall(call);
-		return CFrame::CallerSaveRegister();
+	int need = 0;
+	if (dynamic_cast<CALL*>(node) != 0) {
+		need = CFrame::AllocatableRegisters();
+	} else {
+		vector<int> kids;
+		vector<INode*> children = childrenOf(node);
+		for (int i = 0; i < children.size(); i++) {
+			kids.push_back(registerNeed(children[i]));
+		}
+		sort(kids.rbegin(), kids.rend());
+		need = kids.empty() ? 0 : 1;
+		for (int i = 0; i < kids.size() && kids[i] != 0; i++) {
+			need = max(need, kids[i] + i);
+		}
 	}
-	
+	needs[node] = need;
+	return need;
+}
 
+//----------------------------------------------------------------------------------------------------------------------
+// Reduction
+//----------------------------------------------------------------------------------------------------------------------
 
+CCodegen::COperand CCodegen::reduce(INode* node, int nonterminal) {
+	int rule = states[node][nonterminal].second;
+	if (rule == -1) {
+		throw new logic_error(string("No tile covers the tree as ") + nonterminalNames[nonterminal]);
+	}
+	const CTileRule& tile = tileRules[rule];
+	stats.tiles++;
+	stats.cost += tile.cost;
+	stats.ruleUses[rule]++;
 
+	COperand result;
+	switch (tile.action) {
+		case A_Temp:
+			result.kind = COperand::K_Reg;
+			result.reg = static_cast<TEMP*>(node)->temp;
+			return result;
+		case A_Const:
+			result.kind = COperand::K_Imm;
+			result.value = static_cast<CONST*>(node)->value;
+			return result;
+		case A_Name:
+			result.kind = COperand::K_Name;
+			result.name = static_cast<NAME*>(node)->label.get();
+			return result;
+		case A_Call:
+			return emitCall(static_cast<CALL*>(node), false);
+		case A_TailCall:
+			emitCall(static_cast<CALL*>(static_cast<MOVE*>(node)->src), true);
+			return result;
+		case A_Label: {
+			LABEL* label = static_cast<LABEL*>(node);
+			emit(CInstrStream::Label(label->label));
+			return result;
+		}
+		case A_Jump:
+			// За хвостовым вызовом управление не идёт, переход на выход после него не нужен
+			if (stream->Size() == 0 || !(*stream)[stream->Size() - 1].IsTailCall()) {
+				emit(CInstrStream::Jump(static_cast<JUMP*>(node)->target));
+			}
+			return result;
+		default:
+			break;
+	}
+
+	vector<pair<INode*, int>> leaves;
+	collectLeaves(patterns()[rule], node, leaves);
+	vector<int> nonterminals;
+	vector<int> order;
+	for (int i = 0; i < leaves.size(); i++) {
+		nonterminals.push_back(leaves[i].second);
+		order.push_back(i);
+	}
+	// Вызовы в канонических деревьях - только на верхнем уровне, поэтому поддеревья шаблона не влияют друг на друга,
+	// и первым вычисляется то, которому нужно больше регистров: его временные значения не пересекаются с готовыми
+	// значениями остальных
+	if (tile.action != A_ReadModifyWrite) {
+		stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return registerNeed(leaves[a].first) > registerNeed(leaves[b].first);
+		});
+		vector<int> emitting;
+		for (int k = 0; k < order.size(); k++) {
+			if (registerNeed(leaves[order[k]].first) != 0) {
+				emitting.push_back(order[k]);
+			}
+		}
+		stats.reordered += is_sorted(emitting.begin(), emitting.end()) ? 0 : 1;
+	}
+	vector<COperand> operands(leaves.size());
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		// Повторный адрес чтения-изменения-записи уже вычислен первым операндом
+		if (tile.action == A_ReadModifyWrite && i > 0 && leaves[i].second == N_Addr) {
+			operands[i] = operands[0];
+		} else {
+			operands[i] = reduce(leaves[i].first, leaves[i].second);
+		}
+	}
+
+	switch (tile.action) {
+		case A_Same:
+			return operands[0];
+		case A_Address:
+			return address(operands, nonterminals);
+		case A_Constant: {
+			result.kind = COperand::K_Reg;
+			result.reg = make_shared<const CTemp>();
+			string assem = constantSequence(rule, node, result, operands);
+			emitTemplate(assem, node, result, operands);
+			return result;
+		}
+		default:
+			if (string(tile.assem).find("%d") != string::npos) {
+				result.kind = COperand::K_Reg;
+				result.reg = make_shared<const CTemp>();
+			}
+			emitTemplate(tile.assem, node, result, operands);
+			return result;
+	}
 }
 
-shared_ptr<const Temp::CTemp> CCodegen::MunchBinop(
-	CONST* cst,
- 	IExp* exp, 
- 	ArithmeticOpType binop) 
-{
-	
-	shared_ptr<const CTemp> r = make_shared<const CTemp>();
-	emit(new AMOVE("move `d0, `s0\n", r, MunchExp(exp)
-					)
-		);
-	emit(new AOPER(CCodegen::opNames[binop] + " `d0, " + std::to_string(cst->value) + "\n", new CTempList(r, nullptr),
-						new CTempList(r, nullptr)
-					)
-		);
-	return r;
+// Регистр становится базой (или индексом, если база занята), константа - смещением;
+// множитель применяется ко всем слагаемым индексного выражения, кроме самого множителя
+CCodegen::COperand CCodegen::address(const vector<COperand>& operands, const vector<int>& nonterminals) {
+	COperand result;
+	result.kind = COperand::K_Memory;
+	int scale = 1;
+	for (int i = 0; i < operands.size(); i++) {
+		if (nonterminals[i] == N_Scale) {
+			scale = operands[i].value;
+		}
+	}
+	for (int i = 0; i < operands.size(); i++) {
+		const COperand& operand = operands[i];
+		switch (operand.kind) {
+			case COperand::K_Reg:
+				if (scale != 1 || result.reg != nullptr) {
+					assert(result.index == nullptr);
+					result.index = operand.reg;
+					result.scale = scale;
+				} else {
+					result.reg = operand.reg;
+				}
+				break;
+			case COperand::K_Imm:
+				if (nonterminals[i] != N_Scale) {
+					result.value += operand.value * scale;
+				}
+				break;
+			case COperand::K_Memory:
+				if (operand.reg != nullptr) {
+					assert(result.reg == nullptr);
+					result.reg = operand.reg;
+				}
+				if (operand.index != nullptr) {
+					assert(result.index == nullptr);
+					result.index = operand.index;
+					result.scale = operand.scale;
+				}
+				result.value += operand.value;
+				break;
+			default:
+				assert(false);
+		}
+	}
+	return result;
 }
 
-shared_ptr<const Temp::CTemp> CCodegen::MunchBinop(
-	IRTree::IExp* src, IRTree::IExp* exp, 
-	ArithmeticOpType binop) 
-{
-	CONST* cst = dynamic_cast<CONST*>(src);
-	if (cst != 0) {
-		return MunchBinop(cst, exp, binop);
-	} 
-	cst = dynamic_cast<CONST*>(exp);
-	if (cst != 0){
-		return MunchBinop(cst, src, binop);
-	}
-	//BINOP(PLUS,e1,e2)
-	shared_ptr<const CTemp> r = make_shared<const CTemp>();
-	emit(new AMOVE("mov `d0, `s0\n", r, MunchExp(src)
-					)
-		);
-	emit(new AOPER(CCodegen::opNames[binop] + " `d0, `s1\n", new CTempList(r, nullptr),
-						new CTempList(r, new CTempList( MunchExp(exp), nullptr ))
-					)
-		);
-	return r;
+// Все аргументы вычисляются до записи в регистры аргументов: иначе вычисление следующего аргумента
+// могло бы испортить регистр предыдущего. Хвостовой вызов - переход jmp без меток; адрес метода при нём
+// в регистре, потому что кадр, из которого его можно было бы прочитать, эпилог к этому моменту уже снял
+CCodegen::COperand CCodegen::emitCall(CALL* call, bool tail) {
+	vector<TTemp> dst;
+	vector<TTemp> src;
+	NAME* name = dynamic_cast<NAME*>(call->func);
+	COperand func;
+	if (name == 0) {
+		func = reduce(call->func, tail ? N_Reg : N_Rm);
+	}
+	vector<COperand> args;
+	for (ExpList* arg = call->args.get(); arg != 0; arg = arg->tail.get()) {
+		args.push_back(reduce(arg->head, N_Src));
+	}
+	// Аргументы, не поместившиеся в регистры, кладутся в стек начиная с последнего
+	int stackArgs = 0;
+	for (int k = args.size() - 1; k >= 0; k--) {
+		if (CFrame::ArgumentRegister(k) == nullptr) {
+			emitOperation("push", vector<COperand>(1, args[k]));
+			stackArgs++;
+		}
+	}
+	for (int k = 0; k < args.size() && CFrame::ArgumentRegister(k) != nullptr; k++) {
+		COperand reg;
+		reg.kind = COperand::K_Reg;
+		reg.reg = CFrame::ArgumentRegister(k);
+		vector<COperand> operands = { reg, args[k] };
+		emitOperation("mov", operands);
+		src.push_back(reg.reg);
+	}
+	CInstrOperand target = (name != 0) ? CInstrOperand::Name(name->label.get())
+		: instrOperand(func, true, false, dst, src);
+	if (tail) {
+		assert(stackArgs == 0);
+		emit(stream->Instr(OP_Jmp, { target }, {}, src));
+		return COperand();
+	}
+	emit(stream->Instr(OP_Call, { target }, CFrame::CallDefs(), src));
+	if (stackArgs != 0) {
+		TTemp sp = CFrame::allRegisters[CFrame::Target().stackPointer];
+		emit(stream->Instr(OP_Add, { CInstrOperand::Def(0), CInstrOperand::Imm(stackArgs * CFrame::wordSize) },
+			{ sp }, { sp }));
+	}
+
+	COperand result;
+	result.kind = COperand::K_Reg;
+	result.reg = CFrame::ReturnValue();
+	return result;
 }
 
-CInstrList* CCodegen::Codegen(IStm* s) {
-	CInstrList* l;
-	MunchStm(s);
-	l = instrList;
-	last = 0;
-	instrList = last;
-	return l;
+// Условие сравнения узла CJUMP, CMP, SELECT или присваивания MOVE(temp, CMP или SELECT)
+static CJUMP_OP relopOf(INode* node) {
+	if (MOVE* move = dynamic_cast<MOVE*>(node)) {
+		node = move->src;
+	}
+	if (CJUMP* cjump = dynamic_cast<CJUMP*>(node)) {
+		return cjump->relop;
+	}
+	if (CMP* cmp = dynamic_cast<CMP*>(node)) {
+		return cmp->relop;
+	}
+	SELECT* select = dynamic_cast<SELECT*>(node);
+	assert(select != 0);
+	return select->relop;
 }
 
-void CCodegen::emit(CInstr* instr) {
-	if (last != nullptr) {
-		last->tail = new CInstrList(instr, 0);
-		last = last->tail;
-	} else {
-		instrList = new CInstrList(instr, 0);
-		last = instrList;
+void CCodegen::emitTemplate(const string& assem, INode* node, const COperand& result,
+	const vector<COperand>& operands) {
+	COperand scratch;
+	size_t start = 0;
+	while (start < assem.size()) {
+		size_t end = assem.find(';', start);
+		string line = assem.substr(start, (end == string::npos) ? string::npos : end - start);
+		start = (end == string::npos) ? assem.size() : end + 1;
+
+		line = line.substr(line.find_first_not_of(' '));
+		size_t space = line.find(' ');
+		string mnemonic = line.substr(0, space);
+		// Условия CJUMP_OP и TCondition перечислены в одном порядке
+		TCondition condition = C_E;
+		size_t suffix = mnemonic.find('%');
+		if (suffix != string::npos) {
+			CJUMP_OP relop = relopOf(node);
+			relop = (mnemonic[suffix + 1] == 'C') ? CommuteRelop(relop) : relop;
+			condition = static_cast<TCondition>(relop);
+			mnemonic = mnemonic.substr(0, suffix);
+		}
+		if (mnemonic == "j") {
+			CJUMP* cjump = static_cast<CJUMP*>(node);
+			emit(CInstrStream::ConditionalJump(condition, cjump->iftrue, cjump->iffalse));
+			continue;
+		}
+		vector<COperand> instrOperands;
+		while (space != string::npos) {
+			size_t comma = line.find(',', space + 1);
+			string text = line.substr(space + 1, (comma == string::npos) ? string::npos : comma - space - 1);
+			text = text.substr(text.find_first_not_of(' '));
+			space = comma;
+
+			COperand operand;
+			if (text == "%d") {
+				operand = result;
+			} else if (text == "%t") {
+				if (scratch.kind == COperand::K_None) {
+					scratch.kind = COperand::K_Reg;
+					scratch.reg = make_shared<const CTemp>();
+				}
+				operand = scratch;
+			} else if (isdigit(text[1])) {
+				operand = operands[atoi(text.c_str() + 1)];
+			} else {
+				operand.kind = COperand::K_Reg;
+				operand.reg = machineRegister(text);
+			}
+			instrOperands.push_back(operand);
+		}
+		emitOperation(mnemonic, instrOperands, condition);
 	}
 }
 
+void CCodegen::emitOperation(const string& mnemonic, const vector<COperand>& operands, TCondition condition) {
+	const CMnemonic* effects = 0;
+	string name = mnemonic;
+	if (mnemonic == "imul" && operands.size() == 1) {
+		name = "imul1";
+	}
+	for (int i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); i++) {
+		if (name == mnemonics[i].name) {
+			effects = &mnemonics[i];
+		}
+	}
+	assert(effects != 0);
+
+	// Пересылки регистр-регистр (и lea без индекса и смещения) видны распределению регистров как MOVE
+	if (operands.size() == 2 && operands[0].kind == COperand::K_Reg) {
+		const COperand& source = operands[1];
+		if (effects->opcode == OP_Mov && source.kind == COperand::K_Reg) {
+			emit(stream->Move(operands[0].reg, source.reg));
+			return;
+		}
+		if (effects->opcode == OP_Lea && source.kind == COperand::K_Memory && source.reg != nullptr
+			&& source.index == nullptr && source.value == 0) {
+			emit(stream->Move(operands[0].reg, source.reg));
+			return;
+		}
+	}
+
+	// Размер ячейки памяти не следует из других операндов
+	bool sized = true;
+	for (int i = 0; i < operands.size(); i++) {
+		sized = sized && operands[i].kind != COperand::K_Reg;
+	}
+	vector<TTemp> dst;
+	vector<TTemp> src;
+	CInstr instr((effects->opcode == OP_Cdq) ? CFrame::Target().signExtension : effects->opcode);
+	instr.condition = condition;
+	for (int i = 0; i < operands.size(); i++) {
+		bool define = i == 0 && effects->firstDefined;
+		if (define && effects->firstUsed && operands[i].kind == COperand::K_Reg) {
+			src.push_back(operands[i].reg);
+		}
+		instr.AddOperand(instrOperand(operands[i], sized, define, dst, src));
+	}
+	for (int pass = 0; pass < 2; pass++) {
+		string implicit = (pass == 0) ? effects->implicitDefs : effects->implicitUses;
+		size_t start = 0;
+		while (start < implicit.size()) {
+			size_t end = implicit.find(' ', start);
+			string name = implicit.substr(start, (end == string::npos) ? string::npos : end - start);
+			((pass == 0) ? dst : src).push_back(machineRegister(name));
+			start = (end == string::npos) ? implicit.size() : end + 1;
+		}
+	}
+	for (int i = 0; i < dst.size(); i++) {
+		instr.defs.Add(stream->Intern(dst[i]));
+	}
+	for (int i = 0; i < src.size(); i++) {
+		instr.uses.Add(stream->Intern(src[i]));
+	}
+	emit(instr);
+}
 
-std::vector<std::string> CCodegen::initOpNames() {
-	std::vector<std::string> names;
-	names.push_back("add");
-	names.push_back("sub");
-	names.push_back("mul");
-	names.push_back("div");
-	return names;
+CInstrOperand CCodegen::instrOperand(const COperand& operand, bool sized, bool define, vector<TTemp>& dst,
+	vector<TTemp>& src) {
+	switch (operand.kind) {
+		case COperand::K_Reg:
+			if (define) {
+				dst.push_back(operand.reg);
+				return CInstrOperand::Def(dst.size() - 1);
+			}
+			src.push_back(operand.reg);
+			return CInstrOperand::Use(src.size() - 1);
+		case COperand::K_Imm:
+			return CInstrOperand::Imm(operand.value);
+		case COperand::K_Name:
+			return CInstrOperand::Name(operand.name);
+		case COperand::K_Memory: {
+			int base = -1;
+			int index = -1;
+			if (operand.reg != nullptr) {
+				src.push_back(operand.reg);
+				base = src.size() - 1;
+			}
+			if (operand.index != nullptr) {
+				src.push_back(operand.index);
+				index = src.size() - 1;
+			}
+			return CInstrOperand::Memory(base, index, operand.scale, operand.value, sized ? CFrame::wordSize : 0);
+		}
+		default:
+			assert(false);
+			return CInstrOperand();
+	}
 }
-std::vector<std::string> CCodegen::initOpSymbols() {
-	std::vector<std::string> names;
-	names.push_back("+");
-	names.push_back("-");
-	names.push_back("*");
-	names.push_back("/");
-	return names;
+
+//----------------------------------------------------------------------------------------------------------------------
+// Emission
+//----------------------------------------------------------------------------------------------------------------------
+
+void CCodegen::Codegen(IStm* s, CInstrStream& _stream) {
+	stream = &_stream;
+	states.clear();
+	needs.clear();
+	label(s);
+	stats.nodes += states.size();
+	reduce(s, N_Stm);
+	stream = 0;
 }
 
-std::vector<std::string> CCodegen::opNames = CCodegen::initOpNames();
-std::vector<std::string> CCodegen::opSymbols = CCodegen::initOpSymbols();
\ No newline at end of file
+void CCodegen::emit(const CInstr& instr) {
+	stats.instructions++;
+	if (instr.MemoryOperand() != -1 || instr.opcode == OP_Push) {
+		stats.memoryAccesses++;
+	}
+	stream->code.push_back(instr);
+}
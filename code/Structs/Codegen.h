@@ -6,46 +6,78 @@
 
 using namespace Assembler;
 
+// Выбор команд покрытием деревьев шаблонами (в духе BURG). Грамматика шаблонов x86 со стоимостями -
+// таблица tileRules в Codegen.cpp. Разметка снизу вверх находит для каждого узла и нетерминала покрытие
+// минимальной стоимости (с цепными правилами), свёртка сверху вниз выпускает команды выбранных шаблонов.
 class CCodegen {
 public:
+	// Качество выбора команд
+	struct CStatistics {
+		CStatistics();
 
+		// Узлы покрытых деревьев
+		int nodes;
+		// Применённые правила грамматики и их суммарная стоимость
+		int tiles;
+		int cost;
+		int instructions;
+		// Команды, читающие или пишущие память (включая push)
+		int memoryAccesses;
+		// Шаблоны, поддеревья которых вычислялись не слева направо
+		int reordered;
+		// Число применений каждого правила
+		vector<int> ruleUses;
+	};
 
 	CCodegen();
-	
 
-	void MunchStm(IRTree::IStm* s);
+	// Команды оператора дописываются в конец stream
+	void Codegen(IRTree::IStm* s, CInstrStream& stream);
 
-	void MunchStm(IRTree::SEQ* s);
+	const CStatistics& Statistics() const { return stats; }
+	static int RulesCount();
+	// Правило в виде "нетерминал: шаблон"
+	static string RuleText(int rule);
 
+private:
+	// Операнд команды: переменная, константа, метка или ячейка памяти [reg + index*scale + value]
+	struct COperand {
+		enum TKind { K_None, K_Reg, K_Imm, K_Name, K_Memory };
 
-	void MunchMove(IRTree::IExp* dst, IRTree::IExp* src);
-	void MunchMove(IRTree::MEM* dst, IRTree::IExp* src);
-	void MunchMove(IRTree::TEMP* dst, IRTree::IExp* src);
-	void MunchStm(IRTree::LABEL* label);
-	void MunchExpCall(IRTree::CALL* call);
-	CTempList* MunchArgs(shared_ptr<ExpList>);
+		COperand() : kind(K_None), scale(1), value(0), name(0) {}
 
-	shared_ptr<const Temp::CTemp>  MunchExp(IRTree::IExp* exp);
-	shared_ptr<const Temp::CTemp> MunchBinop(
-											IRTree::CONST* cst, 
-											IRTree::IExp* exp, 
-											ArithmeticOpType binop);
-	shared_ptr<const Temp::CTemp> MunchBinop(
-											IRTree::IExp* src, 
-											IRTree::IExp* exp, 
-											ArithmeticOpType binop);
+		TKind kind;
+		shared_ptr<const Temp::CTemp> reg;
+		shared_ptr<const Temp::CTemp> index;
+		int scale;
+		int value;
+		const Temp::CLabel* name;
+	};
 
-	CInstrList* Codegen(IRTree::IStm* s);
-private:
-	CInstrList* instrList;
-	CInstrList* last;
-	static std::vector<std::string> opNames;
-	static std::vector<std::string> opSymbols;
-	static std::vector<std::string> initOpNames();
-	static std::vector<std::string> initOpSymbols();
-	void emit(CInstr* instr);
-};
+	CInstrStream* stream;
+	// Для узла и нетерминала: минимальная стоимость покрытия и правило, на котором она достигается
+	map<IRTree::INode*, vector<pair<int, int>>> states;
+	// Число Сетхи-Ульмана узла
+	map<IRTree::INode*, int> needs;
+	CStatistics stats;
 
+	void label(IRTree::INode* node);
+	bool matchCost(int rule, IRTree::INode* node, int& cost);
+	bool checkPredicate(int rule, IRTree::INode* node);
+	int callCost(IRTree::CALL* call);
+	int registerNeed(IRTree::INode* node);
+	string constantSequence(int rule, IRTree::INode* node, const COperand& result, vector<COperand>& operands);
 
+	COperand reduce(IRTree::INode* node, int nonterminal);
+	COperand address(const vector<COperand>& operands, const vector<int>& nonterminals);
+	COperand emitCall(IRTree::CALL* call, bool tail);
+	void emitTemplate(const string& assem, IRTree::INode* node, const COperand& result,
+		const vector<COperand>& operands);
+	void emitOperation(const string& mnemonic, const vector<COperand>& operands, TCondition condition = C_E);
+	// Операнд команды; его переменные дописываются в dst или src
+	CInstrOperand instrOperand(const COperand& operand, bool sized, bool define,
+		vector<shared_ptr<const Temp::CTemp>>& dst, vector<shared_ptr<const Temp::CTemp>>& src);
+	void emit(const CInstr& instr);
+};
 
-#endif
\ No newline at end of file
+#endif
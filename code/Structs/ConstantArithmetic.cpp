@@ -0,0 +1,36 @@
+#include "../Structs/ConstantArithmetic.h"
+
+namespace CodeGenerator {
+	bool DecomposeMultiplier(int k, vector<int>& leaFactors, int& shift) {
+		if (k < 2) {
+			return false;
+		}
+		shift = 0;
+		while (k % 2 == 0) {
+			k /= 2;
+			shift++;
+		}
+		if (k == 1) {
+			if (shift <= 3) {
+				leaFactors.push_back(1 << shift);
+				shift = 0;
+			}
+			return true;
+		}
+		static const int factors[] = { 3, 5, 9 };
+		for (int a = 0; a < 3; a++) {
+			if (k == factors[a]) {
+				leaFactors.push_back(k);
+				return true;
+			}
+			for (int b = 0; b < 3 && shift == 0; b++) {
+				if (k == factors[a] * factors[b]) {
+					leaFactors.push_back(factors[a]);
+					leaFactors.push_back(factors[b]);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
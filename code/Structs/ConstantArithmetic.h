@@ -0,0 +1,46 @@
+#ifndef COMPILERS_CONSTANTARITHMETIC_H
+#define COMPILERS_CONSTANTARITHMETIC_H
+#include "../common.h"
+
+// Разложения констант для умножения и деления без imul и idiv (см. CCodegen::constantSequence).
+// Проверяются тестом code/Tests/ConstantArithmeticTest.cpp против x * k и x / d.
+namespace CodeGenerator {
+	// Множитель k как не более двух команд: k = a * b * 2^shift, где a и b - множители lea (2, 4, 8 - [x*a],
+	// 3, 5, 9 - [x + x*(a-1)]), а сдвиг - команда shl
+	bool DecomposeMultiplier(int k, vector<int>& leaFactors, int& shift);
+
+	// Множитель и сдвиг для деления со знаком на d >= 2 в W-битной арифметике (Уоррен, "Алгоритмические трюки
+	// для программистов", 10.3): q = (старшая половина M*n [+ n, если M < 0]) >> shift, плюс 1 при n < 0
+	template<typename U>
+	void SignedMagic(U d, U& magic, int& shift) {
+		const int bits = sizeof(U) * 8;
+		const U sign = U(1) << (bits - 1);
+		U anc = sign - 1 - sign % d;
+		U q1 = sign / anc;
+		U r1 = sign - q1 * anc;
+		U q2 = sign / d;
+		U r2 = sign - q2 * d;
+		int p = bits - 1;
+		U delta;
+		do {
+			p++;
+			q1 *= 2;
+			r1 *= 2;
+			if (r1 >= anc) {
+				q1++;
+				r1 -= anc;
+			}
+			q2 *= 2;
+			r2 *= 2;
+			if (r2 >= d) {
+				q2++;
+				r2 -= d;
+			}
+			delta = d - r2;
+		} while (q1 < delta || (q1 == delta && r1 == 0));
+		magic = q2 + 1;
+		shift = p - bits;
+	}
+}
+
+#endif //COMPILERS_CONSTANTARITHMETIC_H
@@ -0,0 +1,406 @@
+#include "../Structs/ControlFlowGraph.h"
+#include "../Structs/BasicBlocks.h"
+
+namespace Canon {
+	//--------------------------------------------------------------------------------------------------------------
+	// Construction
+	//--------------------------------------------------------------------------------------------------------------
+
+	static vector<const CLabel*> jumpTargets(IStm* jump) {
+		vector<const CLabel*> targets;
+		JUMP* j = dynamic_cast<JUMP*>(jump);
+		if (j != 0) {
+			targets.push_back(j->target);
+		}
+		CJUMP* cj = dynamic_cast<CJUMP*>(jump);
+		if (cj != 0) {
+			targets.push_back(cj->iftrue);
+			if (cj->iffalse != cj->iftrue) {
+				targets.push_back(cj->iffalse);
+			}
+		}
+		return targets;
+	}
+
+	CControlFlowGraph::CControlFlowGraph(shared_ptr<StmtList> stms) {
+		BasicBlocks basicBlocks(stms);
+		exit = basicBlocks.done;
+		for (StmtListList* l = basicBlocks.blocks; l != nullptr; l = l->tail) {
+			vector<IStm*> block;
+			l->head->toVector(block);
+			CBlock b;
+			b.label = static_cast<LABEL*>(block.front())->label;
+			b.stms.assign(block.begin() + 1, block.end() - 1);
+			b.jump = block.back();
+			blocks.push_back(b);
+		}
+
+		// Вход функции не должен быть целью перехода, иначе в нём негде разместить phi-функции
+		bool entryIsTarget = false;
+		for (int i = 0; i < blocks.size(); i++) {
+			vector<const CLabel*> targets = jumpTargets(blocks[i].jump);
+			entryIsTarget = entryIsTarget || find(targets.begin(), targets.end(), blocks[0].label) != targets.end();
+		}
+		if (entryIsTarget) {
+			CBlock entry;
+			entry.label = new CLabel();
+			entry.jump = new JUMP(blocks[0].label);
+			blocks.insert(blocks.begin(), entry);
+		}
+		indexLabels();
+		ComputeEdges();
+	}
+
+	void CControlFlowGraph::indexLabels() {
+		blockIds.clear();
+		for (int i = 0; i < blocks.size(); i++) {
+			blockIds[blocks[i].label] = i;
+		}
+	}
+
+	int CControlFlowGraph::BlockByLabel(const CLabel* label) const {
+		map<const CLabel*, int>::const_iterator it = blockIds.find(label);
+		return (it != blockIds.end()) ? it->second : -1;
+	}
+
+	int CControlFlowGraph::StatementsCount() const {
+		int count = 0;
+		for (int i = 0; i < blocks.size(); i++) {
+			count += blocks[i].stms.size() + 1;
+		}
+		return count;
+	}
+
+	void CControlFlowGraph::ComputeEdges() {
+		for (int i = 0; i < blocks.size(); i++) {
+			assert(blocks[i].phis.empty());
+			blocks[i].succs.clear();
+			blocks[i].preds.clear();
+		}
+		for (int i = 0; i < blocks.size(); i++) {
+			vector<const CLabel*> targets = jumpTargets(blocks[i].jump);
+			for (int t = 0; t < targets.size(); t++) {
+				int target = BlockByLabel(targets[t]);
+				if (target >= 0) {
+					blocks[i].succs.push_back(target);
+					blocks[target].preds.push_back(i);
+				}
+			}
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Editing
+	//--------------------------------------------------------------------------------------------------------------
+
+	int CControlFlowGraph::RemoveUnreachable() {
+		vector<bool> reachable(blocks.size(), false);
+		vector<int> order = ReversePostorder();
+		for (int i = 0; i < order.size(); i++) {
+			reachable[order[i]] = true;
+		}
+		if (order.size() == blocks.size()) {
+			return 0;
+		}
+
+		// Убираем рёбра из недостижимых блоков вместе с соответствующими аргументами phi
+		for (int b = 0; b < blocks.size(); b++) {
+			if (!reachable[b]) {
+				continue;
+			}
+			CBlock& block = blocks[b];
+			for (int j = block.preds.size() - 1; j >= 0; j--) {
+				if (!reachable[block.preds[j]]) {
+					block.preds.erase(block.preds.begin() + j);
+					for (int p = 0; p < block.phis.size(); p++) {
+						block.phis[p].args.erase(block.phis[p].args.begin() + j);
+					}
+				}
+			}
+		}
+
+		vector<int> newIds(blocks.size(), -1);
+		vector<CBlock> kept;
+		for (int b = 0; b < blocks.size(); b++) {
+			if (reachable[b]) {
+				newIds[b] = kept.size();
+				kept.push_back(blocks[b]);
+			}
+		}
+		for (int b = 0; b < kept.size(); b++) {
+			for (int i = 0; i < kept[b].succs.size(); i++) {
+				kept[b].succs[i] = newIds[kept[b].succs[i]];
+			}
+			for (int i = 0; i < kept[b].preds.size(); i++) {
+				kept[b].preds[i] = newIds[kept[b].preds[i]];
+			}
+		}
+		int removed = blocks.size() - kept.size();
+		blocks.swap(kept);
+		indexLabels();
+		return removed;
+	}
+
+	void CControlFlowGraph::RemoveEdge(int from, int to) {
+		vector<int>& succs = blocks[from].succs;
+		succs.erase(find(succs.begin(), succs.end(), to));
+		CBlock& target = blocks[to];
+		int j = find(target.preds.begin(), target.preds.end(), from) - target.preds.begin();
+		target.preds.erase(target.preds.begin() + j);
+		for (int p = 0; p < target.phis.size(); p++) {
+			target.phis[p].args.erase(target.phis[p].args.begin() + j);
+		}
+	}
+
+	void CControlFlowGraph::RetargetJump(int block, const CLabel* from, const CLabel* to) {
+		IStm* jump = blocks[block].jump;
+		JUMP* j = dynamic_cast<JUMP*>(jump);
+		if (j != 0 && j->target == from) {
+			blocks[block].jump = new JUMP(to);
+		}
+		CJUMP* cj = dynamic_cast<CJUMP*>(jump);
+		if (cj != 0) {
+			blocks[block].jump = new CJUMP(cj->relop, cj->left, cj->right,
+										   (cj->iftrue == from) ? to : cj->iftrue,
+										   (cj->iffalse == from) ? to : cj->iffalse);
+		}
+	}
+
+	int CControlFlowGraph::SplitEdge(int from, int to) {
+		CBlock middle;
+		middle.label = new CLabel();
+		middle.jump = new JUMP(blocks[to].label);
+		middle.preds.push_back(from);
+		middle.succs.push_back(to);
+		int id = blocks.size();
+		blocks.push_back(middle);
+		blockIds[middle.label] = id;
+
+		RetargetJump(from, blocks[to].label, middle.label);
+		replace(blocks[from].succs.begin(), blocks[from].succs.end(), to, id);
+		// Номер предшественника сохраняется, поэтому аргументы phi остаются на своих местах
+		replace(blocks[to].preds.begin(), blocks[to].preds.end(), from, id);
+		return id;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Dominators
+	//--------------------------------------------------------------------------------------------------------------
+
+	vector<int> CControlFlowGraph::ReversePostorder() const {
+		vector<bool> visited(blocks.size(), false);
+		vector<int> postorder;
+		vector<pair<int, int>> stack;
+		visited[0] = true;
+		stack.push_back(make_pair(0, 0));
+		while (!stack.empty()) {
+			int node = stack.back().first;
+			int& next = stack.back().second;
+			if (next < blocks[node].succs.size()) {
+				int child = blocks[node].succs[next++];
+				if (!visited[child]) {
+					visited[child] = true;
+					stack.push_back(make_pair(child, 0));
+				}
+			} else {
+				postorder.push_back(node);
+				stack.pop_back();
+			}
+		}
+		return vector<int>(postorder.rbegin(), postorder.rend());
+	}
+
+	void CControlFlowGraph::ComputeDominators() {
+		int n = blocks.size();
+		vector<int> order = ReversePostorder();
+		vector<int> position(n, -1);
+		for (int i = 0; i < order.size(); i++) {
+			position[order[i]] = i;
+		}
+
+		idom.assign(n, -1);
+		idom[0] = 0;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (int i = 1; i < order.size(); i++) {
+				int b = order[i];
+				int newIdom = -1;
+				for (int p = 0; p < blocks[b].preds.size(); p++) {
+					int pred = blocks[b].preds[p];
+					if (idom[pred] == -1) {
+						continue;
+					}
+					if (newIdom == -1) {
+						newIdom = pred;
+						continue;
+					}
+					int x = pred;
+					int y = newIdom;
+					while (x != y) {
+						while (position[x] > position[y]) {
+							x = idom[x];
+						}
+						while (position[y] > position[x]) {
+							y = idom[y];
+						}
+					}
+					newIdom = x;
+				}
+				if (idom[b] != newIdom) {
+					idom[b] = newIdom;
+					changed = true;
+				}
+			}
+		}
+		idom[0] = -1;
+
+		domChildren.assign(n, vector<int>());
+		for (int i = 1; i < order.size(); i++) {
+			domChildren[idom[order[i]]].push_back(order[i]);
+		}
+
+		domEnter.assign(n, -1);
+		domLeave.assign(n, -1);
+		int counter = 0;
+		vector<pair<int, int>> stack(1, make_pair(0, 0));
+		domEnter[0] = counter++;
+		while (!stack.empty()) {
+			int node = stack.back().first;
+			int& next = stack.back().second;
+			if (next < domChildren[node].size()) {
+				int child = domChildren[node][next++];
+				domEnter[child] = counter++;
+				stack.push_back(make_pair(child, 0));
+			} else {
+				domLeave[node] = counter++;
+				stack.pop_back();
+			}
+		}
+
+		frontier.assign(n, vector<int>());
+		for (int b = 0; b < n; b++) {
+			if (position[b] == -1 || blocks[b].preds.size() < 2) {
+				continue;
+			}
+			for (int p = 0; p < blocks[b].preds.size(); p++) {
+				int runner = blocks[b].preds[p];
+				if (position[runner] == -1) {
+					continue;
+				}
+				while (runner != -1 && runner != idom[b]) {
+					vector<int>& df = frontier[runner];
+					if (find(df.begin(), df.end(), b) == df.end()) {
+						df.push_back(b);
+					}
+					runner = idom[runner];
+				}
+			}
+		}
+	}
+
+	bool CControlFlowGraph::Dominates(int a, int b) const {
+		if (domEnter[a] == -1 || domEnter[b] == -1) {
+			return false;
+		}
+		return domEnter[a] <= domEnter[b] && domLeave[b] <= domLeave[a];
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Loops
+	//--------------------------------------------------------------------------------------------------------------
+
+	vector<CLoop> CControlFlowGraph::FindLoops() const {
+		int n = blocks.size();
+		map<int, CLoop> byHeader;
+		for (int b = 0; b < n; b++) {
+			for (int s = 0; s < blocks[b].succs.size(); s++) {
+				int header = blocks[b].succs[s];
+				if (!Dominates(header, b)) {
+					continue;
+				}
+				CLoop& loop = byHeader[header];
+				if (loop.contains.empty()) {
+					loop.header = header;
+					loop.contains.assign(n, false);
+					loop.contains[header] = true;
+					loop.blocks.push_back(header);
+				}
+				vector<int> stack(1, b);
+				while (!stack.empty()) {
+					int x = stack.back();
+					stack.pop_back();
+					if (loop.contains[x]) {
+						continue;
+					}
+					loop.contains[x] = true;
+					loop.blocks.push_back(x);
+					stack.insert(stack.end(), blocks[x].preds.begin(), blocks[x].preds.end());
+				}
+			}
+		}
+
+		vector<CLoop> loops;
+		for (map<int, CLoop>::iterator it = byHeader.begin(); it != byHeader.end(); it++) {
+			loops.push_back(it->second);
+		}
+		// Вложенный цикл строго меньше объемлющего
+		sort(loops.begin(), loops.end(), [](const CLoop& a, const CLoop& b) { return a.blocks.size() < b.blocks.size(); });
+		for (int i = 0; i < loops.size(); i++) {
+			CLoop& loop = loops[i];
+			loop.depth = 0;
+			for (int j = 0; j < loops.size(); j++) {
+				loop.depth += loops[j].contains[loop.header] ? 1 : 0;
+			}
+			loop.preheader = -1;
+			const vector<int>& preds = blocks[loop.header].preds;
+			for (int p = 0; p < preds.size(); p++) {
+				if (!loop.contains[preds[p]]) {
+					bool single = loop.preheader == -1 && blocks[preds[p]].succs.size() == 1;
+					loop.preheader = single ? preds[p] : -2;
+				}
+			}
+			loop.preheader = max(loop.preheader, -1);
+		}
+		return loops;
+	}
+
+	int CControlFlowGraph::InsertPreheader(CLoop& loop) {
+		if (loop.preheader != -1) {
+			return loop.preheader;
+		}
+		int outside = -1;
+		const vector<int>& preds = blocks[loop.header].preds;
+		for (int p = 0; p < preds.size(); p++) {
+			if (!loop.contains[preds[p]]) {
+				if (outside != -1) {
+					return -1;
+				}
+				outside = preds[p];
+			}
+		}
+		if (outside == -1) {
+			return -1;
+		}
+		loop.preheader = SplitEdge(outside, loop.header);
+		return loop.preheader;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Output
+	//--------------------------------------------------------------------------------------------------------------
+
+	shared_ptr<StmtList> CControlFlowGraph::ToStmtList() const {
+		shared_ptr<StmtList> result = make_shared<StmtList>(new LABEL(exit), nullptr);
+		for (int b = blocks.size() - 1; b >= 0; b--) {
+			const CBlock& block = blocks[b];
+			assert(block.phis.empty());
+			result = make_shared<StmtList>(block.jump, result);
+			for (int i = block.stms.size() - 1; i >= 0; i--) {
+				result = make_shared<StmtList>(block.stms[i], result);
+			}
+			result = make_shared<StmtList>(new LABEL(block.label), result);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef COMPILERS_CONTROLFLOWGRAPH_H
+#define COMPILERS_CONTROLFLOWGRAPH_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+
+using namespace IRTree;
+using namespace Temp;
+
+namespace Canon {
+	// phi-функция: dst = phi(args), аргумент args[i] приходит из блока preds[i]
+	struct CPhi {
+		CPhi(shared_ptr<const CTemp> _variable, int predsCount) :
+			variable(_variable), dst(_variable), args(predsCount, _variable) {}
+
+		// Переменная до переименования
+		shared_ptr<const CTemp> variable;
+		shared_ptr<const CTemp> dst;
+		vector<shared_ptr<const CTemp>> args;
+	};
+
+	// Базовый блок: метка, тело без метки и перехода, завершающий JUMP или CJUMP
+	struct CBlock {
+		const CLabel* label;
+		vector<CPhi> phis;
+		vector<IStm*> stms;
+		IStm* jump;
+		vector<int> succs;
+		vector<int> preds;
+	};
+
+	// Естественный цикл: заголовок и блоки, из которых обратное ребро достижимо в обход заголовка
+	struct CLoop {
+		int header;
+		// Единственный внешний предшественник заголовка, из которого есть переход только в заголовок, иначе -1
+		int preheader;
+		vector<int> blocks;
+		// Принадлежность блоков циклу, индекс - номер блока
+		vector<bool> contains;
+		// 1 для внешних циклов
+		int depth;
+	};
+
+	// Граф потока управления функции над линеаризованными деревьями.
+	// Блоки хранятся в исходном порядке, блок 0 - вход функции.
+	class CControlFlowGraph {
+	public:
+		CControlFlowGraph(shared_ptr<StmtList> stms);
+
+		int Size() const { return blocks.size(); }
+		int StatementsCount() const;
+		// Блок с данной меткой или -1 (например, для метки выхода)
+		int BlockByLabel(const CLabel* label) const;
+
+		// Удаляет недостижимые блоки вместе с их аргументами в phi-функциях, возвращает число удалённых
+		int RemoveUnreachable();
+		// Удаляет ребро from -> to вместе с аргументами phi; переход блока from не меняется
+		void RemoveEdge(int from, int to);
+		// Вставляет пустой блок на ребро from -> to, возвращает его номер
+		int SplitEdge(int from, int to);
+		// Перенаправляет переход блока с метки from на метку to
+		void RetargetJump(int block, const CLabel* from, const CLabel* to);
+		// Пересчитывает рёбра по переходам блоков
+		void ComputeEdges();
+
+		// Деревья доминаторов (Cooper, Harvey, Kennedy) и границы доминирования
+		void ComputeDominators();
+		bool Dominates(int a, int b) const;
+		vector<int> ReversePostorder() const;
+		// Естественные циклы (циклы с общим заголовком объединяются), вложенные раньше объемлющих.
+		// Нужны доминаторы.
+		vector<CLoop> FindLoops() const;
+		// Находит или создаёт предзаголовок цикла: при единственном внешнем предшественнике
+		// с несколькими преемниками расщепляет ребро. При нескольких внешних входах возвращает -1.
+		// Новый блок не входит в циклы, найденные раньше, - их и доминаторы нужно пересчитать.
+		int InsertPreheader(CLoop& loop);
+
+		// Обратно в список операторов; phi-функций к этому моменту быть не должно
+		shared_ptr<StmtList> ToStmtList() const;
+
+		vector<CBlock> blocks;
+		// Метка, на которую переходят при выходе из функции
+		const CLabel* exit;
+		// Непосредственный доминатор (-1 для входа и недостижимых блоков)
+		vector<int> idom;
+		vector<vector<int>> domChildren;
+		vector<vector<int>> frontier;
+
+	private:
+		map<const CLabel*, int> blockIds;
+		// Номера блоков в прямом обходе дерева доминаторов - для проверки доминирования за O(1)
+		vector<int> domEnter;
+		vector<int> domLeave;
+
+		void indexLabels();
+	};
+}
+
+#endif //COMPILERS_CONTROLFLOWGRAPH_H
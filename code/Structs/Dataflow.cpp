@@ -0,0 +1,254 @@
+#include "../Structs/Dataflow.h"
+
+namespace Dataflow {
+	//--------------------------------------------------------------------------------------------------------------
+	// CDataflowGraph
+	//--------------------------------------------------------------------------------------------------------------
+
+	void CDataflowGraph::AddEdge(int from, int to) {
+		succs[from].push_back(to);
+		preds[to].push_back(from);
+	}
+
+	vector<int> CDataflowGraph::ReversePostorder(TDirection direction) const {
+		const vector<vector<int>>& forward = (direction == D_Forward) ? succs : preds;
+		const vector<vector<int>>& backward = (direction == D_Forward) ? preds : succs;
+		int n = Size();
+		vector<bool> visited(n, false);
+		vector<int> postorder;
+		postorder.reserve(n);
+
+		// Сначала обходим от входов (вершин без входящих рёбер), затем всё недостигнутое
+		vector<int> roots;
+		for (int i = 0; i < n; i++) {
+			if (backward[i].empty()) {
+				roots.push_back(i);
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			roots.push_back(i);
+		}
+
+		vector<pair<int, int>> stack;
+		for (int r = 0; r < roots.size(); r++) {
+			if (visited[roots[r]]) {
+				continue;
+			}
+			visited[roots[r]] = true;
+			stack.push_back(make_pair(roots[r], 0));
+			while (!stack.empty()) {
+				int node = stack.back().first;
+				int& next = stack.back().second;
+				if (next < forward[node].size()) {
+					int child = forward[node][next++];
+					if (!visited[child]) {
+						visited[child] = true;
+						stack.push_back(make_pair(child, 0));
+					}
+				} else {
+					postorder.push_back(node);
+					stack.pop_back();
+				}
+			}
+		}
+		return vector<int>(postorder.rbegin(), postorder.rend());
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CTempNumbering
+	//--------------------------------------------------------------------------------------------------------------
+
+	int CTempNumbering::Add(const CTemp* temp) {
+		map<const CTemp*, int>::iterator it = ids.find(temp);
+		if (it != ids.end()) {
+			return it->second;
+		}
+		ids[temp] = temps.size();
+		temps.push_back(temp);
+		return temps.size() - 1;
+	}
+
+	int CTempNumbering::Find(const CTemp* temp) const {
+		map<const CTemp*, int>::const_iterator it = ids.find(temp);
+		return (it != ids.end()) ? it->second : -1;
+	}
+
+	const CTemp* CTempNumbering::Get(int index) const {
+		return temps[index];
+	}
+
+	int CTempNumbering::Size() const {
+		return temps.size();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// Helpers
+	//--------------------------------------------------------------------------------------------------------------
+
+	CDataflowGraph BuildDataflowGraph(const FlowGraph::CFlowGraph& flowGraph) {
+		CDataflowGraph graph(flowGraph.Size());
+		for (int i = 0; i < flowGraph.Size(); i++) {
+			const vector<int>& succs = flowGraph.Successors(i);
+			for (int k = 0; k < succs.size(); k++) {
+				graph.AddEdge(i, succs[k]);
+			}
+		}
+		return graph;
+	}
+
+	static vector<pair<int, int>> collectDefinitions(const CInstrStream& instructions) {
+		vector<pair<int, int>> definitions;
+		for (int i = 0; i < instructions.Size(); i++) {
+			for (int temp : instructions[i].defs) {
+				definitions.push_back(make_pair(i, temp));
+			}
+		}
+		return definitions;
+	}
+
+	static bool isMemoryStore(const CInstr& instr) {
+		return instr.defs.Empty() && !instr.IsJump() && instr.MemoryOperand() != -1;
+	}
+
+	static bool isCall(const CInstr& instr) {
+		return instr.opcode == OP_Call;
+	}
+
+	// Ключ выражения, вычисляемого командой, или пустая строка, если команда выражения не вычисляет
+	static string expressionKey(const CInstr& instr) {
+		if (instr.IsLabel() || instr.IsJump() || instr.move || instr.defs.Size() != 1) {
+			return "";
+		}
+		string key = OpcodeName(instr.opcode);
+		if (instr.opcode == OP_Set || instr.opcode == OP_Cmov) {
+			key += ConditionName(instr.condition);
+		}
+		for (int i = 0; i < instr.operandCount; i++) {
+			const CInstrOperand& operand = instr.operands[i];
+			key += " " + to_string(operand.kind) + ":" + to_string(operand.temp) + ":" + to_string(operand.base) + ":"
+				+ to_string(operand.index) + "*" + to_string(operand.scale) + ":" + to_string(operand.size) + ":"
+				+ to_string(operand.value) + ((operand.label != 0) ? ":" + operand.label->Name() : "");
+		}
+		for (int temp : instr.uses) {
+			if (temp == instr.defs[0]) {
+				return "";
+			}
+			key += " " + to_string(temp);
+		}
+		return key;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CLiveness
+	//--------------------------------------------------------------------------------------------------------------
+
+	CLiveness::CLiveness(FlowGraph::CFlowGraph& flowGraph) :
+		instructions(flowGraph.Stream()),
+		graph(BuildDataflowGraph(flowGraph)),
+		solver(graph, instructions.TempsCount())
+	{
+		// in = use | (out & ~def)
+		for (int i = 0; i < instructions.Size(); i++) {
+			for (int temp : instructions[i].uses) {
+				solver.gen[i].Set(temp);
+			}
+			for (int temp : instructions[i].defs) {
+				solver.kill[i].Set(temp);
+			}
+		}
+		solver.Solve();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CReachingDefinitions
+	//--------------------------------------------------------------------------------------------------------------
+
+	CReachingDefinitions::CReachingDefinitions(FlowGraph::CFlowGraph& flowGraph) :
+		instructions(flowGraph.Stream()),
+		graph(BuildDataflowGraph(flowGraph)),
+		definitions(collectDefinitions(instructions)),
+		solver(graph, definitions.size())
+	{
+		vector<vector<int>> definitionsOfTemp(instructions.TempsCount());
+		for (int d = 0; d < definitions.size(); d++) {
+			definitionsOfTemp[definitions[d].second].push_back(d);
+		}
+		for (int d = 0; d < definitions.size(); d++) {
+			int node = definitions[d].first;
+			solver.gen[node].Set(d);
+			const vector<int>& others = definitionsOfTemp[definitions[d].second];
+			for (int i = 0; i < others.size(); i++) {
+				if (definitions[others[i]].first != node) {
+					solver.kill[node].Set(others[i]);
+				}
+			}
+		}
+		solver.Solve();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// CAvailableExpressions
+	//--------------------------------------------------------------------------------------------------------------
+
+	static vector<string> collectExpressions(const CInstrStream& instructions) {
+		set<string> keys;
+		for (int i = 0; i < instructions.Size(); i++) {
+			string key = expressionKey(instructions[i]);
+			if (!key.empty()) {
+				keys.insert(key);
+			}
+		}
+		return vector<string>(keys.begin(), keys.end());
+	}
+
+	CAvailableExpressions::CAvailableExpressions(FlowGraph::CFlowGraph& flowGraph) :
+		instructions(flowGraph.Stream()),
+		graph(BuildDataflowGraph(flowGraph)),
+		expressions(collectExpressions(instructions)),
+		solver(graph, expressions.size())
+	{
+		map<string, int> ids;
+		vector<vector<int>> usersOfTemp(instructions.TempsCount());
+		vector<int> loads;
+		for (int e = 0; e < expressions.size(); e++) {
+			ids[expressions[e]] = e;
+		}
+		vector<int> expressionOf(instructions.Size(), -1);
+		for (int i = 0; i < instructions.Size(); i++) {
+			string key = expressionKey(instructions[i]);
+			if (key.empty()) {
+				continue;
+			}
+			int e = ids[key];
+			expressionOf[i] = e;
+			for (int temp : instructions[i].uses) {
+				usersOfTemp[temp].push_back(e);
+			}
+			if (instructions[i].MemoryOperand() != -1) {
+				loads.push_back(e);
+			}
+		}
+
+		for (int i = 0; i < instructions.Size(); i++) {
+			const CInstr& instr = instructions[i];
+			for (int temp : instr.defs) {
+				const vector<int>& users = usersOfTemp[temp];
+				for (int j = 0; j < users.size(); j++) {
+					solver.kill[i].Set(users[j]);
+				}
+			}
+			// Запись в память и вызов делают недоступными все загрузки
+			if (isMemoryStore(instr) || isCall(instr)) {
+				for (int j = 0; j < loads.size(); j++) {
+					solver.kill[i].Set(loads[j]);
+				}
+			}
+			if (expressionOf[i] != -1) {
+				solver.gen[i].Set(expressionOf[i]);
+				solver.kill[i].Reset(expressionOf[i]);
+			}
+		}
+		solver.boundary.Fill(false);
+		solver.Solve();
+	}
+}
@@ -0,0 +1,165 @@
+#ifndef COMPILERS_DATAFLOW_H
+#define COMPILERS_DATAFLOW_H
+#include "../common.h"
+#include "../Structs/BitSet.h"
+#include "../Structs/FlowGraph.h"
+
+namespace Dataflow {
+	using namespace Temp;
+	using namespace Assembler;
+
+	enum TDirection { D_Forward, D_Backward };
+
+	// Решётки над плотными битовыми множествами: начальное значение и операция сбора
+	struct CUnionLattice {
+		static void Init(CBitSet& set) { set.Fill(false); }
+		static bool Meet(CBitSet& dst, const CBitSet& src) { return dst.UnionWith(src); }
+	};
+
+	struct CIntersectionLattice {
+		static void Init(CBitSet& set) { set.Fill(true); }
+		static bool Meet(CBitSet& dst, const CBitSet& src) { return dst.IntersectWith(src); }
+	};
+
+	// Граф задачи: списки смежности строятся один раз, дальше решатель к CGraph не обращается
+	struct CDataflowGraph {
+		CDataflowGraph(int size = 0) : succs(size), preds(size) {}
+		int Size() const { return succs.size(); }
+		void AddEdge(int from, int to);
+		// Обратный постпорядок от входов (для обратной задачи - от выходов по обратным рёбрам)
+		vector<int> ReversePostorder(TDirection direction) const;
+
+		vector<vector<int>> succs;
+		vector<vector<int>> preds;
+	};
+
+	// Итеративный решатель: out = gen | (in & ~kill) (для обратной задачи - in = gen | (out & ~kill)),
+	// рабочий список упорядочен по обратному постпорядку.
+	template<class Lattice, TDirection Direction>
+	class CDataflowSolver {
+	public:
+		CDataflowSolver(const CDataflowGraph& _graph, int universe) :
+			graph(_graph), gen(_graph.Size(), CBitSet(universe)), kill(_graph.Size(), CBitSet(universe)),
+			in(_graph.Size(), CBitSet(universe)), out(_graph.Size(), CBitSet(universe)),
+			boundary(universe), visits(0), scratch(universe) {}
+
+		void Solve() {
+			int n = graph.Size();
+			vector<CBitSet>& before = (Direction == D_Forward) ? in : out;
+			vector<CBitSet>& after = (Direction == D_Forward) ? out : in;
+			for (int i = 0; i < n; i++) {
+				Lattice::Init(before[i]);
+				Lattice::Init(after[i]);
+			}
+			vector<int> order = graph.ReversePostorder(Direction);
+			vector<int> position(n);
+			for (int i = 0; i < order.size(); i++) {
+				position[order[i]] = i;
+			}
+			set<int> worklist;
+			for (int i = 0; i < order.size(); i++) {
+				worklist.insert(i);
+			}
+			while (!worklist.empty()) {
+				int node = order[*worklist.begin()];
+				worklist.erase(worklist.begin());
+				visits++;
+
+				const vector<int>& sources = (Direction == D_Forward) ? graph.preds[node] : graph.succs[node];
+				const vector<int>& targets = (Direction == D_Forward) ? graph.succs[node] : graph.preds[node];
+				if (sources.empty()) {
+					before[node] = boundary;
+				} else {
+					Lattice::Init(scratch);
+					for (int i = 0; i < sources.size(); i++) {
+						Lattice::Meet(scratch, after[sources[i]]);
+					}
+					before[node] = scratch;
+				}
+				if (after[node].Transfer(gen[node], before[node], kill[node])) {
+					for (int i = 0; i < targets.size(); i++) {
+						worklist.insert(position[targets[i]]);
+					}
+				}
+			}
+		}
+
+		int Visits() const { return visits; }
+
+		const CDataflowGraph& graph;
+		vector<CBitSet> gen;
+		vector<CBitSet> kill;
+		vector<CBitSet> in;
+		vector<CBitSet> out;
+		// Значение на входе функции (для обратной задачи - на выходе)
+		CBitSet boundary;
+
+	private:
+		int visits;
+		CBitSet scratch;
+	};
+
+	// Плотная нумерация временных переменных функции
+	class CTempNumbering {
+	public:
+		int Add(const CTemp* temp);
+		int Find(const CTemp* temp) const;
+		const CTemp* Get(int index) const;
+		int Size() const;
+	private:
+		map<const CTemp*, int> ids;
+		vector<const CTemp*> temps;
+	};
+
+	CDataflowGraph BuildDataflowGraph(const FlowGraph::CFlowGraph& flowGraph);
+
+	// Живые переменные: обратная задача, сбор - объединение. Биты - номера переменных потока команд
+	// (CInstrStream::Temp)
+	class CLiveness {
+	public:
+		CLiveness(FlowGraph::CFlowGraph& flowGraph);
+		const CBitSet& LiveIn(int node) const { return solver.in[node]; }
+		const CBitSet& LiveOut(int node) const { return solver.out[node]; }
+		int Visits() const { return solver.Visits(); }
+	private:
+		const CInstrStream& instructions;
+		CDataflowGraph graph;
+		CDataflowSolver<CUnionLattice, D_Backward> solver;
+	};
+
+	// Достигающие определения: прямая задача, сбор - объединение
+	class CReachingDefinitions {
+	public:
+		CReachingDefinitions(FlowGraph::CFlowGraph& flowGraph);
+		int DefinitionsCount() const { return definitions.size(); }
+		// Определение - пара (вершина, номер переменной)
+		const pair<int, int>& Definition(int index) const { return definitions[index]; }
+		const CBitSet& ReachIn(int node) const { return solver.in[node]; }
+		const CBitSet& ReachOut(int node) const { return solver.out[node]; }
+		int Visits() const { return solver.Visits(); }
+	private:
+		const CInstrStream& instructions;
+		CDataflowGraph graph;
+		vector<pair<int, int>> definitions;
+		CDataflowSolver<CUnionLattice, D_Forward> solver;
+	};
+
+	// Доступные выражения: прямая задача, сбор - пересечение.
+	// Выражение - команда без переходов с единственным результатом, вместе с её аргументами.
+	class CAvailableExpressions {
+	public:
+		CAvailableExpressions(FlowGraph::CFlowGraph& flowGraph);
+		int ExpressionsCount() const { return expressions.size(); }
+		const string& Expression(int index) const { return expressions[index]; }
+		const CBitSet& AvailIn(int node) const { return solver.in[node]; }
+		const CBitSet& AvailOut(int node) const { return solver.out[node]; }
+		int Visits() const { return solver.Visits(); }
+	private:
+		const CInstrStream& instructions;
+		CDataflowGraph graph;
+		vector<string> expressions;
+		CDataflowSolver<CIntersectionLattice, D_Forward> solver;
+	};
+}
+
+#endif //COMPILERS_DATAFLOW_H
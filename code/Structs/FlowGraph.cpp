@@ -1,59 +1,49 @@
 #include "../Structs/FlowGraph.h"
 
 namespace FlowGraph {
-	void CFlowGraph::Build(const CInstrList* instructions){
+	void CFlowGraph::Build(CInstrStream& instructions){
+		stream = &instructions;
+		succs.assign(instructions.Size(), vector<int>());
 		map<const CLabel*, int> labelToNode;
-		
-		// Первый проход - сбор ALABEL и их соответствий с CLabel*, добавление вершин
-		const CInstrList* cur = instructions;
-		while ( cur != 0 ){
-			CInstr* node = cur->head;
-			assert( node != 0 );
-			int index = addNode(node);
-			ALABEL* label = dynamic_cast<ALABEL*>(node);
-			if ( label != 0 ){
-				labelToNode[label->label] = index;
+
+		// Первый проход - вершины и соответствие меток командам
+		for ( int i = 0; i < instructions.Size(); i++ ) {
+			CInstr& instr = instructions[i];
+			addNode(&instr);
+			if ( instr.IsLabel() ) {
+				labelToNode[instr.labels[0]] = i;
 			}
-			cur = cur->tail;
 		}
 
 		// Второй проход - добавление рёбер
-		cur = instructions;
-		while ( cur != 0 ){
-			CInstr* node = cur->head;
-			assert( node != 0 );
-			CTargets* targets = node->jumps();
-			if ( targets != 0 ) {
-				CLabelList* labels = targets->labels;
-				while ( labels != 0 ) {
-					const CLabel* label = labels->head;
-					assert( label != 0 );
-					addEdge( getNode(node).index, labelToNode[label] );
-					labels = labels->tail;
-				}
-			} else {
-				if ( (cur->tail != 0) && (cur->tail->head != 0) ) {
-					CInstr* second = cur->tail->head;
-					addEdge( getNode(node).index, getNode(second).index );
+		for ( int i = 0; i < instructions.Size(); i++ ) {
+			const CInstr& instr = instructions[i];
+			if ( instr.IsJump() ) {
+				for ( int k = 0; k < instr.labelCount; k++ ) {
+					assert( labelToNode.count(instr.labels[k]) != 0 );
+					addEdge( i, labelToNode[instr.labels[k]] );
+					succs[i].push_back( labelToNode[instr.labels[k]] );
 				}
+			} else if ( i + 1 < instructions.Size() ) {
+				addEdge( i, i + 1 );
+				succs[i].push_back( i + 1 );
 			}
-			cur = cur->tail;
 		}
 	}
 
 	CInstr* CFlowGraph::GetInstr(int node){
-		return getNode(node).value;
+		return &(*stream)[node];
 	}
 
-	set<const CTemp*> CFlowGraph::GetDef( int node ){
-		return getNode(node).value->def()->GetSet();
+	const CTempIds& CFlowGraph::GetDef( int node ) const {
+		return (*stream)[node].defs;
 	}
 
-	set<const CTemp*> CFlowGraph::GetUse( int node ){
-		return getNode(node).value->use()->GetSet();
+	const CTempIds& CFlowGraph::GetUse( int node ) const {
+		return (*stream)[node].uses;
 	}
 
-	bool CFlowGraph::isMove( int node ){
-		return (dynamic_cast<AMOVE*>(getNode(node).value) != 0);
+	bool CFlowGraph::isMove( int node ) const {
+		return (*stream)[node].move;
 	}
-}
\ No newline at end of file
+}
@@ -8,14 +8,23 @@
 namespace FlowGraph {
 	using namespace Assembler;
 	using namespace Temp;
+	// Вершина i - команда stream[i]. Переменные вершин - номера в таблице потока (CInstrStream::Temp)
 	class CFlowGraph : public CGraph<int, CInstr*> {
 	public:
-		CFlowGraph() : CGraph<int, CInstr*>() {}
-		void Build(const CInstrList* instructions);
+		CFlowGraph() : CGraph<int, CInstr*>(), stream(0) {}
+		// Поток не должен меняться, пока граф используется
+		void Build(CInstrStream& instructions);
 		CInstr* GetInstr(int node);
-		set<const CTemp*> GetDef( int node );
-		set<const CTemp*> GetUse( int node );
-		bool isMove( int node );
+		const CTempIds& GetDef( int node ) const;
+		const CTempIds& GetUse( int node ) const;
+		bool isMove( int node ) const;
+		const CInstrStream& Stream() const { return *stream; }
+		int Size() const { return succs.size(); }
+		// Преемники без копирования списков рёбер CGraph
+		const vector<int>& Successors( int node ) const { return succs[node]; }
+	private:
+		CInstrStream* stream;
+		vector<vector<int>> succs;
 	};
 }
 
@@ -19,8 +19,9 @@ namespace Frame {
 	}
 
 	CFrame::CFrame( const Symbol::CSymbol* _name):
-			name(_name), varOffset(0), localOffset(0), formalOffset(-4), framePointer(new CTemp()) {
+			name(_name), varOffset(wordSize), localOffset(0), formalOffset(-wordSize), framePointer(new CTemp()) {
 		//TODO: заполнить регистры
+		framePointers.insert(framePointer.get());
 	}
 
 	const std::string& CFrame::tempMap(shared_ptr<const CTemp> t) {
@@ -48,6 +49,15 @@ namespace Frame {
 		return 0;
 	}
 
+	shared_ptr<IAccess> CFrame::getFormal(int index) {
+		assert(index >= 0 && index < formals.size());
+		return formals[index];
+	}
+
+	int CFrame::formalsCount() const {
+		return formals.size();
+	}
+
 	shared_ptr<IAccess> CFrame::getVar(const CSymbol* name) {
 		for (int i = 0; i < vars.size(); i++)
 			if (name == vars[i]->getName())
@@ -65,60 +75,267 @@ namespace Frame {
 		throw new std::out_of_range("Ident not found in findByName");
 	}
 
-	void CFrame::allocLocal(const CSymbol* name) {
+	void CFrame::allocLocal(const CSymbol* name, bool escape) {
+		if (!escape && !variablesInFrame) {
+			locals.push_back(make_shared<CRegAccess>(name));
+			return;
+		}
 		locals.push_back(shared_ptr<IAccess>(new CFrameAccess(name, this, localOffset)));
 		localOffset += wordSize;
 	}
-	void CFrame::allocFormal(const CSymbol* name) {
+	void CFrame::allocFormal(const CSymbol* name, bool escape) {
+		if (!escape && !variablesInFrame) {
+			formals.push_back(make_shared<CRegAccess>(name));
+			registerFormals[static_cast<TEMP*>(formals.back()->getExp())->temp.get()] = formals.size() - 1;
+			return;
+		}
 		formals.push_back(shared_ptr<IAccess>(new CFrameAccess(name, this, formalOffset)));
 		formalOffset -= wordSize;
 	}
+	// В нулевом слове объекта хранится указатель на таблицу виртуальных методов
 	void CFrame::allocVar(const CSymbol* name) {
 		vars.push_back(shared_ptr<IAccess>(new CVarAccess(name, this, varOffset)));
 		varOffset += wordSize;
 	}
 
+	int CFrame::allocObject(int words) {
+		int offset = localOffset;
+		localOffset += words * wordSize;
+		return offset;
+	}
+
 	IExp* CFrame::externalCall(const std::string& funcName, shared_ptr<ExpList> args) {
 		return new CALL(new NAME(shared_ptr<CLabel>(new CLabel(funcName))), args);
 	}
 
-	CTempList* CFrame::GetAllRegisters() {
-		std::unordered_map<std::string, shared_ptr<const CTemp>>::iterator it;
-		CTempList* toReturn = nullptr;
-		CTempList* l = toReturn;
+	// Параметры, не поместившиеся в регистры, вызывающий кладёт в стек начиная с последнего;
+	// над ячейками переменных лежат сохранённый указатель кадра и адрес возврата
+	shared_ptr<StmtList> CFrame::ProcEntryExit1(shared_ptr<StmtList> body) {
+		vector<IStm*> entry;
+		vector<pair<shared_ptr<const CTemp>, shared_ptr<const CTemp>>> saved;
+		for (int i = 0; i < target.calleeSaved.size(); i++) {
+			if (target.calleeSaved[i] == target.framePointer) {
+				continue;
+			}
+			saved.push_back(make_pair(allRegisters[target.calleeSaved[i]], make_shared<const CTemp>()));
+			entry.push_back(new MOVE(new TEMP(saved.back().second), new TEMP(saved.back().first)));
+		}
+		auto restore = [&saved]() {
+			vector<IStm*> stms;
+			for (int i = 0; i < saved.size(); i++) {
+				stms.push_back(new MOVE(new TEMP(saved[i].first), new TEMP(saved[i].second)));
+			}
+			return stms;
+		};
+		int stackArgument = 0;
+		for (int k = 0; k < formals.size(); k++) {
+			shared_ptr<const CTemp> reg = ArgumentRegister(k);
+			IExp* value = (reg != nullptr) ? static_cast<IExp*>(new TEMP(reg))
+				: new MEM(new BINOP(PLUS_OP, new TEMP(framePointer), new CONST(localOffset + (2 + stackArgument++) * wordSize)));
+			entry.push_back(new MOVE(formals[k]->getExp(), value));
+		}
+
+		vector<IStm*> stms;
+		body->toVector(stms);
+		assert(!stms.empty() && dynamic_cast<LABEL*>(stms.front()) != 0);
+		// Хвостовой вызов уходит из метода мимо выхода: сохраняемые регистры восстанавливаются перед ним
+		for (int i = stms.size() - 1; i > 0; i--) {
+			MOVE* move = dynamic_cast<MOVE*>(stms[i]);
+			CALL* call = (move != 0) ? dynamic_cast<CALL*>(move->src) : 0;
+			if (call != 0 && call->tail) {
+				vector<IStm*> exit = restore();
+				stms.insert(stms.begin() + i, exit.begin(), exit.end());
+			}
+		}
+		vector<IStm*> exit = restore();
+		stms.insert(stms.begin() + 1, entry.begin(), entry.end());
+		stms.insert(stms.end(), exit.begin(), exit.end());
+		shared_ptr<StmtList> result;
+		for (int i = stms.size() - 1; i >= 0; i--) {
+			result = make_shared<StmtList>(stms[i], result);
+		}
+		return result;
+	}
+
+	void CFrame::ProcEntryExit2(Assembler::CInstrStream& body) {
+		vector<shared_ptr<const CTemp>> sink;
+		for (int i = 0; i < target.calleeSaved.size(); i++) {
+			if (target.calleeSaved[i] != target.framePointer) {
+				sink.insert(sink.begin(), allRegisters[target.calleeSaved[i]]);
+			}
+		}
+		sink.push_back(ReturnValue());
+		sink.push_back(allRegisters[target.framePointer]);
+		sink.push_back(allRegisters[target.stackPointer]);
+		// Метод, в который переходит хвостовой вызов, возвращается сразу к вызывающему: при переходе живы те же
+		// регистры, кроме результата - его запишет вызываемый
+		for (int i = 0; i < body.Size(); i++) {
+			if (body[i].IsTailCall()) {
+				for (int k = 0; k < sink.size(); k++) {
+					if (sink[k] != ReturnValue()) {
+						body[i].uses.Add(body.Intern(sink[k]));
+					}
+				}
+			}
+		}
+		body.code.push_back(body.Instr(Assembler::OP_None, {}, {}, sink));
+	}
+
+	void CFrame::ProcEntryExit3(Assembler::CInstrStream& body) {
+		using namespace Assembler;
+		shared_ptr<const CTemp> fp = allRegisters[target.framePointer];
+		shared_ptr<const CTemp> sp = allRegisters[target.stackPointer];
+		// Ячейки параметров, оставшихся в кадре, лежат под указателем кадра начиная с -wordSize
+		int formalsSize = -formalOffset - wordSize;
 
-		for (it = allRegisters.begin(); it != allRegisters.end(); ++it) {
-			l = new CTempList(it->second, nullptr);
-			if (toReturn == nullptr) {
-				toReturn = l;
+		vector<CInstr> prologue;
+		prologue.push_back(body.Instr(OP_Push, { CInstrOperand::Use(0) }, { sp }, { fp, sp }));
+		if (localOffset != 0) {
+			prologue.push_back(body.Instr(OP_Sub, { CInstrOperand::Def(0), CInstrOperand::Imm(localOffset) }, { sp },
+				{ sp }));
+		}
+		prologue.push_back(body.Move(fp, sp));
+		// Дерево метода обращается к кадру через свою переменную-указатель кадра
+		prologue.push_back(body.Move(framePointer, fp));
+		if (formalsSize != 0) {
+			prologue.push_back(body.Instr(OP_Sub, { CInstrOperand::Def(0), CInstrOperand::Imm(formalsSize) }, { sp },
+				{ sp }));
+		}
+		vector<CInstr> epilogue;
+		epilogue.push_back(body.Instr(OP_Lea, { CInstrOperand::Def(0), CInstrOperand::Memory(0, -1, 1, localOffset, 0) },
+			{ sp }, { fp }));
+		epilogue.push_back(body.Instr(OP_Pop, { CInstrOperand::Def(0) }, { fp, sp }, { sp }));
+
+		assert(body.Size() != 0 && body[0].IsLabel());
+		// Хвостовой вызов - тот же эпилог, но вместо ret переход в вызываемый метод
+		for (int i = body.Size() - 1; i > 0; i--) {
+			if (body[i].IsTailCall()) {
+				body.code.insert(body.code.begin() + i, epilogue.begin(), epilogue.end());
 			}
-			l = l->tail;
 		}
-		return toReturn;
+		epilogue.push_back(body.Instr(OP_Ret, {}, {}, { sp }));
+		body.code.insert(body.code.begin() + 1, prologue.begin(), prologue.end());
+		body.code.insert(body.code.end(), epilogue.begin(), epilogue.end());
+	}
+
+	vector<shared_ptr<const CTemp>> CFrame::GetAllRegisters() {
+		vector<shared_ptr<const CTemp>> registers;
+		for (auto it = allRegisters.begin(); it != allRegisters.end(); ++it) {
+			registers.push_back(it->second);
+		}
+		return registers;
 	}
 
 	
 
+	static CTargetDescription describe(TTarget target) {
+		CTargetDescription d;
+		if (target == T_X86_64) {
+			d.name = "x86-64";
+			d.wordSize = 8;
+			d.registers = { "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp",
+				"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+			d.framePointer = "rbp";
+			d.stackPointer = "rsp";
+			d.returnValue = "rax";
+			d.accumulator = "rax";
+			d.remainder = "rdx";
+			d.signExtension = Assembler::OP_Cqo;
+			d.callerSaved = { "rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11" };
+			d.calleeSaved = { "rbx", "rbp", "r12", "r13", "r14", "r15" };
+			d.arguments = { "rdi", "rsi", "rdx", "rcx", "r8", "r9" };
+		} else {
+			d.name = "x86";
+			d.wordSize = 4;
+			d.registers = { "eax", "ebx", "ecx", "edx", "ebp", "esp" };
+			d.framePointer = "ebp";
+			d.stackPointer = "esp";
+			d.returnValue = "ecx";
+			d.accumulator = "eax";
+			d.remainder = "edx";
+			d.signExtension = Assembler::OP_Cdq;
+			d.callerSaved = { "eax", "ecx", "edx" };
+			d.calleeSaved = { "ebx", "ebp" };
+			d.arguments = { "eax", "edx" };
+		}
+		return d;
+	}
+
+	void CFrame::SetTarget(TTarget t) {
+		target = describe(t);
+		wordSize = target.wordSize;
+		allRegisters = registersInit();
+	}
+
+	void CFrame::SetVariablesInFrame(bool inFrame) {
+		variablesInFrame = inFrame;
+	}
+
+	int CFrame::FormalIndex(const CTemp* temp) {
+		map<const CTemp*, int>::const_iterator it = registerFormals.find(temp);
+		return (it != registerFormals.end()) ? it->second : -1;
+	}
+
+	bool CFrame::IsFramePointer(const CTemp* temp) {
+		return framePointers.count(temp) != 0;
+	}
+
+	const CTargetDescription& CFrame::Target() {
+		return target;
+	}
+
+	int CFrame::AllocatableRegisters() {
+		return target.registers.size() - 2;
+	}
+
 	std::unordered_map<std::string, shared_ptr<const CTemp>> CFrame::registersInit() {
 		std::unordered_map<std::string, shared_ptr<const CTemp>> regs;
-		regs["eax"] = std::make_shared<const CTemp>("eax");
-		regs["ebx"] = std::make_shared<const CTemp>("ebx");
-		regs["ecx"] = std::make_shared<const CTemp>("ecx");
-		regs["edx"] = std::make_shared<const CTemp>("edx");
-		regs["ebp"] = std::make_shared<const CTemp>("ebp");
-		regs["esp"] = std::make_shared<const CTemp>("esp");
+		for (int i = 0; i < target.registers.size(); i++) {
+			regs[target.registers[i]] = std::make_shared<const CTemp>(target.registers[i]);
+		}
 		return regs;
 	}
 
 	shared_ptr<const CTemp> CFrame::CallerSaveRegister() {
-		return allRegisters["ecx"];
+		return allRegisters[target.returnValue];
+	}
+
+	shared_ptr<const CTemp> CFrame::ReturnValue() {
+		return allRegisters[target.returnValue];
+	}
+
+	bool CFrame::IsRegister(const CTemp* temp) {
+		std::unordered_map<std::string, shared_ptr<const CTemp>>::iterator it = allRegisters.find(temp->Name());
+		return it != allRegisters.end() && it->second.get() == temp;
+	}
+
+	vector<shared_ptr<const CTemp>> CFrame::CallDefs() {
+		vector<shared_ptr<const CTemp>> defs;
+		bool result = false;
+		for (int i = 0; i < target.callerSaved.size(); i++) {
+			defs.push_back(allRegisters[target.callerSaved[i]]);
+			result = result || target.callerSaved[i] == target.returnValue;
+		}
+		if (!result) {
+			defs.insert(defs.begin(), ReturnValue());
+		}
+		return defs;
+	}
+
+	shared_ptr<const CTemp> CFrame::ArgumentRegister(int k) {
+		return (k < target.arguments.size()) ? allRegisters[target.arguments[k]] : nullptr;
 	}
 
-	CTempList* CFrame::PreColoredRegisters() {
-		return new CTempList(allRegisters["ecx"], new CTempList(allRegisters["ebp"], 
-			new CTempList(allRegisters["esp"], nullptr)));
+	vector<shared_ptr<const CTemp>> CFrame::PreColoredRegisters() {
+		return { allRegisters[target.returnValue], allRegisters[target.framePointer],
+			allRegisters[target.stackPointer] };
 	}
 
+	CTargetDescription CFrame::target = describe(T_X86);
+	bool CFrame::variablesInFrame = false;
+	map<const CTemp*, int> CFrame::registerFormals;
+	set<const CTemp*> CFrame::framePointers;
+	int CFrame::wordSize = CFrame::target.wordSize;
 	std::unordered_map<std::string, shared_ptr<const CTemp>> CFrame::allRegisters = CFrame::registersInit();
 
 
@@ -4,11 +4,35 @@
 #include "../Structs/IRTree.h"
 #include "../Structs/Temp.h"
 #include "../Structs/TempMap.h"
+#include "../Structs/Assembler.h"
 
 using namespace Temp;
 using namespace IRTree;
 namespace Frame {
 class CFrame;
+
+enum TTarget { T_X86, T_X86_64 };
+
+// Описание целевой архитектуры: размер слова, регистры и их назначение
+struct CTargetDescription {
+	string name;
+	int wordSize;
+	vector<string> registers;
+	string framePointer;
+	string stackPointer;
+	// Регистр результата метода
+	string returnValue;
+	// Делимое и частное idiv, остаток и команда расширения знака делимого
+	string accumulator;
+	string remainder;
+	Assembler::TOpcode signExtension;
+	// Регистры, которые портит вызов, и регистры, сохраняемые вызываемым методом
+	vector<string> callerSaved;
+	vector<string> calleeSaved;
+	// Регистры первых аргументов вызова
+	vector<string> arguments;
+};
+
 // Переменная фрейма
 class IAccess {
 public:
@@ -60,11 +84,30 @@ private:
 class CFrame: public CTempMap {
 // Класс-контейнер с платформо-зависимой информацией о функции
 public:
-	static const int wordSize = 4;
+	// Размер слова целевой архитектуры, задаётся SetTarget до трансляции
+	static int wordSize;
 	static std::unordered_map<std::string, shared_ptr<const CTemp>> allRegisters;
-	static CTempList* PreColoredRegisters();
-	static CTempList* GetAllRegisters();
+	// Выбор целевой архитектуры: размер слова и набор машинных регистров
+	static void SetTarget(TTarget target);
+	static void SetVariablesInFrame(bool inFrame);
+	// Номер параметра (нулевой - this), хранящегося в переменной temp, или -1
+	static int FormalIndex(const CTemp* temp);
+	// Указатель кадра какого-либо метода: его значение задаёт пролог
+	static bool IsFramePointer(const CTemp* temp);
+	static const CTargetDescription& Target();
+	// Регистры, доступные распределению (все, кроме указателей кадра и стека)
+	static int AllocatableRegisters();
+	static vector<shared_ptr<const CTemp>> PreColoredRegisters();
+	// Регистры, которые портит вызов: сохраняемые вызывающим и регистр результата
+	static vector<shared_ptr<const CTemp>> CallDefs();
+	// Регистр k-го аргумента вызова (нулевой - this) или nullptr, если аргумент передаётся через стек
+	static shared_ptr<const CTemp> ArgumentRegister(int k);
+	static vector<shared_ptr<const CTemp>> GetAllRegisters();
 	static shared_ptr<const CTemp> CallerSaveRegister();
+	// Регистр, через который метод возвращает результат (его же генератор кода считает значением CALL)
+	static shared_ptr<const CTemp> ReturnValue();
+	// Машинные регистры не являются переменными промежуточного представления
+	static bool IsRegister(const CTemp* temp);
 	CFrame( const Symbol::CSymbol* _name);
 	/*static*/const std::string& tempMap(shared_ptr<const CTemp> t);
 	
@@ -72,15 +115,36 @@ public:
 	shared_ptr<IAccess> getTP();
 	shared_ptr<IAccess> getLocal(const CSymbol* name);
 	shared_ptr<IAccess> getFormal(const CSymbol* name);
+	// Параметр по номеру, нулевой - this
+	shared_ptr<IAccess> getFormal(int index);
+	int formalsCount() const;
 	shared_ptr<IAccess> getVar(const CSymbol* name);
 	IExp* findByName(const CSymbol* name);
-	void allocLocal(const CSymbol* name);
-	void allocFormal(const CSymbol* name);
+	// Неубегающая переменная или параметр хранится в переменной промежуточного представления (CRegAccess),
+	// убегающая - в ячейке кадра (CFrameAccess); SetVariablesInFrame(true) оставляет в кадре все
+	void allocLocal(const CSymbol* name, bool escape);
+	void allocFormal(const CSymbol* name, bool escape);
 	void allocVar(const CSymbol* name);
+	// Место в кадре под объект из words слов, не покидающий метод; возвращает смещение от указателя кадра
+	int allocObject(int words);
 	IExp* externalCall(const std::string& funcName, shared_ptr<ExpList> args);
+	// Вход и выход метода. body начинается меткой метода и заканчивается меткой выхода (после трассировки).
+	// 1: параметры переносятся из регистров и стека вызывающего в свои ячейки, регистры, сохраняемые вызываемым,
+	// копируются в переменные на входе и восстанавливаются на выходе и перед хвостовыми вызовами (CALL::tail).
+	shared_ptr<StmtList> ProcEntryExit1(shared_ptr<StmtList> body);
+	// 2: на выходе живы регистр результата, указатели кадра и стека и сохраняемые регистры,
+	// в хвостовом вызове - все они, кроме регистра результата.
+	void ProcEntryExit2(Assembler::CInstrStream& body);
+	// 3: пролог после метки метода и эпилог с возвратом, перед хвостовыми вызовами - эпилог без ret.
+	// Ячейки переменных лежат над указателем кадра, ячейки параметров - под ним.
+	void ProcEntryExit3(Assembler::CInstrStream& body);
 	~CFrame() {}
 private:
 	static std::unordered_map<std::string, shared_ptr<const CTemp>> registersInit();
+	static CTargetDescription target;
+	static bool variablesInFrame;
+	static map<const CTemp*, int> registerFormals;
+	static set<const CTemp*> framePointers;
 
 	const Symbol::CSymbol* name;
 	shared_ptr<CTemp> framePointer;
@@ -94,6 +158,15 @@ private:
 	vector<shared_ptr<IAccess>> vars;
 };
 
+// Фрагмент программы: дерево метода и кадр, в котором оно построено
+struct CFragment {
+	CFragment(shared_ptr<CLabel> _label, shared_ptr<CFrame> _frame) : label(_label), frame(_frame) {}
+
+	// Метка, по которой метод вызывается
+	shared_ptr<CLabel> label;
+	shared_ptr<CFrame> frame;
+};
+
 }
 
 #endif
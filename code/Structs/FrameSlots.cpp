@@ -0,0 +1,131 @@
+#include "../Structs/FrameSlots.h"
+#include "../Structs/IRUtils.h"
+#include "../Structs/Frame.h"
+
+namespace Canon {
+	typedef shared_ptr<const CTemp> TTemp;
+
+	// Для BINOP(+, TEMP fp, CONST c) возвращает fp и c
+	static bool matchSlotAddress(IExp* exp, TTemp& base, int& offset) {
+		BINOP* address = dynamic_cast<BINOP*>(exp);
+		if (address == 0 || address->binop != PLUS_OP) {
+			return false;
+		}
+		TEMP* temp = dynamic_cast<TEMP*>(address->left);
+		CONST* constant = dynamic_cast<CONST*>(address->right);
+		if (temp == 0 || constant == 0) {
+			return false;
+		}
+		base = temp->temp;
+		offset = constant->value;
+		return true;
+	}
+
+	CFrameSlots::CFrameSlots(CControlFlowGraph& graph) {
+		map<const CTemp*, int> definitions;
+		forEachStm(graph, [&](IStm* stm) {
+			vector<TTemp> temps;
+			IRTree::CollectUses(stm, temps);
+			for (int t = 0; t < temps.size(); t++) {
+				uses[temps[t].get()]++;
+				owners[temps[t].get()] = temps[t];
+			}
+			TTemp def = IRTree::DefinedTemp(stm);
+			if (def != nullptr) {
+				definitions[def.get()]++;
+				TTemp base;
+				int offset;
+				if (matchSlotAddress(static_cast<MOVE*>(stm)->src, base, offset)) {
+					addresses[def.get()] = make_pair(base.get(), offset);
+				}
+			}
+		});
+		for (map<const CTemp*, pair<const CTemp*, int>>::iterator it = addresses.begin(); it != addresses.end();) {
+			it = (definitions[it->first] == 1) ? next(it) : addresses.erase(it);
+		}
+
+		// Адрес годится, если используется только для обращения к памяти
+		map<const CTemp*, int> slotUses;
+		forEachStm(graph, [&](IStm* stm) {
+			MOVE* move = dynamic_cast<MOVE*>(stm);
+			if (move != 0) {
+				// Сам приёмник; адрес приёмника среди kids() и считается ниже
+				countSlot(move->dst, slotUses);
+			}
+			shared_ptr<ExpList> kids = stm->kids();
+			for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+				count(l->head, slotUses);
+			}
+		});
+		for (map<const CTemp*, pair<const CTemp*, int>>::iterator it = addresses.begin(); it != addresses.end();) {
+			it = (slotUses[it->first] == uses[it->first]) ? next(it) : addresses.erase(it);
+		}
+		for (map<const CTemp*, pair<const CTemp*, int>>::iterator it = addresses.begin(); it != addresses.end(); it++) {
+			slotUses[it->second.first]++;
+		}
+
+		// Указатель кадра нигде не определяется и встречается только в адресах ячеек; this, хранящийся
+		// в переменной, тоже может обращаться к памяти только по постоянным смещениям, но это поля объекта
+		for (map<const CTemp*, int>::iterator it = slotUses.begin(); it != slotUses.end(); it++) {
+			if (definitions.count(it->first) == 0 && addresses.count(it->first) == 0
+				&& uses[it->first] == it->second && Frame::CFrame::FormalIndex(it->first) == -1) {
+				framePointers.insert(it->first);
+			}
+		}
+		for (map<const CTemp*, pair<const CTemp*, int>>::iterator it = addresses.begin(); it != addresses.end();) {
+			it = (framePointers.count(it->second.first) != 0) ? next(it) : addresses.erase(it);
+		}
+	}
+
+	pair<const CTemp*, int> CFrameSlots::Match(IExp* exp) const {
+		MEM* mem = dynamic_cast<MEM*>(exp);
+		if (mem == 0) {
+			return make_pair(nullptr, 0);
+		}
+		TTemp base;
+		int offset;
+		if (matchSlotAddress(mem->exp, base, offset) && framePointers.count(base.get()) != 0) {
+			return make_pair(base.get(), offset);
+		}
+		TEMP* temp = dynamic_cast<TEMP*>(mem->exp);
+		if (temp != 0 && addresses.count(temp->temp.get()) != 0) {
+			return addresses.find(temp->temp.get())->second;
+		}
+		return make_pair(nullptr, 0);
+	}
+
+	bool CFrameSlots::IsAddress(IStm* stm) const {
+		TTemp def = IRTree::DefinedTemp(stm);
+		return def != nullptr && addresses.count(def.get()) != 0;
+	}
+
+	void CFrameSlots::forEachStm(CControlFlowGraph& graph, const function<void(IStm*)>& f) {
+		for (int b = 0; b < graph.Size(); b++) {
+			for (int i = 0; i < graph.blocks[b].stms.size(); i++) {
+				f(graph.blocks[b].stms[i]);
+			}
+			f(graph.blocks[b].jump);
+		}
+	}
+
+	void CFrameSlots::countSlot(IExp* exp, map<const CTemp*, int>& slotUses) {
+		MEM* mem = dynamic_cast<MEM*>(exp);
+		TTemp base;
+		int offset;
+		if (mem != 0 && matchSlotAddress(mem->exp, base, offset)) {
+			slotUses[base.get()]++;
+		}
+		TEMP* temp = (mem != 0) ? dynamic_cast<TEMP*>(mem->exp) : 0;
+		if (temp != 0) {
+			slotUses[temp->temp.get()]++;
+		}
+	}
+
+	void CFrameSlots::count(IExp* exp, map<const CTemp*, int>& slotUses) {
+		countSlot(exp, slotUses);
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			count(l->head, slotUses);
+		}
+	}
+}
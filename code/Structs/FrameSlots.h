@@ -0,0 +1,34 @@
+#ifndef COMPILERS_FRAMESLOTS_H
+#define COMPILERS_FRAMESLOTS_H
+#include "../common.h"
+#include "../Structs/ControlFlowGraph.h"
+
+namespace Canon {
+	// Ячейки кадра: MEM(fp + c) или MEM(TEMP a), где a = fp + c - адрес, вынесенный канонизатором.
+	// Указатель кадра - переменная, которая нигде не определяется и встречается только в адресах ячеек
+	// (адрес локальной переменной в MiniJava не может утечь).
+	class CFrameSlots {
+	public:
+		CFrameSlots(CControlFlowGraph& graph);
+
+		bool Empty() const { return framePointers.empty(); }
+		shared_ptr<const CTemp> Temp(const CTemp* temp) const { return owners.find(temp)->second; }
+
+		// Ячейка, к которой обращается exp, или (nullptr, 0)
+		pair<const CTemp*, int> Match(IExp* exp) const;
+		// Определение адреса ячейки, которое после переноса больше не нужно
+		bool IsAddress(IStm* stm) const;
+
+	private:
+		map<const CTemp*, int> uses;
+		map<const CTemp*, shared_ptr<const CTemp>> owners;
+		map<const CTemp*, pair<const CTemp*, int>> addresses;
+		set<const CTemp*> framePointers;
+
+		static void forEachStm(CControlFlowGraph& graph, const function<void(IStm*)>& f);
+		static void countSlot(IExp* exp, map<const CTemp*, int>& slotUses);
+		void count(IExp* exp, map<const CTemp*, int>& slotUses);
+	};
+}
+
+#endif //COMPILERS_FRAMESLOTS_H
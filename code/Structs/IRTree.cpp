@@ -160,17 +160,48 @@ namespace IRTree {
 		return new BINOP(binop, kids->head, kids->tail.get()->head);
 	}
 
+	//--------------------------------------------------------------------------------------------------------------
+	// CMP
+	//--------------------------------------------------------------------------------------------------------------
+
+	CMP::CMP(CJUMP_OP _relop, IExp* _left, IExp* _right): relop(_relop), left(_left), right(_right) {}
+
+	shared_ptr<ExpList> CMP::kids() {
+		return make_shared<ExpList>(left, make_shared<ExpList>(right, nullptr));
+	}
+
+	IExp* CMP::build(shared_ptr<ExpList> kids) {
+		return new CMP(relop, kids->head, kids->tail.get()->head);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	// SELECT
+	//--------------------------------------------------------------------------------------------------------------
+
+	SELECT::SELECT(CJUMP_OP _relop, IExp* _left, IExp* _right, IExp* _iftrue, IExp* _iffalse):
+		relop(_relop), left(_left), right(_right), iftrue(_iftrue), iffalse(_iffalse) {}
+
+	shared_ptr<ExpList> SELECT::kids() {
+		return make_shared<ExpList>(left, make_shared<ExpList>(right, make_shared<ExpList>(iftrue,
+			make_shared<ExpList>(iffalse, nullptr))));
+	}
+
+	IExp* SELECT::build(shared_ptr<ExpList> kids) {
+		ExpList* right = kids->tail.get();
+		return new SELECT(relop, kids->head, right->head, right->tail->head, right->tail->tail->head);
+	}
+
 	//--------------------------------------------------------------------------------------------------------------
 	// CALL
 	//--------------------------------------------------------------------------------------------------------------
-	CALL::CALL(IExp* _func, shared_ptr<ExpList> _args): func(_func), args(_args) {}
+	CALL::CALL(IExp* _func, shared_ptr<ExpList> _args, bool _tail): func(_func), args(_args), tail(_tail) {}
 
 	shared_ptr<ExpList> CALL::kids() {
 		return make_shared<ExpList>(func, args);
 	}
 
 	IExp* CALL::build(shared_ptr<ExpList> kids) {
-		return new CALL(kids->head, kids->tail);
+		return new CALL(kids->head, kids->tail, tail);
 	}
 
 	//--------------------------------------------------------------------------------------------------------------
@@ -157,13 +157,41 @@ struct BINOP: public CAcceptsIRVisitor<BINOP, IExp> {
 	IExp* right;
 };
 
+// Значение сравнения: 1, если left relop right, иначе 0
+struct CMP: public CAcceptsIRVisitor<CMP, IExp> {
+	CMP(CJUMP_OP _relop, IExp* _left, IExp* _right);
+	shared_ptr<ExpList> kids();
+	IExp* build(shared_ptr<ExpList> kids);
+
+	CJUMP_OP relop;
+	IExp* left;
+	IExp* right;
+};
+
+// Выбор без перехода: iftrue, если left relop right, иначе iffalse. Вычисляются оба значения,
+// поэтому они не должны обращаться к памяти и вызывать методы
+struct SELECT: public CAcceptsIRVisitor<SELECT, IExp> {
+	SELECT(CJUMP_OP _relop, IExp* _left, IExp* _right, IExp* _iftrue, IExp* _iffalse);
+	shared_ptr<ExpList> kids();
+	IExp* build(shared_ptr<ExpList> kids);
+
+	CJUMP_OP relop;
+	IExp* left;
+	IExp* right;
+	IExp* iftrue;
+	IExp* iffalse;
+};
+
 struct CALL: public CAcceptsIRVisitor<CALL, IExp> {
-	CALL(IExp* _func, shared_ptr<ExpList> _args);
+	CALL(IExp* _func, shared_ptr<ExpList> _args, bool _tail = false);
 	shared_ptr<ExpList> kids();
 	IExp* build(shared_ptr<ExpList> kids);
 
 	IExp* func;
 	shared_ptr<ExpList> args;
+	// Хвостовой вызов MOVE(TEMP rv, CALL) перед выходом из метода: кадр освобождается до перехода в вызываемый
+	// метод (см. Canon::EliminateTailCalls). Без этой пометки вызов остаётся обычным, что тоже верно
+	bool tail;
 };
 
 struct ESEQ: public CAcceptsIRVisitor<ESEQ, IExp> {
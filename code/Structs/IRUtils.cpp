@@ -0,0 +1,208 @@
+#include "../Structs/IRUtils.h"
+#include "../Structs/Frame.h"
+#include <cstdint>
+
+namespace IRTree {
+	shared_ptr<ExpList> MakeExpList(const vector<IExp*>& exps) {
+		shared_ptr<ExpList> list = nullptr;
+		for (int i = exps.size() - 1; i >= 0; i--) {
+			list = make_shared<ExpList>(exps[i], list);
+		}
+		return list;
+	}
+
+	// Перестраивает список потомков, возвращает nullptr, если ни один потомок не изменился
+	static shared_ptr<ExpList> rewriteKids(shared_ptr<ExpList> kids, const TExpRewriter& rewriter) {
+		vector<IExp*> rewritten;
+		bool changed = false;
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			IExp* kid = RewriteExp(l->head, rewriter);
+			changed = changed || (kid != l->head);
+			rewritten.push_back(kid);
+		}
+		return changed ? MakeExpList(rewritten) : nullptr;
+	}
+
+	IExp* RewriteExp(IExp* exp, const TExpRewriter& rewriter) {
+		shared_ptr<ExpList> kids = exp->kids();
+		if (kids != nullptr) {
+			shared_ptr<ExpList> rewritten = rewriteKids(kids, rewriter);
+			if (rewritten != nullptr) {
+				exp = exp->build(rewritten);
+			}
+		}
+		return rewriter(exp);
+	}
+
+	IStm* RewriteStm(IStm* stm, const TExpRewriter& rewriter) {
+		shared_ptr<ExpList> kids = stm->kids();
+		if (kids == nullptr) {
+			return stm;
+		}
+		shared_ptr<ExpList> rewritten = rewriteKids(kids, rewriter);
+		return (rewritten != nullptr) ? stm->build(rewritten) : stm;
+	}
+
+	shared_ptr<const Temp::CTemp> DefinedTemp(IStm* stm) {
+		MOVE* move = dynamic_cast<MOVE*>(stm);
+		if (move != 0) {
+			TEMP* temp = dynamic_cast<TEMP*>(move->dst);
+			if (temp != 0 && !Frame::CFrame::IsRegister(temp->temp.get())) {
+				return temp->temp;
+			}
+		}
+		return nullptr;
+	}
+
+	IStm* ReplaceDefinedTemp(IStm* stm, shared_ptr<const Temp::CTemp> temp) {
+		MOVE* move = dynamic_cast<MOVE*>(stm);
+		assert(move != 0 && dynamic_cast<TEMP*>(move->dst) != 0);
+		return new MOVE(new TEMP(temp), move->src);
+	}
+
+	void CollectUses(IExp* exp, vector<shared_ptr<const Temp::CTemp>>& uses) {
+		TEMP* temp = dynamic_cast<TEMP*>(exp);
+		if (temp != 0) {
+			uses.push_back(temp->temp);
+			return;
+		}
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			CollectUses(l->head, uses);
+		}
+	}
+
+	void CollectUses(IStm* stm, vector<shared_ptr<const Temp::CTemp>>& uses) {
+		shared_ptr<ExpList> kids = stm->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			CollectUses(l->head, uses);
+		}
+	}
+
+	bool IsLeaf(IExp* exp) {
+		return dynamic_cast<TEMP*>(exp) != 0 || dynamic_cast<CONST*>(exp) != 0 || dynamic_cast<NAME*>(exp) != 0;
+	}
+
+	bool IsOffsetAddress(IExp* exp) {
+		BINOP* binop = dynamic_cast<BINOP*>(exp);
+		return binop != 0 && binop->binop == PLUS_OP && dynamic_cast<TEMP*>(binop->left) != 0
+			   && dynamic_cast<CONST*>(binop->right) != 0;
+	}
+
+	bool IsPure(IExp* exp) {
+		if (dynamic_cast<CALL*>(exp) != 0 || dynamic_cast<MEM*>(exp) != 0) {
+			return false;
+		}
+		BINOP* binop = dynamic_cast<BINOP*>(exp);
+		if (binop != 0 && binop->binop == DIV_OP) {
+			return false;
+		}
+		shared_ptr<ExpList> kids = exp->kids();
+		for (ExpList* l = kids.get(); l != 0; l = l->tail.get()) {
+			if (!IsPure(l->head)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool FoldBinop(ArithmeticOpType op, int left, int right, int& result) {
+		// Дополнительный код в разрядности слова: на x86 результат берётся по модулю 2^32, на x86-64 значение,
+		// которое не помещается в 32-битную константу, не сворачивается
+		const int bits = Frame::CFrame::wordSize * 8;
+		uint64_t l = static_cast<uint64_t>(static_cast<int64_t>(left));
+		uint64_t r = static_cast<uint64_t>(static_cast<int64_t>(right));
+		uint64_t value;
+		switch (op) {
+			case PLUS_OP: value = l + r; break;
+			case MINUS_OP: value = l - r; break;
+			case MULT_OP: value = l * r; break;
+			case AND_OP: value = l & r; break;
+			case OR_OP: value = l | r; break;
+			case DIV_OP:
+				// idiv на INT32_MIN / -1 в 32 битах - исключение
+				if (right == 0 || (bits == 32 && left == INT32_MIN && right == -1)) {
+					return false;
+				}
+				value = static_cast<uint64_t>(static_cast<int64_t>(left) / right);
+				break;
+			case LSHIFT_OP:
+			case RSHIFT_OP:
+			case ARSHIFT_OP:
+				if (right < 0 || right >= bits) {
+					return false;
+				}
+				if (op == LSHIFT_OP) {
+					value = l << right;
+				} else if (op == RSHIFT_OP) {
+					value = ((bits == 32) ? (l & UINT32_MAX) : l) >> right;
+				} else {
+					value = static_cast<uint64_t>(static_cast<int64_t>(left) >> right);
+				}
+				break;
+			default:
+				return false;
+		}
+		if (bits == 32) {
+			result = static_cast<int>(static_cast<uint32_t>(value));
+			return true;
+		}
+		int64_t wide = static_cast<int64_t>(value);
+		if (wide < INT32_MIN || wide > INT32_MAX) {
+			return false;
+		}
+		result = static_cast<int>(wide);
+		return true;
+	}
+
+	// Константы знаково расширяются до слова, поэтому и беззнаковый порядок одинаков на x86 и x86-64
+	bool EvaluateRelop(CJUMP_OP op, int left, int right) {
+		uint32_t l = static_cast<uint32_t>(left);
+		uint32_t r = static_cast<uint32_t>(right);
+		switch (op) {
+			case EQ: return left == right;
+			case NE: return left != right;
+			case LT: return left < right;
+			case GT: return left > right;
+			case LE: return left <= right;
+			case GE: return left >= right;
+			case ULT: return l < r;
+			case ULE: return l <= r;
+			case UGT: return l > r;
+			case UGE: return l >= r;
+		}
+		return false;
+	}
+
+	CJUMP_OP NegateRelop(CJUMP_OP op) {
+		switch (op) {
+			case EQ: return NE;
+			case NE: return EQ;
+			case LT: return GE;
+			case GT: return LE;
+			case LE: return GT;
+			case GE: return LT;
+			case ULT: return UGE;
+			case ULE: return UGT;
+			case UGT: return ULE;
+			case UGE: return ULT;
+		}
+		return op;
+	}
+
+	CJUMP_OP CommuteRelop(CJUMP_OP op) {
+		switch (op) {
+			case EQ: return EQ;
+			case NE: return NE;
+			case LT: return GT;
+			case GT: return LT;
+			case LE: return GE;
+			case GE: return LE;
+			case ULT: return UGT;
+			case ULE: return UGE;
+			case UGT: return ULT;
+			case UGE: return ULE;
+		}
+		return op;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef COMPILERS_IRUTILS_H
+#define COMPILERS_IRUTILS_H
+#include "../common.h"
+#include "../Structs/IRTree.h"
+
+// Вспомогательные функции над каноническими деревьями (без SEQ и ESEQ).
+// Листья деревьев (TEMP, CONST, NAME) могут разделяться несколькими операторами,
+// поэтому деревья никогда не изменяются на месте - только перестраиваются через kids()/build().
+namespace IRTree {
+	typedef function<IExp*(IExp*)> TExpRewriter;
+
+	// Перестраивает выражение снизу вверх: сначала потомки, затем rewriter для самого узла.
+	// Поддеревья, которые rewriter не изменил, не копируются.
+	IExp* RewriteExp(IExp* exp, const TExpRewriter& rewriter);
+	// Перестраивает выражения-потомки оператора. Приёмник MOVE(TEMP, ...) не затрагивается.
+	IStm* RewriteStm(IStm* stm, const TExpRewriter& rewriter);
+
+	// Переменная, которую определяет оператор MOVE(TEMP t, ...), иначе nullptr.
+	// Запись в машинный регистр (например, результата метода) определением переменной не считается.
+	shared_ptr<const Temp::CTemp> DefinedTemp(IStm* stm);
+	// Тот же оператор, но с другой переменной-приёмником
+	IStm* ReplaceDefinedTemp(IStm* stm, shared_ptr<const Temp::CTemp> temp);
+
+	// Все использования переменных в выражениях оператора
+	void CollectUses(IStm* stm, vector<shared_ptr<const Temp::CTemp>>& uses);
+	void CollectUses(IExp* exp, vector<shared_ptr<const Temp::CTemp>>& uses);
+
+	shared_ptr<ExpList> MakeExpList(const vector<IExp*>& exps);
+
+	// TEMP, CONST или NAME
+	bool IsLeaf(IExp* exp);
+	// Адрес вида t + c: сворачивается в адресный режим, отдельная переменная ему не нужна
+	bool IsOffsetAddress(IExp* exp);
+	// Выражение без вызовов, обращений к памяти и деления: его можно удалить или перенести
+	bool IsPure(IExp* exp);
+	// Значение операции над константами в разрядности CFrame::wordSize; false, если свернуть нельзя (деление
+	// на ноль, результат на x86-64 не помещается в 32-битную константу и т.п.)
+	bool FoldBinop(ArithmeticOpType op, int left, int right, int& result);
+	bool EvaluateRelop(CJUMP_OP op, int left, int right);
+	// Условие, истинное ровно тогда, когда op ложно
+	CJUMP_OP NegateRelop(CJUMP_OP op);
+	// a op b равносильно b op' a
+	CJUMP_OP CommuteRelop(CJUMP_OP op);
+}
+
+#endif //COMPILERS_IRUTILS_H
@@ -1,88 +1,70 @@
 #include "../Structs/InterferenceGraph.h"
+#include "../Structs/Frame.h"
 
 namespace RegAlloc {
 	void CInterferenceGraph::Build( CFlowGraph& flowGraph ){
-		map< int, set<const CTemp*> > in;
-		map< int, set<const CTemp*> > inOld;
-		map< int, set<const CTemp*> > out;
-		map< int, set<const CTemp*> > outOld;
+		const CInstrStream& stream = flowGraph.Stream();
+		Dataflow::CLiveness liveness(flowGraph);
 
-		bool cycled;
-		list<CGraphNode<CInstr*>*> ordered;
-		flowGraph.DFS(cycled, ordered);
-		set<const CTemp*> inDiff;
-		set<const CTemp*> outDiff;
-		do {
-			inDiff.clear();
-			outDiff.clear();
-			for (auto it = ordered.begin(); it != ordered.end(); it++){
-				CGraphNode<CInstr*>* node = (*it);
-				int index = node->index;
-				inOld[index] = in[index];
-				outOld[index] = out[index];
-
-				set<const CTemp*> use = flowGraph.GetUse(index);
-				set<const CTemp*> def = flowGraph.GetDef(index);
-				set<const CTemp*> inter;
-				in[index].clear();
-				set_intersection(out[index].begin(), out[index].end(),
-								 def.begin(), def.end(),
-								 inserter(inter, inter.begin()));
-				set_union(use.begin(), use.end(),
-						  inter.begin(), inter.end(),
-						  inserter(in[index], in[index].begin()));
-
-				set<int> succ = flowGraph.getNodesIndexFromNode(index);
-				for (auto i = succ.begin(); i != succ.end(); i++){
-					int succIndex = (*i);
-					out[index].insert(in[succIndex].begin(), in[succIndex].end());
-				}
-
-				set_intersection(in[index].begin(), in[index].end(),
-								 inOld[index].begin(), inOld[index].end(),
-								 inserter(inDiff, inDiff.begin()));
-				set_intersection(out[index].begin(), out[index].end(),
-								 outOld[index].begin(), outOld[index].end(),
-								 inserter(outDiff, outDiff.begin()));
-			}
-		} while( !( inDiff.empty() && outDiff.empty() ) );
-
-		set<const CTemp*> allTemps;
-		for (auto it = ordered.begin(); it != ordered.end(); it++) {
-			CGraphNode<CInstr*>* node = (*it);
+		// Вершины - переменные, встречающиеся в командах, в порядке номеров потока
+		vector<bool> present(stream.TempsCount(), false);
+		for (int i = 0; i < stream.Size(); i++) {
 			// Todo: убрать uses, сейчас из-за того что ecx без def'а
-			set<const CTemp*> defs = flowGraph.GetDef(node->index);
-			set<const CTemp*> uses = flowGraph.GetUse(node->index);
-			allTemps.insert( defs.begin(), defs.end() );
-			allTemps.insert( uses.begin(), uses.end() );
+			for (int temp : stream[i].defs) {
+				present[temp] = true;
+			}
+			for (int temp : stream[i].uses) {
+				present[temp] = true;
+			}
 		}
-		for (auto it = allTemps.begin(); it != allTemps.end(); it++) {
-			addNode( (*it) );
+		vector<int> nodeOf(stream.TempsCount(), -1);
+		for (int temp = 0; temp < present.size(); temp++) {
+			if (present[temp]) {
+				nodeOf[temp] = addNode(stream.Temp(temp).get());
+			}
 		}
 
-		for (auto i = ordered.begin(); i != ordered.end(); i++) {
-			CGraphNode<CInstr*>* node = (*i);
-			int index = node->index;
-			AMOVE* move = dynamic_cast<AMOVE*>(node->value);
-			if ( move != 0 ){
-				set<const CTemp*> use = flowGraph.GetUse(index);
-				set<const CTemp*> all = flowGraph.GetDef(index);
-				all.insert(use.begin(), use.end());
-				for (auto j = all.begin(); j != all.end(); j++) {
-					movesAssociated[getNode(*j).index].insert(move);
-					movesAssociated[getNode(*j).index].insert(move);
-				}
-				worklistMoves.insert(move);
+		for (int index = 0; index < stream.Size(); index++) {
+			const CInstr& instr = stream[index];
+			if ( instr.move ){
+				movesAssociated[nodeOf[instr.defs[0]]].insert(&instr);
+				movesAssociated[nodeOf[instr.uses[0]]].insert(&instr);
+				worklistMoves.insert(&instr);
 			} else {
-				set<const CTemp*> def = flowGraph.GetDef(index);
-				for (auto j = def.begin(); j != def.end(); j++) {
-					for (auto k = out[index].begin(); k != out[index].end(); k++) {
-						if (*k != *j) {
-							addBiEdge( getNode(( *k )).index, getNode(( *j )).index );
+				for (int def : instr.defs) {
+					liveness.LiveOut(index).ForEach([&](int k) {
+						if (k != def) {
+							addBiEdge( nodeOf[k], nodeOf[def] );
 						}
-					}
+					});
+				}
+			}
+		}
+	}
+
+	int CInterferenceGraph::PotentialSpills( int registers ) const {
+		list<CGraphNode<const CTemp*>> nodes = getAllNodesCopy();
+		map<int, set<int>> neighbours;
+		for (auto it = nodes.begin(); it != nodes.end(); it++) {
+			if (!Frame::CFrame::IsRegister(it->value)) {
+				neighbours[it->index] = getNodesIndexFromNode(it->index);
+			}
+		}
+		bool simplified = true;
+		while (simplified) {
+			simplified = false;
+			for (auto it = neighbours.begin(); it != neighbours.end();) {
+				if (it->second.size() >= registers) {
+					it++;
+					continue;
+				}
+				for (auto j = neighbours.begin(); j != neighbours.end(); j++) {
+					j->second.erase(it->first);
 				}
+				it = neighbours.erase(it);
+				simplified = true;
 			}
 		}
+		return neighbours.size();
 	}
-}
\ No newline at end of file
+}
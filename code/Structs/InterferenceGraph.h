@@ -3,6 +3,7 @@
 #include "../Structs/Graph.h"
 #include "../Structs/Temp.h"
 #include "../Structs/FlowGraph.h"
+#include "../Structs/Dataflow.h"
 namespace RegAlloc {
 	using namespace Temp;
 	using namespace FlowGraph;
@@ -10,9 +11,12 @@ namespace RegAlloc {
 	public:
 		CInterferenceGraph(){}
 		void Build(CFlowGraph& flowGraph);
+		// Оценка числа сбросов в память при registers доступных регистрах: переменные, которые остаются
+		// после упрощения графа (удаления вершин степени меньше registers)
+		int PotentialSpills(int registers) const;
 	private:
 		map<int, int> colors;
-		map<int, set<AMOVE*>> movesAssociated;
+		map<int, set<const CInstr*>> movesAssociated;
 
 		set<int> precolored; // machine registers, preassigned a color
 		set<int> initial; // temporary registers, not precolored and not yet processed.
@@ -31,11 +35,11 @@ namespace RegAlloc {
 
 		set<int> moveRelated;
 
-		set<AMOVE*> coalescedMoves; // moves that have been coalesced.
-		set<AMOVE*> constrainedMoves; // moves whose source and target interfere.
-		set<AMOVE*> frozenMoves; // moves that will no longer be considered for coalescing.
-		set<AMOVE*> worklistMoves; // moves enabled for possible coalescing.
-		set<AMOVE*> activeMoves; // moves not yet ready for coalescing.
+		set<const CInstr*> coalescedMoves; // moves that have been coalesced.
+		set<const CInstr*> constrainedMoves; // moves whose source and target interfere.
+		set<const CInstr*> frozenMoves; // moves that will no longer be considered for coalescing.
+		set<const CInstr*> worklistMoves; // moves enabled for possible coalescing.
+		set<const CInstr*> activeMoves; // moves not yet ready for coalescing.
 	};
 }
 #endif //COMPILERS_INTERFERENCEGRAPH_H
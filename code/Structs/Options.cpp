@@ -0,0 +1,53 @@
+#include "../Structs/Options.h"
+#include <cstring>
+#include <stdexcept>
+
+COptions::COptions() : inputFile(0), inlining(false), tailCalls(false), escape(false), ssa(false), sccp(false), gvn(false), licm(false), ivsr(false), dce(false), ifConversion(false), peephole(false), scheduling(false), latencyScheduling(false), frameVariables(false), x86_64(false), livenessBenchmark(false) {}
+
+void COptions::Parse(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			inputFile = argv[i];
+		} else if (strcmp(argv[i], "-finline") == 0) {
+			inlining = true;
+		} else if (strcmp(argv[i], "-ftailcalls") == 0) {
+			tailCalls = true;
+		} else if (strcmp(argv[i], "-fescape") == 0) {
+			escape = true;
+		} else if (strcmp(argv[i], "-fssa") == 0) {
+			ssa = true;
+		} else if (strcmp(argv[i], "-fsccp") == 0) {
+			ssa = sccp = true;
+		} else if (strcmp(argv[i], "-fgvn") == 0) {
+			ssa = gvn = true;
+		} else if (strcmp(argv[i], "-flicm") == 0) {
+			ssa = licm = true;
+		} else if (strcmp(argv[i], "-fivsr") == 0) {
+			ssa = ivsr = true;
+		} else if (strcmp(argv[i], "-fdce") == 0) {
+			dce = true;
+		} else if (strcmp(argv[i], "-fifconv") == 0) {
+			ifConversion = true;
+		} else if (strcmp(argv[i], "-fpeephole") == 0) {
+			peephole = true;
+		} else if (strcmp(argv[i], "-fschedule") == 0) {
+			scheduling = true;
+			latencyScheduling = false;
+		} else if (strcmp(argv[i], "-fschedule=latency") == 0) {
+			scheduling = latencyScheduling = true;
+		} else if (strcmp(argv[i], "-fno-regvars") == 0) {
+			frameVariables = true;
+		} else if (strcmp(argv[i], "-m64") == 0) {
+			x86_64 = true;
+		} else if (strcmp(argv[i], "-m32") == 0) {
+			x86_64 = false;
+		} else if (strcmp(argv[i], "-fbench-liveness") == 0) {
+			livenessBenchmark = true;
+		} else {
+			throw new invalid_argument(string("Unknown option ") + argv[i]);
+		}
+	}
+	if (inputFile == 0) {
+		throw new invalid_argument("No input file");
+	}
+}
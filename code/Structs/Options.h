@@ -0,0 +1,46 @@
+#ifndef COMPILERS_OPTIONS_H
+#define COMPILERS_OPTIONS_H
+#include "../common.h"
+
+// Параметры командной строки: minijava <file.java> [-fssa -fsccp ...].
+// Оптимизации над SSA-формой включают и её построение.
+struct COptions {
+	COptions();
+	void Parse(int argc, char** argv);
+
+	const char* inputFile;
+	// Встраивание методов до канонизации
+	bool inlining;
+	// Замена хвостовой рекурсии переходом
+	bool tailCalls;
+	// Размещение неубегающих объектов в кадре и замена их полей переменными
+	bool escape;
+	// Построение SSA-формы и выход из неё между линеаризацией и трассировкой
+	bool ssa;
+	// Разреженное условное распространение констант
+	bool sccp;
+	// Нумерация значений: удаление повторных вычислений и чтений памяти
+	bool gvn;
+	// Вынос инвариантов циклов
+	bool licm;
+	// Снижение стоимости индукционных выражений и замена проверок выхода из цикла
+	bool ivsr;
+	// Удаление мёртвых записей в промежуточном представлении и мёртвых команд после генерации кода
+	bool dce;
+	// Замена коротких ветвлений выборами без переходов (cmov, setcc) после трассировки
+	bool ifConversion;
+	// Оптимизация окном над сгенерированными командами
+	bool peephole;
+	// Планирование команд в базовых блоках с учётом давления на регистры (-fschedule) или по задержкам
+	// (-fschedule=latency)
+	bool scheduling;
+	bool latencyScheduling;
+	// Все переменные и параметры в ячейках кадра, а не в переменных промежуточного представления
+	bool frameVariables;
+	// Целевая архитектура x86-64 (-m64) вместо x86 (-m32)
+	bool x86_64;
+	// Замер времени битового решателя живости против реализации на set<const CTemp*>
+	bool livenessBenchmark;
+};
+
+#endif //COMPILERS_OPTIONS_H
@@ -25,6 +25,11 @@ namespace SymbolsTable {
 		throw new logic_error("Not found in getMethodInfo");
 	}
 
+	//--------------------------------------------------------------------------------------------------------------
+	// CVirtualMethod
+	//--------------------------------------------------------------------------------------------------------------
+	CVirtualMethod::CVirtualMethod( const CSymbol* _name, const CSymbol* _owner ) : name( _name ), owner( _owner ) { }
+
 	//--------------------------------------------------------------------------------------------------------------
 	// CTable
 	//--------------------------------------------------------------------------------------------------------------
@@ -49,4 +54,61 @@ namespace SymbolsTable {
 		} while ( current->parent != 0 );
 		return ans;
 	}
-}
\ No newline at end of file
+
+	CClassInfo &CTable::getMethodOwner( const CSymbol* className, const CSymbol* method ) {
+		CClassInfo* current = &getClassInfo( className );
+		while ( true ) {
+			for ( int i = 0; i < current->methods.size(); i++ )
+				if ( method->getString() == current->methods[i].name->getString())
+					return *current;
+			if ( current->parent == 0 )
+				throw new logic_error( "Not found in getMethodOwner" );
+			current = &getClassInfo( current->parent );
+		}
+	}
+
+	vector<CVirtualMethod> CTable::getVirtualTable( const CSymbol* name ) {
+		CClassInfo& info = getClassInfo( name );
+		vector<CVirtualMethod> ans;
+		if ( info.parent != 0 )
+			ans = getVirtualTable( info.parent );
+		for ( int i = 0; i < info.methods.size(); i++ ) {
+			int slot = 0;
+			while ( slot < ans.size() && ans[slot].name->getString() != info.methods[i].name->getString())
+				slot++;
+			if ( slot == ans.size())
+				ans.push_back( CVirtualMethod( info.methods[i].name, name ));
+			else
+				ans[slot].owner = name;
+		}
+		return ans;
+	}
+
+	int CTable::getVirtualSlot( const CSymbol* className, const CSymbol* method ) {
+		vector<CVirtualMethod> vtable = getVirtualTable( className );
+		for ( int i = 0; i < vtable.size(); i++ )
+			if ( method->getString() == vtable[i].name->getString())
+				return i;
+		throw new logic_error( "Not found in getVirtualSlot" );
+	}
+
+	bool CTable::isSubclass( const CSymbol* name, const CSymbol* base ) {
+		const CSymbol* current = name;
+		while ( current != 0 ) {
+			if ( current->getString() == base->getString())
+				return true;
+			current = getClassInfo( current ).parent;
+		}
+		return false;
+	}
+
+	const CSymbol* CTable::getSingleImplementation( const CSymbol* className, const CSymbol* method ) {
+		const CSymbol* owner = getMethodOwner( className, method ).name;
+		for ( int i = 0; i < classInfo.size(); i++ ) {
+			if ( isSubclass( classInfo[i].name, className )
+					&& getMethodOwner( classInfo[i].name, method ).name->getString() != owner->getString())
+				return 0;
+		}
+		return owner;
+	}
+}
@@ -32,10 +32,27 @@ struct CClassInfo {
 	vector<CMethodInfo> methods;
 };
 
+// Слот таблицы виртуальных методов: метод и класс, в котором определена его реализация
+struct CVirtualMethod {
+	CVirtualMethod(const CSymbol* _name, const CSymbol* _owner);
+
+	const CSymbol* name;
+	const CSymbol* owner;
+};
+
 struct CTable {
 	CTable();
 	CClassInfo& getClassInfo(const CSymbol* name);
 	vector<CVarInfo> getParentVars(const CSymbol* name);
+	// Класс или ближайший предок, в котором определён метод
+	CClassInfo& getMethodOwner(const CSymbol* className, const CSymbol* method);
+	// Слоты методов предков идут первыми, переопределённый метод занимает слот предка
+	vector<CVirtualMethod> getVirtualTable(const CSymbol* name);
+	int getVirtualSlot(const CSymbol* className, const CSymbol* method);
+	bool isSubclass(const CSymbol* name, const CSymbol* base);
+	// Анализ иерархии классов: класс с реализацией метода, общей для объектов класса и всех его
+	// наследников, или 0, если наследники метод переопределяют
+	const CSymbol* getSingleImplementation(const CSymbol* className, const CSymbol* method);
 
 	vector<CClassInfo> classInfo;
 };
@@ -31,10 +31,4 @@ namespace Temp {
 
 	int CLabel::nextUniqueId = 0;
 	int CTemp::nextUniqueId = 0;
-
-
-	CTempList::CTempList(shared_ptr<const CTemp> _head, CTempList* _tail) : head(_head), tail(_tail) {}
-
-
-	CLabelList::CLabelList(const CLabel* _head, CLabelList* _tail) : head(_head), tail(_tail) {}
 }
\ No newline at end of file
@@ -32,33 +32,6 @@ private:
 	string name;
 };
 
-class CTempList {
-public:
-	CTempList(shared_ptr<const CTemp> _head, CTempList* _tail);
-	CTempList* Reverse();
-
-	shared_ptr<const CTemp> head;
-	CTempList* tail;
-
-	set<const CTemp*> GetSet() {
-		CTempList* cur = this;
-		set<const CTemp*> res;
-		while ( cur != 0 ) {
-			assert( cur->head != 0 );
-			res.insert(cur->head.get());
-			cur = cur->tail;
-		}
-		return res;
-	}
-};
-
-class CLabelList {
-public:
-	CLabelList(const CLabel* _head, CLabelList* _tail);
-
-	const CLabel* head;
-	CLabelList* tail;
-};
 }
 
 #endif
@@ -1,4 +1,5 @@
 #include "TraceShedule.h"
+#include "IRUtils.h"
 
 namespace Canon {
 	TraceShedule::TraceShedule(BasicBlocks* b) {
@@ -52,12 +53,13 @@ namespace Canon {
 						l = itFalse->second;
 						//cout << "ohoho" << endl;
 					} else if ( itTrue != table.end() ) {
-						last->tail->head = new CJUMP(cjump->relop, cjump->left, cjump->right, cjump->iffalse, cjump->iftrue);
+						// За переходом должна идти ложная ветвь: условие обращается
+						last->tail->head = new CJUMP(NegateRelop(cjump->relop), cjump->left, cjump->right, cjump->iffalse, cjump->iftrue);
 						last->tail->tail = itTrue->second;
 						l = itTrue->second;
 					} else {
 						const CLabel* ff = new CLabel();
-						last->tail->head = new CJUMP(cjump->relop, cjump->left, cjump->right, cjump->iffalse, cjump->iftrue);
+						last->tail->head = new CJUMP(cjump->relop, cjump->left, cjump->right, cjump->iftrue, ff);
 						last->tail->tail = make_shared<StmtList>(new LABEL(ff),
 																 make_shared<StmtList>(new JUMP(cjump->iffalse), getNext()));
 						return;
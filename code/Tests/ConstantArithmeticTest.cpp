@@ -0,0 +1,207 @@
+#include "../Structs/ConstantArithmetic.h"
+#include <climits>
+#include <cstdint>
+
+// Исполняет последовательности команд, которые CCodegen::constantSequence выпускает для умножения и деления
+// на константу, и сравнивает результат с x * k и x / d в разрядности слова x86 (32) и x86-64 (64).
+
+using namespace CodeGenerator;
+
+static int failures = 0;
+
+template<typename U>
+static void check(U actual, U expected, const char* what, long long x, long long constant) {
+	if (actual != expected && failures++ < 20) {
+		cerr << what << " " << sizeof(U) * 8 << ": x = " << x << ", constant = " << constant << ", got "
+			<< actual << ", expected " << expected << endl;
+	}
+}
+
+// sar в W-битном регистре
+template<typename U>
+static U sar(U value, int shift) {
+	const int bits = sizeof(U) * 8;
+	U sign = (value >> (bits - 1)) != 0 ? ~U(0) : U(0);
+	return shift == 0 ? value : (value >> shift) | (sign << (bits - shift));
+}
+
+// lea d, [x + x*(f-1)] или [x*f] для каждого множителя (первая от x, следующие от d), затем [mov d, x;] shl d, shift
+template<typename U>
+static U multiply(U x, const vector<int>& leaFactors, int shift) {
+	U d = x;
+	for (int i = 0; i < leaFactors.size(); i++) {
+		U index = (i == 0) ? x : d;
+		int f = leaFactors[i];
+		d = (f % 2 != 0 || f == 2) ? index + index * U(f - 1) : index * U(f);
+	}
+	return d << shift;
+}
+
+// mov d, x; [sar d, k-1;] shr d, W-k; add d, x; sar d, k
+template<typename U>
+static U divideByPowerOfTwo(U x, int k) {
+	const int bits = sizeof(U) * 8;
+	U d = x;
+	if (k > 1) {
+		d = sar(d, k - 1);
+	}
+	d >>= bits - k;
+	d += x;
+	return sar(d, k);
+}
+
+// mov eax, M; imul x; [add edx, x;] [sar edx, s;] mov t, x; shr t, 31; add edx, t
+static uint32_t divideByMagic(uint32_t x, uint32_t magic, int shift) {
+	int64_t product = int64_t(int32_t(magic)) * int32_t(x);
+	uint32_t high = uint32_t(uint64_t(product) >> 32);
+	if (int32_t(magic) < 0) {
+		high += x;
+	}
+	high = sar(high, shift);
+	return high + (x >> 31);
+}
+
+// Линейный конгруэнтный генератор: тест воспроизводим
+static uint64_t nextRandom() {
+	static uint64_t state = 88172645463325252ULL;
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return state;
+}
+
+// Граничные и случайные делимые (множимые) слова
+static vector<int64_t> samples(bool wide) {
+	vector<int64_t> values = { INT_MIN, INT_MIN + 1, -2, -1, 0, 1, 2, INT_MAX - 1, INT_MAX };
+	if (wide) {
+		values.insert(values.end(), { LLONG_MIN, LLONG_MIN + 1, int64_t(INT_MIN) - 1, int64_t(INT_MAX) + 1,
+			LLONG_MAX - 1, LLONG_MAX });
+	}
+	for (int i = 0; i < 2000; i++) {
+		uint64_t r = nextRandom();
+		values.push_back(wide ? int64_t(r) : int64_t(int32_t(r >> 32)));
+	}
+	return values;
+}
+
+static void testMultiply() {
+	vector<int> multipliers;
+	for (int k = -1000; k <= 100000; k++) {
+		multipliers.push_back(k);
+	}
+	static const int odd[] = { 1, 3, 5, 9, 15, 25, 27, 45, 81 };
+	for (int f = 0; f < 9; f++) {
+		for (int s = 0; (int64_t(odd[f]) << s) <= INT_MAX; s++) {
+			multipliers.push_back(odd[f] << s);
+		}
+	}
+	multipliers.push_back(INT_MAX);
+	const vector<int64_t> narrow = samples(false);
+	const vector<int64_t> wide = samples(true);
+	int decomposed = 0;
+	for (int i = 0; i < multipliers.size(); i++) {
+		int k = multipliers[i];
+		vector<int> leaFactors;
+		int shift;
+		if (!DecomposeMultiplier(k, leaFactors, shift)) {
+			continue;
+		}
+		decomposed++;
+		// Не больше двух команд, не считая mov перед единственным shl
+		int instructions = leaFactors.size() + (shift != 0 ? 1 : 0);
+		check<uint32_t>(instructions >= 1 && instructions <= 2, 1, "instructions", instructions, k);
+		for (int j = 0; j < narrow.size(); j++) {
+			uint32_t x = uint32_t(narrow[j]);
+			check<uint32_t>(multiply<uint32_t>(x, leaFactors, shift), x * uint32_t(k), "mul", narrow[j], k);
+		}
+		for (int j = 0; j < wide.size(); j++) {
+			uint64_t x = uint64_t(wide[j]);
+			check<uint64_t>(multiply<uint64_t>(x, leaFactors, shift), x * uint64_t(int64_t(k)), "mul", wide[j], k);
+		}
+	}
+	cout << "multipliers: " << multipliers.size() << ", decomposed " << decomposed << endl;
+}
+
+// Все делимые из окрестностей нуля и краёв диапазона, граничные для d и случайные
+static vector<int32_t> dividends(int32_t d) {
+	vector<int32_t> values;
+	for (int64_t x = -(1 << 20); x <= (1 << 20); x++) {
+		values.push_back(int32_t(x));
+	}
+	for (int64_t x = 0; x <= (1 << 16); x++) {
+		values.push_back(int32_t(INT_MIN + x));
+		values.push_back(int32_t(INT_MAX - x));
+	}
+	for (int64_t m = -3; m <= 3; m++) {
+		for (int64_t q : { int64_t(1), int64_t(INT_MAX / d), int64_t(INT_MIN / d) }) {
+			int64_t x = q * d + m;
+			if (x >= INT_MIN && x <= INT_MAX) {
+				values.push_back(int32_t(x));
+			}
+		}
+	}
+	for (int i = 0; i < 1000000; i++) {
+		values.push_back(int32_t(nextRandom() >> 32));
+	}
+	return values;
+}
+
+static void testDivide(int32_t d, const vector<int32_t>& values) {
+	if ((d & (d - 1)) == 0) {
+		int k = 0;
+		while ((1 << k) != d) {
+			k++;
+		}
+		for (int i = 0; i < values.size(); i++) {
+			int32_t x = values[i];
+			check<uint32_t>(divideByPowerOfTwo<uint32_t>(uint32_t(x), k), uint32_t(x / d), "div", x, d);
+			check<uint64_t>(divideByPowerOfTwo<uint64_t>(uint64_t(int64_t(x)), k), uint64_t(int64_t(x / d)),
+				"div", x, d);
+		}
+		static const int64_t wide[] = { LLONG_MIN, LLONG_MIN + 1, -1, 0, 1, LLONG_MAX - 1, LLONG_MAX };
+		for (int i = 0; i < 7; i++) {
+			check<uint64_t>(divideByPowerOfTwo<uint64_t>(uint64_t(wide[i]), k), uint64_t(wide[i] / d),
+				"div", wide[i], d);
+		}
+		return;
+	}
+	uint32_t magic;
+	int shift;
+	SignedMagic<uint32_t>(d, magic, shift);
+	for (int i = 0; i < values.size(); i++) {
+		int32_t x = values[i];
+		check<uint32_t>(divideByMagic(uint32_t(x), magic, shift), uint32_t(x / d), "div", x, d);
+	}
+}
+
+int main() {
+	testMultiply();
+
+	static const int32_t divisors[] = { 2, 3, 5, 7, 10, 641, 1000000007 };
+	for (int i = 0; i < 7; i++) {
+		testDivide(divisors[i], dividends(divisors[i]));
+	}
+	// Остальные делители: степени двойки, все до 10000 и случайные - на граничных и случайных делимых
+	vector<int32_t> others;
+	for (int k = 1; k < 31; k++) {
+		others.push_back(1 << k);
+	}
+	for (int d = 2; d <= 10000; d++) {
+		others.push_back(d);
+	}
+	for (int i = 0; i < 1000; i++) {
+		others.push_back(int32_t(2 + (nextRandom() >> 33) % (INT_MAX - 1)));
+	}
+	others.push_back(INT_MAX);
+	vector<int64_t> sampled = samples(false);
+	vector<int32_t> values(sampled.begin(), sampled.end());
+	for (int i = 0; i < others.size(); i++) {
+		testDivide(others[i], values);
+	}
+	cout << "divisors: " << 7 + others.size() << endl;
+
+	if (failures != 0) {
+		cout << "FAILED: " << failures << " mismatches" << endl;
+		return 1;
+	}
+	cout << "OK" << endl;
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include "common.h"
+#include "Structs/Options.h"
 #include "ASTVisitors/Printer.h"
 #include "ASTVisitors/SymbolTableBuilder.h"
 #include "ASTVisitors/TypeChecker.h"
@@ -6,9 +7,15 @@
 
 #include "IRVisitors/Printer.h"
 #include "IRVisitors/Canonizer.h"
+#include "IRVisitors/Inliner.h"
+#include "IRVisitors/TailCalls.h"
+#include "IRVisitors/EscapeAnalysis.h"
 #include "IRVisitors/Optimizer.h"
+#include "IRVisitors/IfConversion.h"
 #include "IRVisitors/CodeGenerator.h"
 #include "IRVisitors/RegAlloc.h"
+#include "IRVisitors/Peephole.h"
+#include "IRVisitors/Scheduler.h"
 
 extern FILE * yyin;
 extern int yyparse();
@@ -19,8 +26,12 @@ int main(int argc, char** argv) {
 	try {
 		ofstream ofs;
 		ofstream gv;
+		COptions options;
+		options.Parse(argc, argv);
+		Frame::CFrame::SetTarget(options.x86_64 ? Frame::T_X86_64 : Frame::T_X86);
+		Frame::CFrame::SetVariablesInFrame(options.frameVariables);
         FILE* progrFile;
-        progrFile = fopen(argv[1], "r");
+        progrFile = fopen(options.inputFile, "r");
         if (progrFile == NULL) {
           throw new invalid_argument("File not found");
         }
@@ -51,6 +62,10 @@ int main(int argc, char** argv) {
 		Translate::CTranslator traslator_vis(&symbolsStorage, table_vis.table);
         root->accept(&traslator_vis);
 
+		ofs.open("Logs/VirtualTables.log", ofstream::out);
+		traslator_vis.PrintVirtualTables(ofs);
+		ofs.close();
+
 		vector<INode*> trees(traslator_vis.trees);
 		ofs.open("Logs/IRRaw.log", ofstream::out);
 		gv.open("Logs/IRRaw.gv", ofstream::out);
@@ -58,6 +73,21 @@ int main(int argc, char** argv) {
 		gv.close();
 		ofs.close();
 
+		if (options.inlining) {
+			cout << "Inlining methods..." << endl;
+			ofs.open("Logs/Inliner.log", ofstream::out);
+			Canon::CInlineStatistics inlineStats;
+			Canon::Inline(ofs, trees, traslator_vis.fragments, inlineStats);
+			ofs << "inliner: calls " << inlineStats.calls << ", inlined " << inlineStats.inlinedCalls
+				<< ", nodes " << inlineStats.nodesBefore << " -> " << inlineStats.nodesAfter << endl;
+			ofs.close();
+			ofs.open("Logs/IRInlined.log", ofstream::out);
+			gv.open("Logs/IRInlined.gv", ofstream::out);
+			Canon::Print(ofs, gv, trees);
+			gv.close();
+			ofs.close();
+		}
+
 		cout << "Canonizing IRT..." << endl;
 		ofs.open("Logs/IRCanonized.log", ofstream::out);
 		gv.open("Logs/IRCanonized.gv", ofstream::out);
@@ -76,6 +106,50 @@ int main(int argc, char** argv) {
 		gv.close();
 		ofs.close();
 
+		if (options.tailCalls) {
+			cout << "Eliminating tail calls..." << endl;
+			ofs.open("Logs/TailCalls.log", ofstream::out);
+			Canon::CTailCallStatistics tailStats;
+			Canon::EliminateTailCalls(ofs, linearized_blocks, traslator_vis.fragments, tailStats);
+			ofs << "tail calls: calls " << tailStats.calls << ", self tail calls replaced by jumps " << tailStats.selfTailCalls
+				<< ", other tail calls " << tailStats.otherTailCalls << ", frames reused " << tailStats.reusedFrames << endl;
+			ofs.close();
+			ofs.open("Logs/IRTailCalls.log", ofstream::out);
+			gv.open("Logs/IRTailCalls.gv", ofstream::out);
+			Canon::Print(ofs, gv, linearized_blocks);
+			gv.close();
+			ofs.close();
+		}
+
+		if (options.escape) {
+			cout << "Analyzing escapes..." << endl;
+			ofs.open("Logs/Escape.log", ofstream::out);
+			Canon::CEscapeStatistics escapeStats;
+			Canon::ReplaceAllocations(ofs, linearized_blocks, traslator_vis.fragments, escapeStats);
+			ofs << "escape: allocations " << escapeStats.allocations << ", in frame " << escapeStats.stackAllocations
+				<< ", replaced by temps " << escapeStats.scalarReplacements << ", in heap "
+				<< escapeStats.allocations - escapeStats.stackAllocations - escapeStats.scalarReplacements
+				<< ", analysis iterations " << escapeStats.analysisIterations << endl;
+			ofs.close();
+			ofs.open("Logs/IREscape.log", ofstream::out);
+			gv.open("Logs/IREscape.gv", ofstream::out);
+			Canon::Print(ofs, gv, linearized_blocks);
+			gv.close();
+			ofs.close();
+		}
+
+		if (options.ssa || options.dce) {
+			cout << "Optimizing IRT..." << endl;
+			ofs.open("Logs/Optimizer.log", ofstream::out);
+			Canon::Optimize(ofs, linearized_blocks, options);
+			ofs.close();
+			ofs.open("Logs/IROptimized.log", ofstream::out);
+			gv.open("Logs/IROptimized.gv", ofstream::out);
+			Canon::Print(ofs, gv, linearized_blocks);
+			gv.close();
+			ofs.close();
+		}
+
 		cout << "Tracing IRT..." << endl;
 		ofs.open("Logs/IRTraced.log", ofstream::out);
 		gv.open("Logs/IRTraced.gv", ofstream::out);
@@ -85,18 +159,63 @@ int main(int argc, char** argv) {
 		gv.close();
 		ofs.close();
 
+		if (options.ifConversion) {
+			cout << "Converting branches..." << endl;
+			ofs.open("Logs/IfConversion.log", ofstream::out);
+			Canon::CIfConversionStatistics ifStats;
+			Canon::ConvertBranches(ofs, traced_blocks, ifStats);
+			ofs << "if-conversion: conditional jumps " << ifStats.conditionalJumps << ", triangles " << ifStats.triangles
+				<< ", diamonds " << ifStats.diamonds << ", selects " << ifStats.selects << ", comparisons "
+				<< ifStats.comparisons << endl;
+			ofs.close();
+			ofs.open("Logs/IRIfConverted.log", ofstream::out);
+			gv.open("Logs/IRIfConverted.gv", ofstream::out);
+			Canon::Print(ofs, gv, traced_blocks);
+			gv.close();
+			ofs.close();
+		}
+
 		cout << "Generating ASM code..." << endl;
 		ofs.open("Logs/CodeGen.log", ofstream::out);
-		vector<shared_ptr<CInstrList>> blockInstrs;
-		CodeGenerator::GenerateCode(ofs, traced_blocks, blockInstrs);
+		vector<Assembler::CInstrStream> blockInstrs;
+		CodeGenerator::GenerateCode(ofs, traced_blocks, traslator_vis.fragments, blockInstrs);
 		ofs.close();
 
+		if (options.dce) {
+			cout << "Removing dead instructions..." << endl;
+			ofs.open("Logs/DeadCode.log", ofstream::out);
+			RegAlloc::RemoveDeadInstructions(ofs, blockInstrs);
+			ofs.close();
+		}
+
+		if (options.peephole) {
+			cout << "Peephole optimization..." << endl;
+			ofs.open("Logs/Peephole.log", ofstream::out);
+			CodeGenerator::CPeepholeStatistics peepholeStats;
+			CodeGenerator::Peephole(ofs, blockInstrs, peepholeStats);
+			ofs.close();
+		}
+
+		if (options.scheduling) {
+			cout << "Scheduling instructions..." << endl;
+			ofs.open("Logs/Schedule.log", ofstream::out);
+			CodeGenerator::CSchedulerStatistics scheduleStats;
+			CodeGenerator::Schedule(ofs, blockInstrs,
+				options.latencyScheduling ? CodeGenerator::SM_Latency : CodeGenerator::SM_Pressure, scheduleStats);
+			ofs.close();
+		}
+
 		cout << "Flow graph building.." << endl;
 		ofs.open("Logs/FlowGraph.log", ofstream::out);
 		vector<shared_ptr<FlowGraph::CFlowGraph>> graphs;
 		RegAlloc::BuildFlowGraph(ofs, blockInstrs, graphs);
 		ofs.close();
 
+		cout << "Dataflow analysis.." << endl;
+		ofs.open("Logs/Dataflow.log", ofstream::out);
+		RegAlloc::AnalyzeDataflow(ofs, graphs, options.livenessBenchmark);
+		ofs.close();
+
 		cout << "Interference graph building.." << endl;
 		ofs.open("Logs/InterferenceGraph.log", ofstream::out);
 		vector<shared_ptr<RegAlloc::CInterferenceGraph>> interferenceGraphs;